@@ -33,6 +33,7 @@ end
 IO.puts("ExOpenzl Benchmark")
 IO.puts("==================")
 IO.puts("OpenZL version: #{ExOpenzl.version()}")
+IO.puts("Kernel ISA: #{ExOpenzl.build_info().kernel_isa}")
 IO.puts("")
 
 # ── Data generation ──
@@ -117,6 +118,24 @@ for level <- [1, 6, 12, 19] do
   end, 200)
 end
 
+IO.puts("")
+IO.puts("── LZ4 Fast Mode vs OpenZL Level 1 ──")
+{:ok, level1} = ExOpenzl.create_compression_context()
+:ok = ExOpenzl.set_compression_level(level1, 1)
+messages = [
+  {"256 B", binary_part(medium_text, 0, 256)},
+  {"4 KB", String.duplicate(~s({"id":12345,"status":"ok","items":[1,2,3]}), 100) |> binary_part(0, 4096)},
+  {"64 KB", binary_part(large_text, 0, 65_536)}
+]
+for {label, msg} <- messages do
+  {:ok, fast_c} = ExOpenzl.compress_fast(msg)
+  {:ok, zl_c} = ExOpenzl.compress(level1, msg)
+  Bench.run("compress_fast #{label} (-> #{byte_size(fast_c)} B)", fn -> ExOpenzl.compress_fast(msg) end)
+  Bench.run("openzl level 1 #{label} (-> #{byte_size(zl_c)} B)", fn -> ExOpenzl.compress(level1, msg) end)
+  Bench.run("decompress fast #{label}", fn -> ExOpenzl.decompress(dctx, fast_c) end)
+  Bench.run("decompress level 1 #{label}", fn -> ExOpenzl.decompress(dctx, zl_c) end)
+end
+
 IO.puts("")
 IO.puts("── Typed Compression (Numeric) ──")
 {:ok, tc} = ExOpenzl.create_compression_context()
@@ -130,12 +149,24 @@ end)
 Bench.run("typed numeric u32 5K elements (#{byte_size(u32_data)} B)", fn ->
   ExOpenzl.compress_typed(tc, {:numeric, u32_data, 4})
 end)
+timestamps_10k_be = for i <- 1..10_000, into: <<>>, do: <<1_700_000_000 + i::big-unsigned-64>>
+Bench.run("typed numeric u64 10K big-endian (NIF swap)", fn ->
+  ExOpenzl.compress_typed(tc, {:numeric, timestamps_10k_be, 8}, endianness: :big)
+end)
+Bench.run("typed numeric u64 10K big-endian (Elixir swap)", fn ->
+  swapped = for <<v::big-64 <- timestamps_10k_be>>, into: <<>>, do: <<v::native-64>>
+  ExOpenzl.compress_typed(tc, {:numeric, swapped, 8})
+end)
 Bench.run("typed decompress u64 1K", fn ->
   ExOpenzl.decompress_typed(td, ts1k_compressed)
 end)
 Bench.run("typed decompress u64 10K", fn ->
   ExOpenzl.decompress_typed(td, ts10k_compressed)
 end)
+{:ok, native_buf} = ExOpenzl.buffer_new(1_048_576)
+Bench.run("typed decompress_into u64 10K (reused buffer)", fn ->
+  ExOpenzl.decompress_into(td, ts10k_compressed, native_buf)
+end)
 
 IO.puts("")
 IO.puts("── Typed Compression (Struct) ──")
@@ -162,7 +193,11 @@ end)
 
 IO.puts("")
 IO.puts("── SDDL Pipeline ──")
-Bench.run("sddl compile", fn -> ExOpenzl.sddl_compile(sddl_source) end, 500)
+Bench.run("sddl compile (uncached)", fn ->
+  ExOpenzl.sddl_cache_clear()
+  ExOpenzl.sddl_compile(sddl_source)
+end, 500)
+Bench.run("sddl compile (cached)", fn -> ExOpenzl.sddl_compile(sddl_source) end, 500)
 Bench.run("sddl compress 1K records (#{byte_size(sddl_records)} B)", fn ->
   {:ok, c} = ExOpenzl.create_compression_context()
   :ok = ExOpenzl.set_compressor(c, compressor)
@@ -173,6 +208,53 @@ Bench.run("sddl decompress 1K records", fn ->
   ExOpenzl.decompress(d, sddl_compressed)
 end, 500)
 
+IO.puts("")
+IO.puts("── Native Kernels (#{ExOpenzl.build_info().kernel_isa}) ──")
+# Paths that go through the gather, byteswap and popcount kernels
+f64_10k = for i <- 1..10_000, into: <<>>, do: <<i * 0.5::native-float-64>>
+Bench.run("gather: sddl columns 1K records", fn ->
+  ExOpenzl.decompress_sddl_columns(dctx, sddl_compressed, sddl_source)
+end)
+be_128k = for i <- 1..131_072, into: <<>>, do: <<i * 3::big-unsigned-64>>
+{:ok, be_frame} = ExOpenzl.compress_typed(tc, {:numeric, be_128k, 8}, endianness: :big)
+Bench.run("byteswap: typed u64 128K big-endian compress", fn ->
+  ExOpenzl.compress_typed(tc, {:numeric, be_128k, 8}, endianness: :big)
+end, 200)
+Bench.run("byteswap: typed u64 128K big-endian decompress", fn ->
+  ExOpenzl.decompress_typed(td, be_frame, endianness: :big)
+end, 200)
+n_valid = 262_144
+validity = :binary.copy(<<0b11101110>>, div(n_valid, 8))
+values = for i <- 1..n_valid, into: <<>>, do: <<i::little-64>>
+batch = [%{name: "v", format: "l", length: n_valid, validity: validity, buffers: [values]}]
+Bench.run("popcount: record batch 256K rows with nulls", fn ->
+  ExOpenzl.compress_record_batch(tc, batch)
+end, 100)
+Bench.run("filter_range u64 10K", fn ->
+  ExOpenzl.filter_range(timestamps_10k, {:uint, 8}, 1_700_002_000, 1_700_008_000)
+end)
+Bench.run("filter_range u32 5K", fn ->
+  ExOpenzl.filter_range(u32_data, {:uint, 4}, 100_000, 300_000)
+end)
+Bench.run("filter_range f64 10K", fn ->
+  ExOpenzl.filter_range(f64_10k, {:float, 8}, 100.0, 4000.0)
+end)
+# Scalar reference for the filter_range rows: the same predicate and
+# LSB-first bitmap, built one element at a time
+Bench.run("filter_range u64 10K (Elixir scalar)", fn ->
+  for <<chunk::binary-size(64) <- timestamps_10k>>, into: <<>> do
+    values = for <<v::native-unsigned-64 <- chunk>>, do: v
+
+    byte =
+      for {v, j} <- Enum.with_index(values), v >= 1_700_002_000 and v <= 1_700_008_000,
+          reduce: 0 do
+        acc -> Bitwise.bor(acc, Bitwise.bsl(1, j))
+      end
+
+    <<byte>>
+  end
+end, 100)
+
 IO.puts("")
 IO.puts("── Compression Ratios ──")
 for {label, original, compressed} <- [
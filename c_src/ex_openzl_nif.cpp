@@ -1,15 +1,47 @@
 #include <fine.hpp>
+#include <lz4.h>
 #include <openzl/openzl.h>
 #include <openzl/codecs/zl_generic.h>
+#include <zstd.h>
 
+#include "custom_parsers/sddl/sddl_profile.h"
+#include "tools/sddl/compiler/Compiler.h"
+
+// zstd's vendored xxHash is built with XXH_NO_XXH3, so XXH64 is the fast
+// hash available without another dependency. Inlined, it needs no link-time
+// symbols from libzstd.
+#define XXH_INLINE_ALL
+#include <common/xxhash.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <optional>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
 // ---------------------------------------------------------------------------
 // Resource: Compressor (wraps ZL_Compressor*)
 // Must be declared before CCtx since CCtx can hold a reference to it.
@@ -44,8 +76,15 @@ public:
   ZL_Compressor *default_compressor;
   // Hold a reference to attached compressor to prevent GC
   std::optional<fine::ResourcePtr<Compressor>> compressor_ref;
+  // Level from set_compression_level/2 (0 = library default)
+  int level;
+  // Moving average of serial compression cost in ns per input byte, used
+  // to project deadline-bounded calls (0 = no history yet)
+  double ns_per_byte;
 
-  CCtx() noexcept : ctx(ZL_CCtx_create()), default_compressor(nullptr) {}
+  CCtx() noexcept
+      : ctx(ZL_CCtx_create()), default_compressor(nullptr), level(0),
+        ns_per_byte(0.0) {}
 
   ~CCtx() {
     if (ctx) {
@@ -62,6 +101,18 @@ public:
 
 FINE_RESOURCE(CCtx);
 
+// Fold one observed compression into a ns-per-byte moving average.
+static void record_compress_cost(double &ns_per_byte,
+                                 std::chrono::steady_clock::duration elapsed,
+                                 size_t bytes) {
+  constexpr double kAlpha = 0.25;
+  double observed =
+      std::chrono::duration<double, std::nano>(elapsed).count() / bytes;
+  ns_per_byte = ns_per_byte == 0.0
+                    ? observed
+                    : ns_per_byte + kAlpha * (observed - ns_per_byte);
+}
+
 // ---------------------------------------------------------------------------
 // Resource: Decompression context (reusable across calls)
 // ---------------------------------------------------------------------------
@@ -139,6 +190,629 @@ static const char *type_to_string(ZL_Type type) {
   }
 }
 
+// ---------------------------------------------------------------------------
+// Helper: data-shuffling kernels
+//
+// The NIF's own byte-shuffling loops (field gathers, byte swaps, validity
+// popcounts), reached through one table so callers share a single entry
+// point per kernel. They are built once, for the ISA the NIF is compiled
+// for; the width switches hand the compiler fixed-size loops to vectorise.
+// ---------------------------------------------------------------------------
+
+#if defined(__GNUC__)
+#define EZL_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define EZL_ALWAYS_INLINE inline
+#endif
+
+static EZL_ALWAYS_INLINE uint16_t bswap_value(uint16_t v) {
+  return __builtin_bswap16(v);
+}
+static EZL_ALWAYS_INLINE uint32_t bswap_value(uint32_t v) {
+  return __builtin_bswap32(v);
+}
+static EZL_ALWAYS_INLINE uint64_t bswap_value(uint64_t v) {
+  return __builtin_bswap64(v);
+}
+
+// Byte swaps and field gathers are instantiated once per element width, so
+// inner loops copy a compile-time number of bytes. kByteswapByWidth and
+// kGatherByWidth are the dispatch tables, indexed by width_slot(width);
+// other widths take the generic loops.
+
+static int width_slot(size_t width) {
+  switch (width) {
+  case 1:
+    return 0;
+  case 2:
+    return 1;
+  case 4:
+    return 2;
+  case 8:
+    return 3;
+  case 16:
+    return 4;
+  default:
+    return -1;
+  }
+}
+
+template <size_t W>
+static void byteswap_fixed(const unsigned char *src, unsigned char *dst,
+                           size_t count) {
+  if constexpr (W == 1) {
+    if (src != dst) {
+      std::memcpy(dst, src, count);
+    }
+  } else if constexpr (W == 2 || W == 4 || W == 8) {
+    using U = std::conditional_t<
+        W == 2, uint16_t, std::conditional_t<W == 4, uint32_t, uint64_t>>;
+    for (size_t i = 0; i < count; i++) {
+      U v;
+      std::memcpy(&v, src + i * W, W);
+      v = bswap_value(v);
+      std::memcpy(dst + i * W, &v, W);
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      unsigned char tmp[W];
+      std::memcpy(tmp, src + i * W, W);
+      for (size_t j = 0; j < W; j++) {
+        dst[i * W + j] = tmp[W - 1 - j];
+      }
+    }
+  }
+}
+
+template <size_t W>
+static void gather_fixed(const unsigned char *src, size_t count,
+                         size_t stride, unsigned char *out) {
+  for (size_t i = 0; i < count; i++) {
+    std::memcpy(out + i * W, src + i * stride, W);
+  }
+}
+
+using ByteswapFn = void (*)(const unsigned char *src, unsigned char *dst,
+                            size_t count);
+using GatherFn = void (*)(const unsigned char *src, size_t count,
+                          size_t stride, unsigned char *out);
+
+static constexpr ByteswapFn kByteswapByWidth[] = {
+    byteswap_fixed<1>, byteswap_fixed<2>, byteswap_fixed<4>,
+    byteswap_fixed<8>, byteswap_fixed<16>};
+
+static constexpr GatherFn kGatherByWidth[] = {
+    gather_fixed<1>, gather_fixed<2>, gather_fixed<4>, gather_fixed<8>,
+    gather_fixed<16>};
+
+// Reverse the bytes of each element while copying `src` to `dst`, in a
+// single pass. `src` and `dst` may be the same buffer.
+static EZL_ALWAYS_INLINE void byteswap_kernel(const unsigned char *src,
+                                              unsigned char *dst,
+                                              size_t width, size_t count) {
+  int slot = width_slot(width);
+  if (slot >= 0) {
+    return kByteswapByWidth[slot](src, dst, count);
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (src == dst) {
+      std::reverse(dst + i * width, dst + (i + 1) * width);
+    } else {
+      std::reverse_copy(src + i * width, src + (i + 1) * width,
+                        dst + i * width);
+    }
+  }
+}
+
+// Copy `bytes` bytes at every `stride` from `src` into a contiguous `out`.
+static EZL_ALWAYS_INLINE void gather_kernel(const unsigned char *src,
+                                            size_t count, size_t stride,
+                                            size_t bytes,
+                                            unsigned char *out) {
+  int slot = width_slot(bytes);
+  if (slot >= 0) {
+    return kGatherByWidth[slot](src, count, stride, out);
+  }
+  for (size_t i = 0; i < count; i++) {
+    std::memcpy(out + i * bytes, src + i * stride, bytes);
+  }
+}
+
+static EZL_ALWAYS_INLINE uint64_t popcount_kernel(const unsigned char *data,
+                                                  size_t size) {
+  uint64_t total = 0;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    total += static_cast<uint64_t>(__builtin_popcountll(word));
+  }
+  for (; i < size; i++) {
+    total += static_cast<uint64_t>(__builtin_popcount(data[i]));
+  }
+  return total;
+}
+
+struct KernelTable {
+  const char *isa;
+  void (*byteswap)(const unsigned char *src, unsigned char *dst, size_t width,
+                   size_t count);
+  void (*gather)(const unsigned char *src, size_t count, size_t stride,
+                 size_t bytes, unsigned char *out);
+  uint64_t (*popcount)(const unsigned char *data, size_t size);
+};
+
+static void byteswap_baseline(const unsigned char *src, unsigned char *dst,
+                              size_t width, size_t count) {
+  byteswap_kernel(src, dst, width, count);
+}
+
+static void gather_baseline(const unsigned char *src, size_t count,
+                            size_t stride, size_t bytes, unsigned char *out) {
+  gather_kernel(src, count, stride, bytes, out);
+}
+
+static uint64_t popcount_baseline(const unsigned char *data, size_t size) {
+  return popcount_kernel(data, size);
+}
+
+static const KernelTable kKernels = {"baseline", byteswap_baseline,
+                                     gather_baseline, popcount_baseline};
+
+// ---------------------------------------------------------------------------
+// Helper: per-thread staging arena for kernels that need a scratch copy of
+// their input (e.g. byte-swapped numeric columns). NIFs run on scheduler
+// threads, so one arena per thread needs no locking. Arenas grown past
+// kStagingRetainBytes are released after use.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kStagingRetainBytes = 16 * 1024 * 1024;
+
+static std::vector<unsigned char> &staging_arena(size_t size) {
+  thread_local std::vector<unsigned char> arena;
+  if (arena.size() < size) {
+    arena.resize(size);
+  }
+  return arena;
+}
+
+template <typename Buffer> static void staging_release(Buffer &arena) {
+  if (arena.capacity() * sizeof(typename Buffer::value_type) >
+      kStagingRetainBytes) {
+    Buffer().swap(arena);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Helper: element-typed kernels
+//
+// Aggregation and filtering over fixed-width numeric columns, instantiated
+// once per element type so inner loops carry no width or signedness
+// branches. kElementKernels is the compile-time dispatch table, indexed by
+// element_type_index(kind, width). Values and bounds cross the table as
+// the bits of the widened type (u64, i64 or double); comparisons happen in
+// the element type itself.
+// ---------------------------------------------------------------------------
+
+enum class ElementKind : uint8_t { UInt = 0, Int = 1, Float = 2 };
+
+template <typename T>
+using WideOf = std::conditional_t<
+    std::is_floating_point_v<T>, double,
+    std::conditional_t<std::is_signed_v<T>, int64_t, uint64_t>>;
+
+template <typename T> struct ElementOps {
+  using Wide = WideOf<T>;
+
+  static EZL_ALWAYS_INLINE T load(const unsigned char *data, size_t i) {
+    T v;
+    std::memcpy(&v, data + i * sizeof(T), sizeof(T));
+    return v;
+  }
+
+  // Min and max of the column. NaN compares false both ways, so once the
+  // range is seeded with a non-NaN value, NaNs never narrow it.
+  static bool min_max(const unsigned char *data, size_t count,
+                      uint64_t &min_bits, uint64_t &max_bits) {
+    size_t i = 0;
+    if constexpr (std::is_floating_point_v<T>) {
+      while (i < count && load(data, i) != load(data, i)) {
+        i++;
+      }
+    }
+    if (i == count) {
+      return false;
+    }
+    T lo = load(data, i), hi = lo;
+    for (i++; i < count; i++) {
+      T v = load(data, i);
+      lo = v < lo ? v : lo;
+      hi = v > hi ? v : hi;
+    }
+    Wide lo_wide = lo, hi_wide = hi;
+    std::memcpy(&min_bits, &lo_wide, sizeof(uint64_t));
+    std::memcpy(&max_bits, &hi_wide, sizeof(uint64_t));
+    return true;
+  }
+
+  // Narrow widened bounds to the tightest [lo_t, hi_t] in T that keeps the
+  // same matches, so the scan compares in T at the column's own width.
+  // Returns false when no value of T can match.
+  static bool narrow_bounds(Wide lo, Wide hi, T &lo_t, T &hi_t) {
+    if constexpr (std::is_floating_point_v<T>) {
+      if (!(lo <= hi)) {
+        return false; // also a NaN bound
+      }
+      if constexpr (std::is_same_v<T, Wide>) {
+        lo_t = lo;
+        hi_t = hi;
+      } else {
+        constexpr Wide t_max = std::numeric_limits<T>::max();
+        constexpr T inf = std::numeric_limits<T>::infinity();
+        // Smallest T >= lo and largest T <= hi
+        if (lo > t_max) {
+          lo_t = inf;
+        } else if (lo < -t_max) {
+          lo_t = lo == -Wide(inf) ? -inf : -T(t_max);
+        } else {
+          lo_t = static_cast<T>(lo);
+          if (Wide(lo_t) < lo) {
+            lo_t = std::nextafter(lo_t, inf);
+          }
+        }
+        if (hi < -t_max) {
+          hi_t = -inf;
+        } else if (hi > t_max) {
+          hi_t = hi == Wide(inf) ? inf : T(t_max);
+        } else {
+          hi_t = static_cast<T>(hi);
+          if (Wide(hi_t) > hi) {
+            hi_t = std::nextafter(hi_t, -inf);
+          }
+        }
+      }
+      return lo_t <= hi_t;
+    } else {
+      constexpr Wide t_min = std::numeric_limits<T>::min();
+      constexpr Wide t_max = std::numeric_limits<T>::max();
+      if (lo > hi || hi < t_min || lo > t_max) {
+        return false;
+      }
+      lo_t = static_cast<T>(lo < t_min ? t_min : lo);
+      hi_t = static_cast<T>(hi > t_max ? t_max : hi);
+      return true;
+    }
+  }
+
+  // Set bit i of `bitmap` (LSB first, Arrow validity order) when
+  // lo <= v <= hi. Returns the number of matches.
+  static uint64_t filter_range(const unsigned char *data, size_t count,
+                               uint64_t lo_bits, uint64_t hi_bits,
+                               unsigned char *bitmap) {
+    Wide lo_wide, hi_wide;
+    std::memcpy(&lo_wide, &lo_bits, sizeof(Wide));
+    std::memcpy(&hi_wide, &hi_bits, sizeof(Wide));
+    T lo, hi;
+    if (!narrow_bounds(lo_wide, hi_wide, lo, hi)) {
+      std::memset(bitmap, 0, count / 8 + (count % 8 != 0));
+      return 0;
+    }
+
+    uint64_t matches = 0;
+    size_t full = count / 8;
+    for (size_t g = 0; g < full; g++) {
+      unsigned mask = 0;
+      for (unsigned j = 0; j < 8; j++) {
+        T v = load(data, g * 8 + j);
+        mask |= static_cast<unsigned>((v >= lo) & (v <= hi)) << j;
+      }
+      bitmap[g] = static_cast<unsigned char>(mask);
+      matches += static_cast<uint64_t>(__builtin_popcount(mask));
+    }
+    if (count % 8 != 0) {
+      unsigned mask = 0;
+      for (unsigned j = 0; j < count % 8; j++) {
+        T v = load(data, full * 8 + j);
+        mask |= static_cast<unsigned>((v >= lo) & (v <= hi)) << j;
+      }
+      bitmap[full] = static_cast<unsigned char>(mask);
+      matches += static_cast<uint64_t>(__builtin_popcount(mask));
+    }
+    return matches;
+  }
+};
+
+struct ElementKernels {
+  bool (*min_max)(const unsigned char *data, size_t count,
+                  uint64_t &min_bits, uint64_t &max_bits);
+  uint64_t (*filter_range)(const unsigned char *data, size_t count,
+                           uint64_t lo_bits, uint64_t hi_bits,
+                           unsigned char *bitmap);
+};
+
+template <typename T> constexpr ElementKernels element_kernels_for() {
+  return {ElementOps<T>::min_max, ElementOps<T>::filter_range};
+}
+
+static constexpr ElementKernels kElementKernels[] = {
+    element_kernels_for<uint8_t>(),  element_kernels_for<uint16_t>(),
+    element_kernels_for<uint32_t>(), element_kernels_for<uint64_t>(),
+    element_kernels_for<int8_t>(),   element_kernels_for<int16_t>(),
+    element_kernels_for<int32_t>(),  element_kernels_for<int64_t>(),
+    element_kernels_for<float>(),    element_kernels_for<double>(),
+};
+
+// Index into kElementKernels, or -1 for unsupported kind/width pairs.
+static int element_type_index(ElementKind kind, size_t width) {
+  int slot;
+  switch (width) {
+  case 1:
+    slot = 0;
+    break;
+  case 2:
+    slot = 1;
+    break;
+  case 4:
+    slot = 2;
+    break;
+  case 8:
+    slot = 3;
+    break;
+  default:
+    return -1;
+  }
+  switch (kind) {
+  case ElementKind::UInt:
+    return slot;
+  case ElementKind::Int:
+    return 4 + slot;
+  case ElementKind::Float:
+    return slot >= 2 ? 8 + (slot - 2) : -1;
+  }
+  return -1;
+}
+
+// ---------------------------------------------------------------------------
+// Helper: little-endian integer encoding for native container formats
+// ---------------------------------------------------------------------------
+
+static void put_le32(std::string &out, uint32_t v) {
+  const char bytes[4] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                         static_cast<char>(v >> 16),
+                         static_cast<char>(v >> 24)};
+  out.append(bytes, sizeof(bytes));
+}
+
+static void put_le64(std::string &out, uint64_t v) {
+  put_le32(out, static_cast<uint32_t>(v));
+  put_le32(out, static_cast<uint32_t>(v >> 32));
+}
+
+static uint32_t get_le32(const void *src) {
+  const unsigned char *p = static_cast<const unsigned char *>(src);
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t get_le64(const void *src) {
+  const unsigned char *p = static_cast<const unsigned char *>(src);
+  return static_cast<uint64_t>(get_le32(p)) |
+         (static_cast<uint64_t>(get_le32(p + 4)) << 32);
+}
+
+// ---------------------------------------------------------------------------
+// Private format magics
+// Every container this module writes is tagged with a 4-byte "EZL?" magic.
+// They are all declared here, and checked for uniqueness at compile time,
+// so a new format cannot silently reuse one. None of them starts an OpenZL
+// or zstd frame.
+// ---------------------------------------------------------------------------
+
+static constexpr char kLz4Magic[4] = {'E', 'Z', 'L', '4'};      // compress_fast
+static constexpr char kChunkedMagic[4] = {'E', 'Z', 'L', 'K'};  // chunked
+static constexpr char kLogMagic[4] = {'E', 'Z', 'L', 'G'};      // log header
+static constexpr char kLogIndexMagic[4] = {'E', 'Z', 'L', 'I'}; // log footer
+static constexpr char kColumnarMagic[4] = {'E', 'Z', 'L', 'C'}; // columnar
+static constexpr char kDispatchMagic[4] = {'E', 'Z', 'L', 'D'}; // dispatch
+
+static constexpr const char *kFormatMagics[] = {
+    kLz4Magic,      kChunkedMagic,  kLogMagic,
+    kLogIndexMagic, kColumnarMagic, kDispatchMagic};
+
+static constexpr bool format_magics_unique() {
+  constexpr size_t n = sizeof(kFormatMagics) / sizeof(kFormatMagics[0]);
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      bool same = true;
+      for (size_t k = 0; k < 4; k++) {
+        same = same && kFormatMagics[i][k] == kFormatMagics[j][k];
+      }
+      if (same) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static_assert(format_magics_unique(), "format magics must be distinct");
+
+// ---------------------------------------------------------------------------
+// Helper: LZ4 envelope
+//
+//   "EZL4" u32 original_size (LE), LZ4 block
+//
+// Written by compress_fast/2 for latency-bound payloads. decompress/1,2
+// recognise the magic, which never starts an OpenZL frame, and decode the
+// block with the liblz4 OpenZL already links.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kLz4HeaderSize = 8;
+
+static bool is_lz4_envelope(std::string_view data) {
+  return data.size() >= kLz4HeaderSize &&
+         std::memcmp(data.data(), kLz4Magic, sizeof(kLz4Magic)) == 0;
+}
+
+static std::optional<std::string> lz4_wrap(std::string_view input,
+                                           int acceleration,
+                                           std::string &out) {
+  if (input.size() > LZ4_MAX_INPUT_SIZE) {
+    return std::string("input too large for LZ4");
+  }
+  int src_size = static_cast<int>(input.size());
+  int bound = LZ4_compressBound(src_size);
+  out.resize(kLz4HeaderSize + static_cast<size_t>(bound));
+  std::memcpy(out.data(), kLz4Magic, sizeof(kLz4Magic));
+  for (int i = 0; i < 4; i++) {
+    out[4 + i] = static_cast<char>(static_cast<uint32_t>(src_size) >> (8 * i));
+  }
+  int written = LZ4_compress_fast(input.data(), out.data() + kLz4HeaderSize,
+                                  src_size, bound, acceleration);
+  if (written <= 0) {
+    return std::string("LZ4 compression failed");
+  }
+  out.resize(kLz4HeaderSize + static_cast<size_t>(written));
+  return std::nullopt;
+}
+
+static std::optional<std::string> lz4_unwrap(std::string_view envelope,
+                                             std::string &out) {
+  const unsigned char *p =
+      reinterpret_cast<const unsigned char *>(envelope.data()) + 4;
+  uint32_t size = static_cast<uint32_t>(p[0]) |
+                  (static_cast<uint32_t>(p[1]) << 8) |
+                  (static_cast<uint32_t>(p[2]) << 16) |
+                  (static_cast<uint32_t>(p[3]) << 24);
+  size_t block_size = envelope.size() - kLz4HeaderSize;
+  // An LZ4 block expands at most 255:1, so a larger claimed size is
+  // corrupt; checking first keeps a tiny input from forcing a huge resize
+  if (size > LZ4_MAX_INPUT_SIZE || block_size > LZ4_MAX_INPUT_SIZE ||
+      size > static_cast<uint64_t>(block_size) * 255 + 16) {
+    return std::string("corrupt LZ4 envelope");
+  }
+  out.resize(size);
+  int n = LZ4_decompress_safe(envelope.data() + kLz4HeaderSize, out.data(),
+                              static_cast<int>(block_size),
+                              static_cast<int>(size));
+  if (n < 0 || static_cast<uint32_t>(n) != size) {
+    return std::string("LZ4 decompression failed");
+  }
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// Helper: chunked container
+//
+//   "EZLK" u32 chunk_size  u64 raw_size  u32 chunk_count
+//   u32 frame_size[chunk_count]  frame[chunk_count]
+//
+// Written by compress_chunked/3. Each chunk is an independent serial OpenZL
+// frame and every chunk but the last decodes to exactly chunk_size bytes, so
+// any raw offset maps to a chunk from the header alone. decompress_prefix/4
+// decodes only the chunks covering the requested range; decompress/1,2
+// decode them all.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kChunkedHeaderSize = 20;
+
+struct ChunkedIndex {
+  uint64_t chunk_size = 0;
+  uint64_t raw_size = 0;
+  std::vector<std::string_view> frames;
+};
+
+static bool is_chunked_container(std::string_view data) {
+  return data.size() >= kChunkedHeaderSize &&
+         std::memcmp(data.data(), kChunkedMagic, sizeof(kChunkedMagic)) == 0;
+}
+
+static std::optional<std::string> parse_chunked(std::string_view data,
+                                                ChunkedIndex &index) {
+  uint32_t chunk_size = get_le32(data.data() + 4);
+  uint64_t raw_size = get_le64(data.data() + 8);
+  uint32_t count = get_le32(data.data() + 16);
+  if (chunk_size == 0 ||
+      count != raw_size / chunk_size + (raw_size % chunk_size != 0) ||
+      count > (data.size() - kChunkedHeaderSize) / 4) {
+    return std::string("corrupt chunked container header");
+  }
+
+  index.chunk_size = chunk_size;
+  index.raw_size = raw_size;
+  index.frames.clear();
+  index.frames.reserve(count);
+  size_t offset = kChunkedHeaderSize + static_cast<size_t>(count) * 4;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t size = get_le32(data.data() + kChunkedHeaderSize + i * 4);
+    if (size > data.size() - offset) {
+      return std::string("truncated chunked container");
+    }
+    index.frames.push_back(data.substr(offset, size));
+    offset += size;
+  }
+  if (offset != data.size()) {
+    return std::string("trailing bytes after chunked container");
+  }
+  return std::nullopt;
+}
+
+// Checks that chunk i's frame declares the size the index implies.
+static std::optional<std::string> check_chunk_size(const ChunkedIndex &index,
+                                                   size_t i,
+                                                   uint64_t &expected) {
+  std::string_view frame = index.frames[i];
+  expected = i + 1 == index.frames.size()
+                 ? index.raw_size - i * index.chunk_size
+                 : index.chunk_size;
+  ZL_Report declared = ZL_getDecompressedSize(frame.data(), frame.size());
+  if (ZL_isError(declared) || ZL_validResult(declared) != expected) {
+    return "chunk " + std::to_string(i) + " does not match the header";
+  }
+  return std::nullopt;
+}
+
+// Appends chunk i to out. A null dctx uses one-shot decompression.
+static std::optional<std::string> decode_chunk(ZL_DCtx *dctx,
+                                               const ChunkedIndex &index,
+                                               size_t i, std::string &out) {
+  std::string_view frame = index.frames[i];
+  uint64_t expected;
+  if (auto err = check_chunk_size(index, i, expected)) {
+    return err;
+  }
+
+  size_t start = out.size();
+  out.resize(start + expected);
+  ZL_Report result =
+      dctx ? ZL_DCtx_decompress(dctx, out.data() + start, expected,
+                                frame.data(), frame.size())
+           : ZL_decompress(out.data() + start, expected, frame.data(),
+                           frame.size());
+  if (ZL_isError(result) || ZL_validResult(result) != expected) {
+    out.resize(start);
+    return "decompression failed in chunk " + std::to_string(i);
+  }
+  return std::nullopt;
+}
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+decompress_chunked(ZL_DCtx *dctx, std::string_view data) {
+  ChunkedIndex index;
+  if (auto err = parse_chunked(data, index)) {
+    return fine::Error(std::move(*err));
+  }
+  std::string output;
+  output.reserve(index.raw_size);
+  for (size_t i = 0; i < index.frames.size(); i++) {
+    if (auto err = decode_chunk(dctx, index, i, output)) {
+      return fine::Error(std::move(*err));
+    }
+  }
+  return fine::Ok(std::move(output));
+}
+
 // ===================================================================
 // Phase 0: Original NIFs
 // ===================================================================
@@ -210,6 +884,7 @@ nif_compress_with_context(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
   size_t bound = ZL_compressBound(input.size());
   std::string output(bound, '\0');
 
+  auto start = std::chrono::steady_clock::now();
   ZL_Report result = ZL_CCtx_compress(cctx->ctx, output.data(), bound,
                                        input.data(), input.size());
 
@@ -218,6 +893,8 @@ nif_compress_with_context(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
     std::string msg = err ? std::string(err) : "compression failed";
     return fine::Error(std::move(msg));
   }
+  record_compress_cost(cctx->ns_per_byte,
+                       std::chrono::steady_clock::now() - start, input.size());
 
   output.resize(ZL_validResult(result));
   return fine::Ok(std::move(output));
@@ -234,6 +911,16 @@ nif_decompress(ErlNifEnv *env, std::string_view compressed) {
   if (compressed.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
+  if (is_lz4_envelope(compressed)) {
+    std::string output;
+    if (auto err = lz4_unwrap(compressed, output)) {
+      return fine::Error(std::move(*err));
+    }
+    return fine::Ok(std::move(output));
+  }
+  if (is_chunked_container(compressed)) {
+    return decompress_chunked(nullptr, compressed);
+  }
 
   ZL_Report decompressed_size =
       ZL_getDecompressedSize(compressed.data(), compressed.size());
@@ -269,6 +956,12 @@ nif_decompress_with_context(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
   if (compressed.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
+  if (is_lz4_envelope(compressed)) {
+    return nif_decompress(env, compressed);
+  }
+  if (is_chunked_container(compressed)) {
+    return decompress_chunked(dctx->ctx, compressed);
+  }
 
   ZL_Report decompressed_size =
       ZL_getDecompressedSize(compressed.data(), compressed.size());
@@ -394,6 +1087,9 @@ nif_set_compression_level(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
     std::string msg = err ? std::string(err) : "failed to set compression level";
     return fine::Error(std::move(msg));
   }
+  cctx->level = static_cast<int>(level);
+  // Costs measured at the old level no longer apply
+  cctx->ns_per_byte = 0.0;
   return fine::Ok(fine::Atom("ok"));
 }
 
@@ -404,13 +1100,16 @@ FINE_NIF(nif_set_compression_level, 0);
 // ===================================================================
 
 // ---------------------------------------------------------------------------
-// NIF: compress_typed_numeric/3
-// Compress numeric data: (cctx, binary, element_width)
+// NIF: compress_typed_numeric/4
+// Compress numeric data: (cctx, binary, element_width, byte_swap)
+// With byte_swap, elements are in non-native byte order and are swapped
+// into the staging arena before compression.
 // ---------------------------------------------------------------------------
 
 static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
 nif_compress_typed_numeric(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
-                           std::string_view data, uint64_t element_width) {
+                           std::string_view data, uint64_t element_width,
+                           bool byte_swap) {
   if (data.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
@@ -425,7 +1124,16 @@ nif_compress_typed_numeric(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
         std::string("data size must be a multiple of element_width"));
   }
 
-  TypedRefPtr tref(ZL_TypedRef_createNumeric(data.data(), element_width,
+  const void *elements = data.data();
+  std::vector<unsigned char> *arena = nullptr;
+  if (byte_swap && element_width > 1) {
+    arena = &staging_arena(data.size());
+    kKernels.byteswap(reinterpret_cast<const unsigned char *>(data.data()),
+                      arena->data(), element_width, num_elements);
+    elements = arena->data();
+  }
+
+  TypedRefPtr tref(ZL_TypedRef_createNumeric(elements, element_width,
                                               num_elements));
   if (!tref) {
     return fine::Error(std::string("failed to create numeric typed ref"));
@@ -436,6 +1144,9 @@ nif_compress_typed_numeric(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
 
   ZL_Report result = ZL_CCtx_compressTypedRef(cctx->ctx, output.data(), bound,
                                                tref.get());
+  if (arena) {
+    staging_release(*arena);
+  }
 
   if (ZL_isError(result)) {
     const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
@@ -495,29 +1206,187 @@ nif_compress_typed_struct(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
 FINE_NIF(nif_compress_typed_struct, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // ---------------------------------------------------------------------------
-// NIF: compress_typed_string/3
-// Compress string data: (cctx, binary, lengths_list_as_binary)
-// lengths is a binary of packed uint32_t little-endian values
+// Helper: string length formats
+//
+// compress_typed_string and compress_multi_typed accept string lengths in
+// any of these encodings and convert them to the u32 array OpenZL wants in
+// one pass. Fixed-width values are native-endian, like the string lengths
+// decompress_typed returns, and may be unaligned. OpenZL caps each string
+// at 4 GB, so longer lengths are rejected.
+// ---------------------------------------------------------------------------
+
+enum class LengthsFormat : uint64_t {
+  U32 = 0,       // one u32 per string
+  U64 = 1,       // one u64 per string
+  Varint = 2,    // one unsigned LEB128 value per string
+  Offsets32 = 3, // Arrow-style: num_strings + 1 u32 offsets into data
+  Offsets64 = 4, // Arrow-style: num_strings + 1 u64 offsets into data
+};
+
+template <typename T> static EZL_ALWAYS_INLINE T load_unaligned(const char *p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+// Per-string lengths of width T. Branch-free so the loop vectorises.
+template <typename T>
+static std::optional<std::string>
+lengths_from_fixed(std::string_view lens, std::vector<uint32_t> &out,
+                   uint64_t &total) {
+  if (lens.size() % sizeof(T) != 0) {
+    return "lengths binary size must be a multiple of " +
+           std::to_string(sizeof(T));
+  }
+  size_t n = lens.size() / sizeof(T);
+  out.resize(n);
+  uint64_t sum = 0, high = 0;
+  for (size_t i = 0; i < n; i++) {
+    uint64_t v = load_unaligned<T>(lens.data() + i * sizeof(T));
+    high |= v >> 32;
+    sum += v;
+    out[i] = static_cast<uint32_t>(v);
+  }
+  if (high != 0) {
+    return std::string("string lengths over 4 GB are not supported");
+  }
+  total = sum;
+  return std::nullopt;
+}
+
+template <typename T>
+static std::optional<std::string>
+lengths_from_offsets(std::string_view offsets, std::vector<uint32_t> &out,
+                     uint64_t &first, uint64_t &last) {
+  if (offsets.size() % sizeof(T) != 0 || offsets.size() < sizeof(T)) {
+    return "offsets binary must hold at least one offset of " +
+           std::to_string(sizeof(T)) + " bytes";
+  }
+  size_t n = offsets.size() / sizeof(T) - 1;
+  out.resize(n);
+  T prev = load_unaligned<T>(offsets.data());
+  first = prev;
+  uint64_t bad = 0;
+  for (size_t i = 0; i < n; i++) {
+    T next = load_unaligned<T>(offsets.data() + (i + 1) * sizeof(T));
+    uint64_t len = static_cast<uint64_t>(next) - prev;
+    bad |= static_cast<uint64_t>(next < prev) | (len >> 32);
+    out[i] = static_cast<uint32_t>(len);
+    prev = next;
+  }
+  if (bad != 0) {
+    return std::string(
+        "offsets must be non-decreasing with strings under 4 GB");
+  }
+  last = prev;
+  return std::nullopt;
+}
+
+static std::optional<std::string>
+lengths_from_varint(std::string_view lens, std::vector<uint32_t> &out,
+                    uint64_t &total) {
+  out.clear();
+  out.reserve(lens.size());
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(lens.data());
+  const unsigned char *end = p + lens.size();
+  uint64_t sum = 0;
+  while (p < end) {
+    // Fast path: most strings are under 128 bytes
+    if (*p < 0x80) {
+      sum += *p;
+      out.push_back(*p++);
+      continue;
+    }
+    uint64_t v = 0;
+    unsigned shift = 0;
+    for (;;) {
+      if (p == end || shift > 28) {
+        return std::string("malformed varint length");
+      }
+      unsigned char b = *p++;
+      v |= static_cast<uint64_t>(b & 0x7F) << shift;
+      shift += 7;
+      if (!(b & 0x80)) {
+        break;
+      }
+    }
+    if (v > std::numeric_limits<uint32_t>::max()) {
+      return std::string("string lengths over 4 GB are not supported");
+    }
+    sum += v;
+    out.push_back(static_cast<uint32_t>(v));
+  }
+  total = sum;
+  return std::nullopt;
+}
+
+// Decodes lens in the given format into out. Offsets may start past zero
+// (a sliced Arrow array), in which case data is narrowed to the referenced
+// range.
+static std::optional<std::string>
+decode_string_lengths(std::string_view lens, uint64_t format,
+                      std::string_view &data, std::vector<uint32_t> &out) {
+  uint64_t total = 0;
+  std::optional<std::string> err;
+  switch (static_cast<LengthsFormat>(format)) {
+  case LengthsFormat::U32:
+    err = lengths_from_fixed<uint32_t>(lens, out, total);
+    break;
+  case LengthsFormat::U64:
+    err = lengths_from_fixed<uint64_t>(lens, out, total);
+    break;
+  case LengthsFormat::Varint:
+    err = lengths_from_varint(lens, out, total);
+    break;
+  case LengthsFormat::Offsets32:
+  case LengthsFormat::Offsets64: {
+    uint64_t first = 0, last = 0;
+    err = static_cast<LengthsFormat>(format) == LengthsFormat::Offsets32
+              ? lengths_from_offsets<uint32_t>(lens, out, first, last)
+              : lengths_from_offsets<uint64_t>(lens, out, first, last);
+    if (err) {
+      return err;
+    }
+    if (last > data.size()) {
+      return std::string("offsets point past the end of the string data");
+    }
+    data = data.substr(first, last - first);
+    return std::nullopt;
+  }
+  default:
+    return std::string("unknown lengths format");
+  }
+  if (err) {
+    return err;
+  }
+  if (total != data.size()) {
+    return std::string("string lengths do not add up to the data size");
+  }
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: compress_typed_string/4
+// Compress string data: (cctx, binary, lengths_binary, lengths_format)
+// lengths_format is a LengthsFormat code
 // ---------------------------------------------------------------------------
 
 static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
 nif_compress_typed_string(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
-                          std::string_view data,
-                          std::string_view lengths_bin) {
+                          std::string_view data, std::string_view lengths_bin,
+                          uint64_t lengths_format) {
   if (data.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
-  if (lengths_bin.size() % sizeof(uint32_t) != 0) {
-    return fine::Error(
-        std::string("lengths binary size must be a multiple of 4"));
-  }
 
-  size_t nb_strings = lengths_bin.size() / sizeof(uint32_t);
-  const uint32_t *lengths =
-      reinterpret_cast<const uint32_t *>(lengths_bin.data());
+  std::vector<uint32_t> lengths;
+  if (auto err = decode_string_lengths(lengths_bin, lengths_format, data,
+                                       lengths)) {
+    return fine::Error(std::move(*err));
+  }
 
-  TypedRefPtr tref(
-      ZL_TypedRef_createString(data.data(), data.size(), lengths, nb_strings));
+  TypedRefPtr tref(ZL_TypedRef_createString(data.data(), data.size(),
+                                            lengths.data(), lengths.size()));
   if (!tref) {
     return fine::Error(std::string("failed to create string typed ref"));
   }
@@ -547,7 +1416,7 @@ FINE_NIF(nif_compress_typed_string, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 // Each tuple is one of:
 //   {:numeric, binary, width}
 //   {:struct, binary, struct_width}
-//   {:string, binary, lengths_binary}
+//   {:string, binary, lengths_binary | {lengths_format, lengths_binary}}
 // We accept fine::Term and manually decode.
 // ---------------------------------------------------------------------------
 
@@ -576,6 +1445,7 @@ nif_compress_multi_typed(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
   // Iterate the list and build TypedRefs
   std::vector<TypedRefPtr> refs;
   std::vector<const ZL_TypedRef *> ref_ptrs;
+  std::vector<std::vector<uint32_t>> string_lengths;
   size_t total_size = 0;
 
   ERL_NIF_TERM head, tail;
@@ -652,25 +1522,39 @@ nif_compress_multi_typed(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
       refs.push_back(std::move(ref));
 
     } else if (std::strcmp(type_atom, "string") == 0) {
+      // Lengths are a u32 binary or a {format_code, binary} pair
       ErlNifBinary lens_bin;
-      if (!enif_inspect_binary(env, tuple_terms[2], &lens_bin)) {
-        return fine::Error(
-            std::string("string lengths must be a binary of uint32_t values"));
+      ErlNifUInt64 format = static_cast<uint64_t>(LengthsFormat::U32);
+      int lens_arity;
+      const ERL_NIF_TERM *lens_terms;
+      bool ok = enif_inspect_binary(env, tuple_terms[2], &lens_bin);
+      if (!ok && enif_get_tuple(env, tuple_terms[2], &lens_arity, &lens_terms) &&
+          lens_arity == 2) {
+        ok = enif_get_uint64(env, lens_terms[0], &format) &&
+             enif_inspect_binary(env, lens_terms[1], &lens_bin);
       }
-      if (lens_bin.size % sizeof(uint32_t) != 0) {
+      if (!ok) {
         return fine::Error(std::string(
-            "string lengths binary size must be a multiple of 4"));
+            "string lengths must be a binary or {format, binary}"));
+      }
+      std::string_view str_data(reinterpret_cast<const char *>(bin.data),
+                                bin.size);
+      std::vector<uint32_t> lengths;
+      if (auto err = decode_string_lengths(
+              std::string_view(reinterpret_cast<const char *>(lens_bin.data),
+                               lens_bin.size),
+              format, str_data, lengths)) {
+        return fine::Error(std::move(*err));
       }
-      size_t nb_strings = lens_bin.size / sizeof(uint32_t);
-      const uint32_t *lengths =
-          reinterpret_cast<const uint32_t *>(lens_bin.data);
-      TypedRefPtr ref(ZL_TypedRef_createString(bin.data, bin.size,
-                                                lengths, nb_strings));
+      TypedRefPtr ref(ZL_TypedRef_createString(
+          str_data.data(), str_data.size(), lengths.data(), lengths.size()));
       if (!ref) {
         return fine::Error(
             std::string("failed to create string typed ref"));
       }
-      total_size += bin.size;
+      // The typed ref points at the lengths, so keep them alive
+      string_lengths.push_back(std::move(lengths));
+      total_size += str_data.size();
       ref_ptrs.push_back(ref.get());
       refs.push_back(std::move(ref));
 
@@ -712,14 +1596,35 @@ nif_compress_multi_typed(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
 FINE_NIF(nif_compress_multi_typed, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // ---------------------------------------------------------------------------
-// NIF: decompress_typed/2
+// Helper: copy a decoded output into a new binary, swapping numeric
+// elements to non-native byte order when requested.
+// ---------------------------------------------------------------------------
+
+static ERL_NIF_TERM make_output_binary(ErlNifEnv *env, ZL_Type type,
+                                       const void *data, size_t byte_size,
+                                       size_t elt_width, size_t num_elts,
+                                       bool byte_swap) {
+  ERL_NIF_TERM bin;
+  unsigned char *out = enif_make_new_binary(env, byte_size, &bin);
+  if (byte_swap && type == ZL_Type_numeric && elt_width > 1) {
+    kKernels.byteswap(static_cast<const unsigned char *>(data), out,
+                      elt_width, num_elts);
+  } else {
+    std::memcpy(out, data, byte_size);
+  }
+  return bin;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_typed/3
 // Decompress a single typed output using TypedBuffer (auto-allocates).
+// With byte_swap, numeric outputs are returned in non-native byte order.
 // Returns {:ok, map} with type info + data, or {:error, reason}.
 // ---------------------------------------------------------------------------
 
 static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
 nif_decompress_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
-                     std::string_view compressed) {
+                     std::string_view compressed, bool byte_swap) {
   if (compressed.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
@@ -745,9 +1650,8 @@ nif_decompress_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
   const void *data_ptr = ZL_TypedBuffer_rPtr(tbuf.get());
 
   // Build the data binary
-  ERL_NIF_TERM data_bin;
-  unsigned char *bin_ptr = enif_make_new_binary(env, byte_size, &data_bin);
-  std::memcpy(bin_ptr, data_ptr, byte_size);
+  ERL_NIF_TERM data_bin = make_output_binary(
+      env, type, data_ptr, byte_size, elt_width, num_elts, byte_swap);
 
   // Build the result map
   ERL_NIF_TERM map = enif_make_new_map(env);
@@ -787,13 +1691,14 @@ nif_decompress_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
 FINE_NIF(nif_decompress_typed, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // ---------------------------------------------------------------------------
-// NIF: decompress_multi_typed/2
+// NIF: decompress_multi_typed/3
 // Decompress a multi-output frame into a list of typed result maps.
+// byte_swap applies to numeric outputs as in decompress_typed.
 // ---------------------------------------------------------------------------
 
 static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
 nif_decompress_multi_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
-                           std::string_view compressed) {
+                           std::string_view compressed, bool byte_swap) {
   if (compressed.empty()) {
     return fine::Error(std::string("input must not be empty"));
   }
@@ -840,9 +1745,8 @@ nif_decompress_multi_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
     size_t elt_width = ZL_TypedBuffer_eltWidth(tbuf);
     const void *data_ptr = ZL_TypedBuffer_rPtr(tbuf);
 
-    ERL_NIF_TERM data_bin;
-    unsigned char *bin_ptr = enif_make_new_binary(env, byte_size, &data_bin);
-    std::memcpy(bin_ptr, data_ptr, byte_size);
+    ERL_NIF_TERM data_bin = make_output_binary(
+        env, type, data_ptr, byte_size, elt_width, num_elts, byte_swap);
 
     ERL_NIF_TERM keys[5], vals[5];
     keys[0] = fine::__private__::make_atom(env, "type");
@@ -963,81 +1867,194 @@ FINE_NIF(nif_frame_info, 0);
 // ===================================================================
 
 // ---------------------------------------------------------------------------
-// NIF: sddl_compile/1
-// Compile SDDL source text to binary description.
+// Helper: compiled SDDL cache
+//
+// Compiling a description runs the full SDDL compiler, which can take
+// milliseconds for large sources. Compiled output is memoized by source
+// text (hashed by the map) in a process-wide cache with a fixed entry cap;
+// when full, an arbitrary entry is dropped. Compilation itself runs outside
+// the lock, so concurrent misses on the same source may both compile.
 // ---------------------------------------------------------------------------
 
-#include "tools/sddl/compiler/Compiler.h"
+static constexpr size_t kSddlCacheMaxEntries = 256;
 
-static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
-nif_sddl_compile(ErlNifEnv *env, std::string_view source) {
-  if (source.empty()) {
-    return fine::Error(std::string("SDDL source must not be empty"));
+struct SddlCache {
+  std::mutex mutex;
+  std::unordered_map<std::string, std::string> entries;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t compiles = 0;
+  uint64_t compile_ns = 0;
+};
+
+static SddlCache &sddl_cache() {
+  static SddlCache cache;
+  return cache;
+}
+
+static std::optional<std::string> sddl_compile_cached(std::string_view source,
+                                                      std::string &compiled) {
+  SddlCache &cache = sddl_cache();
+  std::string key(source);
+
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.entries.find(key);
+    if (it != cache.entries.end()) {
+      cache.hits++;
+      compiled = it->second;
+      return std::nullopt;
+    }
+    cache.misses++;
   }
 
+  auto start = std::chrono::steady_clock::now();
   try {
     openzl::sddl::Compiler compiler{
         openzl::sddl::Compiler::Options{}.with_verbosity(-1)};
-    std::string compiled = compiler.compile(source, "[input]");
-    return fine::Ok(std::move(compiled));
+    compiled = compiler.compile(source, "[input]");
   } catch (const std::exception &e) {
-    return fine::Error(std::string("SDDL compilation failed: ") + e.what());
+    return std::string("SDDL compilation failed: ") + e.what();
   }
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.compiles++;
+  cache.compile_ns += static_cast<uint64_t>(elapsed.count());
+  if (cache.entries.size() >= kSddlCacheMaxEntries) {
+    cache.entries.erase(cache.entries.begin());
+  }
+  cache.entries.emplace(std::move(key), compiled);
+  return std::nullopt;
 }
 
-FINE_NIF(nif_sddl_compile, 0);
-
 // ---------------------------------------------------------------------------
-// NIF: create_sddl_compressor/1
-// Create a Compressor from compiled SDDL binary.
-// Uses ZL_SDDL_setupProfile which builds the SDDL graph with generic
-// clustering as successor, then validates and selects the starting graph.
+// NIF: sddl_compile/1
+// Compile SDDL source text to binary description, via the compiled cache.
 // ---------------------------------------------------------------------------
 
-#include "custom_parsers/sddl/sddl_profile.h"
-
-static std::variant<fine::Ok<fine::ResourcePtr<Compressor>>,
-                    fine::Error<std::string>>
-nif_create_sddl_compressor(ErlNifEnv *env, std::string_view compiled) {
-  if (compiled.empty()) {
-    return fine::Error(std::string("compiled SDDL must not be empty"));
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_sddl_compile(ErlNifEnv *env, std::string_view source) {
+  if (source.empty()) {
+    return fine::Error(std::string("SDDL source must not be empty"));
   }
 
-  auto comp = fine::make_resource<Compressor>();
-
-  if (!comp->compressor) {
-    return fine::Error(std::string("failed to create compressor"));
+  std::string compiled;
+  std::optional<std::string> err = sddl_compile_cached(source, compiled);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
   }
+  return fine::Ok(std::move(compiled));
+}
+
+FINE_NIF(nif_sddl_compile, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: sddl_cache_stats/0
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_sddl_cache_stats(ErlNifEnv *env) {
+  SddlCache &cache = sddl_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+
+  ERL_NIF_TERM keys[5], vals[5];
+  keys[0] = fine::__private__::make_atom(env, "entries");
+  vals[0] = enif_make_uint64(env, cache.entries.size());
+  keys[1] = fine::__private__::make_atom(env, "hits");
+  vals[1] = enif_make_uint64(env, cache.hits);
+  keys[2] = fine::__private__::make_atom(env, "misses");
+  vals[2] = enif_make_uint64(env, cache.misses);
+  keys[3] = fine::__private__::make_atom(env, "compiles");
+  vals[3] = enif_make_uint64(env, cache.compiles);
+  keys[4] = fine::__private__::make_atom(env, "compile_time_us");
+  vals[4] = enif_make_uint64(env, cache.compile_ns / 1000);
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 5, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_sddl_cache_stats, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: sddl_cache_clear/0
+// Drop all cached descriptions and reset the counters.
+// ---------------------------------------------------------------------------
+
+static fine::Atom nif_sddl_cache_clear(ErlNifEnv *env) {
+  SddlCache &cache = sddl_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.entries.clear();
+  cache.hits = 0;
+  cache.misses = 0;
+  cache.compiles = 0;
+  cache.compile_ns = 0;
+  return fine::Atom("ok");
+}
+
+FINE_NIF(nif_sddl_cache_clear, 0);
+
+// ---------------------------------------------------------------------------
+// Helper: build the SDDL graph on a compressor.
+// Uses ZL_SDDL_setupProfile which builds the SDDL graph with generic
+// clustering as successor, then validates and selects the starting graph.
+// ---------------------------------------------------------------------------
 
+static std::optional<std::string>
+sddl_setup_compressor(ZL_Compressor *compressor, std::string_view compiled) {
   // Build the SDDL graph with generic clustering as successor
-  auto graph_result = ZL_SDDL_setupProfile(
-      comp->compressor, compiled.data(), compiled.size());
+  auto graph_result =
+      ZL_SDDL_setupProfile(compressor, compiled.data(), compiled.size());
 
   if (ZL_RES_isError(graph_result)) {
     const char *err = ZL_Compressor_getErrorContextString_fromError(
-        comp->compressor, graph_result._error);
-    std::string msg =
-        err ? std::string(err) : "failed to build SDDL graph";
-    return fine::Error(std::move(msg));
+        compressor, graph_result._error);
+    return err ? std::string(err) : "failed to build SDDL graph";
   }
 
   ZL_GraphID graph_id = ZL_RES_value(graph_result);
 
   ZL_Report select_result =
-      ZL_Compressor_selectStartingGraphID(comp->compressor, graph_id);
+      ZL_Compressor_selectStartingGraphID(compressor, graph_id);
 
   if (ZL_isError(select_result)) {
-    const char *err = ZL_Compressor_getErrorContextString(
-        comp->compressor, select_result);
-    std::string msg =
-        err ? std::string(err) : "failed to select starting graph";
-    return fine::Error(std::move(msg));
+    const char *err =
+        ZL_Compressor_getErrorContextString(compressor, select_result);
+    return err ? std::string(err) : "failed to select starting graph";
+  }
+
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: create_sddl_compressor/1
+// Create a Compressor from compiled SDDL binary.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<Compressor>>,
+                    fine::Error<std::string>>
+nif_create_sddl_compressor(ErlNifEnv *env, std::string_view compiled) {
+  if (compiled.empty()) {
+    return fine::Error(std::string("compiled SDDL must not be empty"));
+  }
+
+  auto comp = fine::make_resource<Compressor>();
+
+  if (!comp->compressor) {
+    return fine::Error(std::string("failed to create compressor"));
+  }
+
+  std::optional<std::string> err =
+      sddl_setup_compressor(comp->compressor, compiled);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
   }
 
   return fine::Ok(std::move(comp));
 }
 
-FINE_NIF(nif_create_sddl_compressor, 0);
+FINE_NIF(nif_create_sddl_compressor, ERL_NIF_DIRTY_JOB_CPU_BOUND);
 
 // ---------------------------------------------------------------------------
 // NIF: set_compressor/2
@@ -1058,12 +2075,6198 @@ nif_set_compressor(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
 
   // Store reference to prevent GC
   cctx->compressor_ref = comp;
+  cctx->ns_per_byte = 0.0;
 
   return fine::Ok(fine::Atom("ok"));
 }
 
 FINE_NIF(nif_set_compressor, 0);
 
+// ===================================================================
+// Phase 4: Append Log
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: blocking file I/O that retries on EINTR and short transfers
+// ---------------------------------------------------------------------------
+
+static bool write_all(int fd, const void *buf, size_t size) {
+  const char *p = static_cast<const char *>(buf);
+  while (size > 0) {
+    ssize_t n = ::write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    size -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+static bool pread_all(int fd, void *buf, size_t size, uint64_t offset) {
+  char *p = static_cast<char *>(buf);
+  while (size > 0) {
+    ssize_t n = ::pread(fd, p, size, static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    if (n == 0) {
+      return false;
+    }
+    p += n;
+    size -= static_cast<size_t>(n);
+    offset += static_cast<uint64_t>(n);
+  }
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Log file layout
+//
+//   header:  "EZLG" u32 version
+//   block*:  u32 frame_size, u32 record_count, frame
+//   footer:  u32 0, {u64 frame_offset, u32 frame_size, u32 record_count}*,
+//            u32 block_count, "EZLI"
+//
+// Each frame is a string-typed OpenZL frame holding one block of records.
+// The footer is written on close. A log without one (still open, or the
+// writer crashed) is recovered by walking block headers; a zero frame_size
+// marks the start of the footer and a truncated block ends the scan.
+// ---------------------------------------------------------------------------
+
+static constexpr uint32_t kLogVersion = 1;
+static constexpr size_t kLogHeaderSize = 8;
+static constexpr size_t kLogBlockHeaderSize = 8;
+static constexpr size_t kLogIndexEntrySize = 16;
+static constexpr size_t kLogTrailerSize = 8;
+static constexpr uint64_t kLogMaxBlockSize = 1ULL << 30;
+
+struct LogBlock {
+  uint64_t frame_offset;
+  uint32_t frame_size;
+  uint32_t record_count;
+  uint64_t first_record;
+};
+
+// Rebuild the block index of an existing log. On success `end_offset` is
+// the file offset just past the last complete block.
+static std::optional<std::string> log_load_index(int fd,
+                                                 std::vector<LogBlock> &index,
+                                                 uint64_t &end_offset) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    return std::string("failed to stat log file");
+  }
+  uint64_t file_size = static_cast<uint64_t>(st.st_size);
+
+  char header[kLogHeaderSize];
+  if (file_size < kLogHeaderSize || !pread_all(fd, header, kLogHeaderSize, 0) ||
+      std::memcmp(header, kLogMagic, sizeof(kLogMagic)) != 0) {
+    return std::string("not an ExOpenzl log file");
+  }
+  if (get_le32(header + 4) != kLogVersion) {
+    return std::string("unsupported log file version");
+  }
+
+  index.clear();
+
+  // Fast path: a footer written by a clean close.
+  if (file_size >= kLogHeaderSize + 4 + kLogTrailerSize) {
+    char trailer[kLogTrailerSize];
+    if (pread_all(fd, trailer, kLogTrailerSize, file_size - kLogTrailerSize) &&
+        std::memcmp(trailer + 4, kLogIndexMagic, sizeof(kLogIndexMagic)) == 0) {
+      uint64_t block_count = get_le32(trailer);
+      uint64_t footer_size =
+          4 + block_count * kLogIndexEntrySize + kLogTrailerSize;
+      if (footer_size <= file_size - kLogHeaderSize) {
+        uint64_t footer_start = file_size - footer_size;
+        std::string footer(footer_size - kLogTrailerSize, '\0');
+        if (pread_all(fd, footer.data(), footer.size(), footer_start) &&
+            get_le32(footer.data()) == 0) {
+          // Entries must describe blocks laid end to end between the
+          // header and the footer; a footer that does not is ignored and
+          // the blocks are rescanned.
+          uint64_t first_record = 0;
+          uint64_t expected = kLogHeaderSize + kLogBlockHeaderSize;
+          bool valid = true;
+          const char *p = footer.data() + 4;
+          for (uint64_t i = 0; i < block_count; i++) {
+            LogBlock block;
+            block.frame_offset = get_le64(p);
+            block.frame_size = get_le32(p + 8);
+            block.record_count = get_le32(p + 12);
+            block.first_record = first_record;
+            if (block.frame_offset != expected ||
+                block.frame_offset > footer_start || block.frame_size == 0 ||
+                block.frame_size > footer_start - block.frame_offset) {
+              valid = false;
+              break;
+            }
+            expected += block.frame_size + kLogBlockHeaderSize;
+            first_record += block.record_count;
+            index.push_back(block);
+            p += kLogIndexEntrySize;
+          }
+          if (valid && expected - kLogBlockHeaderSize == footer_start) {
+            end_offset = footer_start;
+            return std::nullopt;
+          }
+          index.clear();
+        }
+      }
+    }
+  }
+
+  // Slow path: walk the block headers.
+  uint64_t offset = kLogHeaderSize;
+  uint64_t first_record = 0;
+  while (offset + kLogBlockHeaderSize <= file_size) {
+    char block_header[kLogBlockHeaderSize];
+    if (!pread_all(fd, block_header, kLogBlockHeaderSize, offset)) {
+      return std::string("failed to read log block header");
+    }
+    uint32_t frame_size = get_le32(block_header);
+    uint32_t record_count = get_le32(block_header + 4);
+    if (frame_size == 0 ||
+        offset + kLogBlockHeaderSize + frame_size > file_size) {
+      break;
+    }
+    index.push_back(LogBlock{offset + kLogBlockHeaderSize, frame_size,
+                             record_count, first_record});
+    first_record += record_count;
+    offset += kLogBlockHeaderSize + frame_size;
+  }
+  end_offset = offset;
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// Resource: Append log writer
+// Buffers appended records and compresses each full block as one
+// string-typed frame through the attached CCtx. All operations take the
+// mutex, so a log may be shared between processes.
+// ---------------------------------------------------------------------------
+
+class AppendLog {
+public:
+  std::mutex mutex;
+  int fd;
+  // Hold a reference to the compression context to prevent GC
+  std::optional<fine::ResourcePtr<CCtx>> cctx_ref;
+  size_t block_size;
+  std::string pending_data;
+  std::vector<uint32_t> pending_lengths;
+  std::vector<LogBlock> index;
+  uint64_t end_offset;
+  uint64_t record_count;
+
+  AppendLog() noexcept
+      : fd(-1), block_size(0), end_offset(0), record_count(0) {}
+
+  ~AppendLog();
+
+  AppendLog(const AppendLog &) = delete;
+  AppendLog &operator=(const AppendLog &) = delete;
+};
+
+// Compress and write the pending records as one block. Caller holds the
+// mutex.
+static std::optional<std::string> log_flush_block(AppendLog &log) {
+  if (log.pending_lengths.empty()) {
+    return std::nullopt;
+  }
+
+  ZL_CCtx *cctx = (*log.cctx_ref)->ctx;
+
+  TypedRefPtr tref(ZL_TypedRef_createString(
+      log.pending_data.data(), log.pending_data.size(),
+      log.pending_lengths.data(), log.pending_lengths.size()));
+  if (!tref) {
+    return std::string("failed to create string typed ref");
+  }
+
+  std::optional<size_t> maybe_bound = multi_typed_compress_bound(
+      log.pending_data.size() +
+          log.pending_lengths.size() * sizeof(uint32_t),
+      1);
+  if (!maybe_bound.has_value()) {
+    return std::string("compressed output size bound overflow");
+  }
+
+  std::string frame(kLogBlockHeaderSize + *maybe_bound, '\0');
+  ZL_Report result = ZL_CCtx_compressTypedRef(
+      cctx, frame.data() + kLogBlockHeaderSize, *maybe_bound, tref.get());
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx, result);
+    return err ? std::string(err) : std::string("log block compression failed");
+  }
+
+  size_t frame_size = ZL_validResult(result);
+  uint32_t count = static_cast<uint32_t>(log.pending_lengths.size());
+  std::string header;
+  put_le32(header, static_cast<uint32_t>(frame_size));
+  put_le32(header, count);
+  std::memcpy(frame.data(), header.data(), kLogBlockHeaderSize);
+  frame.resize(kLogBlockHeaderSize + frame_size);
+
+  if (!write_all(log.fd, frame.data(), frame.size())) {
+    std::string err =
+        std::string("failed to write log block: ") + std::strerror(errno);
+    // Cut off whatever part of the block reached the file, so the next
+    // block lands at end_offset. A log that cannot be repositioned is
+    // closed; its records up to end_offset stay readable.
+    if (::ftruncate(log.fd, static_cast<off_t>(log.end_offset)) != 0 ||
+        ::lseek(log.fd, static_cast<off_t>(log.end_offset), SEEK_SET) < 0) {
+      ::close(log.fd);
+      log.fd = -1;
+      err += " (log closed)";
+    }
+    return err;
+  }
+
+  log.index.push_back(LogBlock{log.end_offset + kLogBlockHeaderSize,
+                               static_cast<uint32_t>(frame_size), count,
+                               log.record_count});
+  log.end_offset += frame.size();
+  log.record_count += count;
+  log.pending_data.clear();
+  log.pending_lengths.clear();
+  return std::nullopt;
+}
+
+// Flush pending records, write the footer and close the file. Caller holds
+// the mutex.
+static std::optional<std::string> log_close_file(AppendLog &log) {
+  if (log.fd < 0) {
+    return std::nullopt;
+  }
+
+  std::optional<std::string> err = log_flush_block(log);
+
+  if (!err.has_value()) {
+    std::string footer;
+    put_le32(footer, 0);
+    for (const LogBlock &block : log.index) {
+      put_le64(footer, block.frame_offset);
+      put_le32(footer, block.frame_size);
+      put_le32(footer, block.record_count);
+    }
+    put_le32(footer, static_cast<uint32_t>(log.index.size()));
+    footer.append(kLogIndexMagic, sizeof(kLogIndexMagic));
+    if (!write_all(log.fd, footer.data(), footer.size()) ||
+        ::fsync(log.fd) != 0) {
+      err = std::string("failed to write log footer: ") + std::strerror(errno);
+    }
+  }
+
+  ::close(log.fd);
+  log.fd = -1;
+  return err;
+}
+
+AppendLog::~AppendLog() {
+  // A log dropped without close/1 loses its pending records. Flushing here
+  // would compress through a context that may be in use elsewhere, and
+  // fsync on whichever thread runs the destructor. The written blocks stay
+  // readable; the missing footer is recovered by scanning on open.
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+FINE_RESOURCE(AppendLog);
+
+// ---------------------------------------------------------------------------
+// Resource: Append log reader
+// The index is immutable once loaded and reads use pread, so a reader may
+// be shared between processes.
+// ---------------------------------------------------------------------------
+
+class LogReader {
+public:
+  int fd;
+  std::vector<LogBlock> index;
+  uint64_t record_count;
+
+  LogReader() noexcept : fd(-1), record_count(0) {}
+
+  ~LogReader() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  LogReader(const LogReader &) = delete;
+  LogReader &operator=(const LogReader &) = delete;
+};
+
+FINE_RESOURCE(LogReader);
+
+// ---------------------------------------------------------------------------
+// NIF: log_open/3
+// Open (or create) an append log: (path, cctx, block_size)
+// Appending to an existing log drops its footer and continues after the
+// last complete block.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<AppendLog>>,
+                    fine::Error<std::string>>
+nif_log_open(ErlNifEnv *env, std::string path, fine::ResourcePtr<CCtx> cctx,
+             uint64_t block_size) {
+  if (block_size == 0 || block_size > kLogMaxBlockSize) {
+    return fine::Error(std::string("block_size must be between 1 and 1 GiB"));
+  }
+
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return fine::Error(std::string("failed to open log file: ") +
+                       std::strerror(errno));
+  }
+
+  auto log = fine::make_resource<AppendLog>();
+  log->fd = fd;
+  log->block_size = static_cast<size_t>(block_size);
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    return fine::Error(std::string("failed to stat log file"));
+  }
+
+  if (st.st_size == 0) {
+    std::string header(kLogMagic, sizeof(kLogMagic));
+    put_le32(header, kLogVersion);
+    if (!write_all(fd, header.data(), header.size())) {
+      return fine::Error(std::string("failed to write log header"));
+    }
+    log->end_offset = kLogHeaderSize;
+  } else {
+    std::optional<std::string> err =
+        log_load_index(fd, log->index, log->end_offset);
+    if (err.has_value()) {
+      return fine::Error(std::move(*err));
+    }
+    if (::ftruncate(fd, static_cast<off_t>(log->end_offset)) != 0 ||
+        ::lseek(fd, static_cast<off_t>(log->end_offset), SEEK_SET) < 0) {
+      return fine::Error(std::string("failed to reposition log file"));
+    }
+    for (const LogBlock &block : log->index) {
+      log->record_count += block.record_count;
+    }
+  }
+
+  log->cctx_ref = cctx;
+  return fine::Ok(std::move(log));
+}
+
+FINE_NIF(nif_log_open, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_append/2
+// Append a list of binaries. Returns the record number of the first one.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<uint64_t>, fine::Error<std::string>>
+nif_log_append(ErlNifEnv *env, fine::ResourcePtr<AppendLog> log,
+               fine::Term records_term) {
+  std::vector<ErlNifBinary> records;
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM current = records_term;
+
+  while (enif_get_list_cell(env, current, &head, &tail)) {
+    ErlNifBinary bin;
+    if (!enif_inspect_binary(env, head, &bin)) {
+      return fine::Error(std::string("records must be binaries"));
+    }
+    if (bin.size > std::numeric_limits<uint32_t>::max()) {
+      return fine::Error(std::string("record exceeds 4 GiB"));
+    }
+    records.push_back(bin);
+    current = tail;
+  }
+
+  std::lock_guard<std::mutex> lock(log->mutex);
+
+  if (log->fd < 0) {
+    return fine::Error(std::string("log is closed"));
+  }
+
+  uint64_t first = log->record_count + log->pending_lengths.size();
+
+  for (const ErlNifBinary &bin : records) {
+    log->pending_data.append(reinterpret_cast<const char *>(bin.data),
+                             bin.size);
+    log->pending_lengths.push_back(static_cast<uint32_t>(bin.size));
+
+    if (log->pending_data.size() >= log->block_size) {
+      std::optional<std::string> err = log_flush_block(*log);
+      if (err.has_value()) {
+        return fine::Error(std::move(*err));
+      }
+    }
+  }
+
+  return fine::Ok(first);
+}
+
+FINE_NIF(nif_log_append, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_flush/1
+// Write pending records as a (possibly short) block and fsync.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_log_flush(ErlNifEnv *env, fine::ResourcePtr<AppendLog> log) {
+  std::lock_guard<std::mutex> lock(log->mutex);
+
+  if (log->fd < 0) {
+    return fine::Error(std::string("log is closed"));
+  }
+
+  std::optional<std::string> err = log_flush_block(*log);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+  if (::fsync(log->fd) != 0) {
+    return fine::Error(std::string("failed to sync log file"));
+  }
+
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_log_flush, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_close/1
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_log_close(ErlNifEnv *env, fine::ResourcePtr<AppendLog> log) {
+  std::lock_guard<std::mutex> lock(log->mutex);
+
+  std::optional<std::string> err = log_close_file(*log);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_log_close, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_info/1
+// Dirty, since the mutex may be held across a block flush and fsync.
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_log_info(ErlNifEnv *env,
+                               fine::ResourcePtr<AppendLog> log) {
+  std::lock_guard<std::mutex> lock(log->mutex);
+
+  ERL_NIF_TERM keys[5], vals[5];
+  keys[0] = fine::__private__::make_atom(env, "block_count");
+  vals[0] = enif_make_uint64(env, log->index.size());
+  keys[1] = fine::__private__::make_atom(env, "record_count");
+  vals[1] = enif_make_uint64(env, log->record_count);
+  keys[2] = fine::__private__::make_atom(env, "pending_records");
+  vals[2] = enif_make_uint64(env, log->pending_lengths.size());
+  keys[3] = fine::__private__::make_atom(env, "pending_bytes");
+  vals[3] = enif_make_uint64(env, log->pending_data.size());
+  keys[4] = fine::__private__::make_atom(env, "file_size");
+  vals[4] = enif_make_uint64(env, log->end_offset);
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 5, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_log_info, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_reader_open/1
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<LogReader>>,
+                    fine::Error<std::string>>
+nif_log_reader_open(ErlNifEnv *env, std::string path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return fine::Error(std::string("failed to open log file: ") +
+                       std::strerror(errno));
+  }
+
+  auto reader = fine::make_resource<LogReader>();
+  reader->fd = fd;
+
+  uint64_t end_offset = 0;
+  std::optional<std::string> err = log_load_index(fd, reader->index, end_offset);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+  if (!reader->index.empty()) {
+    const LogBlock &last = reader->index.back();
+    reader->record_count = last.first_record + last.record_count;
+  }
+
+  return fine::Ok(std::move(reader));
+}
+
+FINE_NIF(nif_log_reader_open, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_reader_info/1
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_log_reader_info(ErlNifEnv *env,
+                                      fine::ResourcePtr<LogReader> reader) {
+  ERL_NIF_TERM keys[2], vals[2];
+  keys[0] = fine::__private__::make_atom(env, "block_count");
+  vals[0] = enif_make_uint64(env, reader->index.size());
+  keys[1] = fine::__private__::make_atom(env, "record_count");
+  vals[1] = enif_make_uint64(env, reader->record_count);
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 2, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_log_reader_info, 0);
+
+// ---------------------------------------------------------------------------
+// Helper: read and decompress one log block. On success `data_bin` holds
+// the concatenated records and `lengths` their sizes.
+// ---------------------------------------------------------------------------
+
+static std::optional<std::string>
+log_decode_block(ErlNifEnv *env, LogReader &reader, DCtx &dctx,
+                 const LogBlock &block, ERL_NIF_TERM &data_bin,
+                 std::vector<uint32_t> &lengths) {
+  std::string frame(block.frame_size, '\0');
+  if (!pread_all(reader.fd, frame.data(), frame.size(), block.frame_offset)) {
+    return std::string("failed to read log block");
+  }
+
+  TypedBufferPtr tbuf(ZL_TypedBuffer_create());
+  if (!tbuf) {
+    return std::string("failed to create typed buffer");
+  }
+
+  ZL_Report result = ZL_DCtx_decompressTBuffer(dctx.ctx, tbuf.get(),
+                                               frame.data(), frame.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_DCtx_getErrorContextString(dctx.ctx, result);
+    return err ? std::string(err) : std::string("log block decompression failed");
+  }
+
+  if (ZL_TypedBuffer_type(tbuf.get()) != ZL_Type_string ||
+      ZL_TypedBuffer_numElts(tbuf.get()) != block.record_count) {
+    return std::string("log block is corrupt");
+  }
+
+  size_t byte_size = ZL_TypedBuffer_byteSize(tbuf.get());
+  unsigned char *bin_ptr = enif_make_new_binary(env, byte_size, &data_bin);
+  std::memcpy(bin_ptr, ZL_TypedBuffer_rPtr(tbuf.get()), byte_size);
+
+  const uint32_t *str_lens = ZL_TypedBuffer_rStringLens(tbuf.get());
+  lengths.assign(str_lens, str_lens + block.record_count);
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: log_read_block/3
+// Sequential access: (reader, dctx, block_index) -> list of records.
+// Records are sub-binaries of one decompressed block binary.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_log_read_block(ErlNifEnv *env, fine::ResourcePtr<LogReader> reader,
+                   fine::ResourcePtr<DCtx> dctx, uint64_t block_index) {
+  if (block_index >= reader->index.size()) {
+    return fine::Error(std::string("block index out of range"));
+  }
+
+  ERL_NIF_TERM data_bin;
+  std::vector<uint32_t> lengths;
+  std::optional<std::string> err = log_decode_block(
+      env, *reader, *dctx, reader->index[block_index], data_bin, lengths);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  std::vector<ERL_NIF_TERM> items;
+  items.reserve(lengths.size());
+  size_t offset = 0;
+  for (uint32_t len : lengths) {
+    items.push_back(enif_make_sub_binary(env, data_bin, offset, len));
+    offset += len;
+  }
+
+  ERL_NIF_TERM list = enif_make_list_from_array(env, items.data(), items.size());
+  return fine::Ok(fine::Term(list));
+}
+
+FINE_NIF(nif_log_read_block, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: log_read_record/3
+// Indexed access: (reader, dctx, record_number) -> record binary.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_log_read_record(ErlNifEnv *env, fine::ResourcePtr<LogReader> reader,
+                    fine::ResourcePtr<DCtx> dctx, uint64_t record_number) {
+  if (record_number >= reader->record_count) {
+    return fine::Error(std::string("record number out of range"));
+  }
+
+  // Last block whose first record is <= record_number
+  auto it = std::upper_bound(
+      reader->index.begin(), reader->index.end(), record_number,
+      [](uint64_t n, const LogBlock &block) { return n < block.first_record; });
+  const LogBlock &block = *(it - 1);
+
+  ERL_NIF_TERM data_bin;
+  std::vector<uint32_t> lengths;
+  std::optional<std::string> err =
+      log_decode_block(env, *reader, *dctx, block, data_bin, lengths);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  size_t target = static_cast<size_t>(record_number - block.first_record);
+  size_t offset = 0;
+  for (size_t i = 0; i < target; i++) {
+    offset += lengths[i];
+  }
+
+  return fine::Ok(
+      fine::Term(enif_make_sub_binary(env, data_bin, offset, lengths[target])));
+}
+
+FINE_NIF(nif_log_read_record, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 5: Multi-Series Packing
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: decompress every output of a frame into auto-allocated
+// TypedBuffers.
+// ---------------------------------------------------------------------------
+
+static std::optional<std::string>
+decompress_to_tbuffers(ZL_DCtx *dctx, std::string_view compressed,
+                       std::vector<TypedBufferPtr> &bufs) {
+  ZL_Report num_report =
+      ZL_getNumOutputs(compressed.data(), compressed.size());
+  if (ZL_isError(num_report)) {
+    return std::string("failed to get number of outputs from frame");
+  }
+  size_t nb_outputs = ZL_validResult(num_report);
+
+  bufs.clear();
+  std::vector<ZL_TypedBuffer *> buf_ptrs;
+  for (size_t i = 0; i < nb_outputs; i++) {
+    TypedBufferPtr buf(ZL_TypedBuffer_create());
+    if (!buf) {
+      return std::string("failed to create typed buffer");
+    }
+    buf_ptrs.push_back(buf.get());
+    bufs.push_back(std::move(buf));
+  }
+
+  ZL_Report result = ZL_DCtx_decompressMultiTBuffer(
+      dctx, buf_ptrs.data(), nb_outputs, compressed.data(), compressed.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_DCtx_getErrorContextString(dctx, result);
+    return err ? std::string(err)
+               : std::string("multi-typed decompression failed");
+  }
+
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// Packed series frame layout (one multi-typed frame, four numeric outputs):
+//   0: series ids        (u64, one per series)
+//   1: point counts      (u32, one per series)
+//   2: timestamps        (u64, all series concatenated in input order)
+//   3: values            (value_width, all series concatenated)
+// Concatenating each column keeps similar values adjacent, so one frame's
+// delta and entropy stages see every series instead of 60-120 points each.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kSeriesOutputs = 4;
+
+struct SeriesColumns {
+  const uint64_t *ids;
+  const uint32_t *counts;
+  const unsigned char *timestamps;
+  const unsigned char *values;
+  size_t num_series;
+  size_t value_width;
+};
+
+static std::optional<std::string>
+series_columns(const std::vector<TypedBufferPtr> &bufs, SeriesColumns &cols) {
+  if (bufs.size() != kSeriesOutputs) {
+    return std::string("frame is not a packed series frame");
+  }
+  for (const TypedBufferPtr &buf : bufs) {
+    if (ZL_TypedBuffer_type(buf.get()) != ZL_Type_numeric) {
+      return std::string("frame is not a packed series frame");
+    }
+  }
+
+  size_t num_series = ZL_TypedBuffer_numElts(bufs[0].get());
+  if (ZL_TypedBuffer_eltWidth(bufs[0].get()) != 8 ||
+      ZL_TypedBuffer_eltWidth(bufs[1].get()) != 4 ||
+      ZL_TypedBuffer_eltWidth(bufs[2].get()) != 8 ||
+      ZL_TypedBuffer_numElts(bufs[1].get()) != num_series ||
+      ZL_TypedBuffer_numElts(bufs[2].get()) !=
+          ZL_TypedBuffer_numElts(bufs[3].get())) {
+    return std::string("frame is not a packed series frame");
+  }
+
+  cols.ids = static_cast<const uint64_t *>(ZL_TypedBuffer_rPtr(bufs[0].get()));
+  cols.counts =
+      static_cast<const uint32_t *>(ZL_TypedBuffer_rPtr(bufs[1].get()));
+  cols.timestamps =
+      static_cast<const unsigned char *>(ZL_TypedBuffer_rPtr(bufs[2].get()));
+  cols.values =
+      static_cast<const unsigned char *>(ZL_TypedBuffer_rPtr(bufs[3].get()));
+  cols.num_series = num_series;
+  cols.value_width = ZL_TypedBuffer_eltWidth(bufs[3].get());
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < num_series; i++) {
+    total += cols.counts[i];
+  }
+  if (total != ZL_TypedBuffer_numElts(bufs[2].get())) {
+    return std::string("packed series counts do not match point columns");
+  }
+
+  return std::nullopt;
+}
+
+static ERL_NIF_TERM make_series_tuple(ErlNifEnv *env, const SeriesColumns &cols,
+                                      size_t series, size_t first_point) {
+  size_t count = cols.counts[series];
+
+  ERL_NIF_TERM ts_bin;
+  unsigned char *ts_ptr = enif_make_new_binary(env, count * 8, &ts_bin);
+  std::memcpy(ts_ptr, cols.timestamps + first_point * 8, count * 8);
+
+  ERL_NIF_TERM val_bin;
+  unsigned char *val_ptr =
+      enif_make_new_binary(env, count * cols.value_width, &val_bin);
+  std::memcpy(val_ptr, cols.values + first_point * cols.value_width,
+              count * cols.value_width);
+
+  return enif_make_tuple3(env, enif_make_uint64(env, cols.ids[series]), ts_bin,
+                          val_bin);
+}
+
+// ---------------------------------------------------------------------------
+// NIF: pack_series/3
+// Pack many short series into one frame: (cctx, series_list, value_width)
+// Each series is {id, timestamps_u64_binary, values_binary}.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_pack_series(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                fine::Term list_term, uint64_t value_width) {
+  if (value_width != 1 && value_width != 2 && value_width != 4 &&
+      value_width != 8) {
+    return fine::Error(std::string("value_width must be 1, 2, 4, or 8"));
+  }
+
+  std::vector<uint64_t> ids;
+  std::vector<uint32_t> counts;
+  std::string timestamps;
+  std::string values;
+
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM current = list_term;
+
+  while (enif_get_list_cell(env, current, &head, &tail)) {
+    int arity;
+    const ERL_NIF_TERM *tuple_terms;
+    if (!enif_get_tuple(env, head, &arity, &tuple_terms) || arity != 3) {
+      return fine::Error(std::string(
+          "each series must be a 3-tuple {id, timestamps, values}"));
+    }
+
+    ErlNifUInt64 id;
+    if (!enif_get_uint64(env, tuple_terms[0], &id)) {
+      return fine::Error(
+          std::string("series id must be a non-negative integer"));
+    }
+
+    ErlNifBinary ts_bin, val_bin;
+    if (!enif_inspect_binary(env, tuple_terms[1], &ts_bin) ||
+        !enif_inspect_binary(env, tuple_terms[2], &val_bin)) {
+      return fine::Error(std::string("timestamps and values must be binaries"));
+    }
+    if (ts_bin.size % 8 != 0) {
+      return fine::Error(
+          std::string("timestamps size must be a multiple of 8"));
+    }
+
+    size_t count = ts_bin.size / 8;
+    if (val_bin.size != count * value_width) {
+      return fine::Error(std::string(
+          "values size must equal timestamp count times value_width"));
+    }
+    if (count > std::numeric_limits<uint32_t>::max()) {
+      return fine::Error(std::string("series has too many points"));
+    }
+
+    ids.push_back(id);
+    counts.push_back(static_cast<uint32_t>(count));
+    timestamps.append(reinterpret_cast<const char *>(ts_bin.data),
+                      ts_bin.size);
+    values.append(reinterpret_cast<const char *>(val_bin.data), val_bin.size);
+
+    current = tail;
+  }
+
+  if (ids.empty()) {
+    return fine::Error(std::string("series list must not be empty"));
+  }
+
+  TypedRefPtr refs[kSeriesOutputs] = {
+      TypedRefPtr(ZL_TypedRef_createNumeric(ids.data(), 8, ids.size())),
+      TypedRefPtr(ZL_TypedRef_createNumeric(counts.data(), 4, counts.size())),
+      TypedRefPtr(ZL_TypedRef_createNumeric(timestamps.data(), 8,
+                                            timestamps.size() / 8)),
+      TypedRefPtr(ZL_TypedRef_createNumeric(values.data(), value_width,
+                                            values.size() / value_width)),
+  };
+  const ZL_TypedRef *ref_ptrs[kSeriesOutputs];
+  for (size_t i = 0; i < kSeriesOutputs; i++) {
+    if (!refs[i]) {
+      return fine::Error(std::string("failed to create numeric typed ref"));
+    }
+    ref_ptrs[i] = refs[i].get();
+  }
+
+  size_t total_size = ids.size() * 8 + counts.size() * 4 + timestamps.size() +
+                      values.size();
+  std::optional<size_t> maybe_bound =
+      multi_typed_compress_bound(total_size, kSeriesOutputs);
+  if (!maybe_bound.has_value()) {
+    return fine::Error(std::string("compressed output size bound overflow"));
+  }
+
+  size_t bound = *maybe_bound;
+  std::string output(bound, '\0');
+
+  ZL_Report result = ZL_CCtx_compressMultiTypedRef(
+      cctx->ctx, output.data(), bound, ref_ptrs, kSeriesOutputs);
+
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
+    std::string msg = err ? std::string(err) : "series packing failed";
+    return fine::Error(std::move(msg));
+  }
+
+  output.resize(ZL_validResult(result));
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_pack_series, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: unpack_series/3
+// Extract one series by id: (dctx, frame, id) -> {id, timestamps, values}
+// Columns are decoded into native buffers; only the requested series is
+// copied into BEAM binaries.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_unpack_series(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                  std::string_view compressed, uint64_t id) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  std::vector<TypedBufferPtr> bufs;
+  std::optional<std::string> err =
+      decompress_to_tbuffers(dctx->ctx, compressed, bufs);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  SeriesColumns cols;
+  err = series_columns(bufs, cols);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  size_t first_point = 0;
+  for (size_t i = 0; i < cols.num_series; i++) {
+    if (cols.ids[i] == id) {
+      return fine::Ok(fine::Term(make_series_tuple(env, cols, i, first_point)));
+    }
+    first_point += cols.counts[i];
+  }
+
+  return fine::Error(std::string("series not found"));
+}
+
+FINE_NIF(nif_unpack_series, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: unpack_all_series/2
+// Extract every series: (dctx, frame) -> [{id, timestamps, values}]
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_unpack_all_series(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                      std::string_view compressed) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  std::vector<TypedBufferPtr> bufs;
+  std::optional<std::string> err =
+      decompress_to_tbuffers(dctx->ctx, compressed, bufs);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  SeriesColumns cols;
+  err = series_columns(bufs, cols);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  std::vector<ERL_NIF_TERM> items;
+  items.reserve(cols.num_series);
+  size_t first_point = 0;
+  for (size_t i = 0; i < cols.num_series; i++) {
+    items.push_back(make_series_tuple(env, cols, i, first_point));
+    first_point += cols.counts[i];
+  }
+
+  ERL_NIF_TERM list = enif_make_list_from_array(env, items.data(), items.size());
+  return fine::Ok(fine::Term(list));
+}
+
+FINE_NIF(nif_unpack_all_series, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 6: Tensor Compression
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Tensor frame layout (one multi-typed frame, two numeric outputs):
+//   0: element data     (element width from the tensor type)
+//   1: header           (u64: magic, type kind, type bits, rank, dims...)
+// Complex tensors are stored as their real/imaginary components, so the
+// element width is half the type size. A tensor with no elements is written
+// as a header-only frame (one output).
+// ---------------------------------------------------------------------------
+
+static constexpr uint64_t kTensorMagic = 0x524f534e4554; // "TENSOR"
+static constexpr size_t kTensorHeaderFixed = 4;
+static constexpr uint64_t kTensorKindComplex = 4;
+
+// Width of one stored numeric element for a tensor type, or nothing when
+// the type is not supported.
+static std::optional<size_t> tensor_element_width(uint64_t kind,
+                                                  uint64_t bits) {
+  if (kind > kTensorKindComplex || bits % 8 != 0) {
+    return std::nullopt;
+  }
+  uint64_t width = kind == kTensorKindComplex ? bits / 16 : bits / 8;
+  if (width != 1 && width != 2 && width != 4 && width != 8) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(width);
+}
+
+// ---------------------------------------------------------------------------
+// NIF: compress_tensor/5
+// Compress tensor data: (cctx, binary, type_kind, type_bits, shape)
+// type_kind is 0 = u, 1 = s, 2 = f, 3 = bf, 4 = c (see ExOpenzl).
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_tensor(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                    std::string_view data, uint64_t kind, uint64_t bits,
+                    std::vector<uint64_t> shape) {
+  std::optional<size_t> width = tensor_element_width(kind, bits);
+  if (!width) {
+    return fine::Error(std::string("unsupported tensor type"));
+  }
+  size_t element_width = *width;
+  if (data.size() % element_width != 0) {
+    return fine::Error(
+        std::string("data size must be a multiple of the element width"));
+  }
+  bool has_zero_dim =
+      std::find(shape.begin(), shape.end(), 0) != shape.end();
+  if (data.empty() != has_zero_dim) {
+    return fine::Error(std::string("data size does not match the shape"));
+  }
+
+  std::vector<uint64_t> header = {kTensorMagic, kind, bits, shape.size()};
+  header.insert(header.end(), shape.begin(), shape.end());
+
+  TypedRefPtr header_ref(
+      ZL_TypedRef_createNumeric(header.data(), 8, header.size()));
+  TypedRefPtr data_ref;
+  if (!data.empty()) {
+    data_ref.reset(ZL_TypedRef_createNumeric(
+        data.data(), element_width, data.size() / element_width));
+  }
+  if (!header_ref || (!data.empty() && !data_ref)) {
+    return fine::Error(std::string("failed to create numeric typed ref"));
+  }
+  // Empty tensors are header-only frames
+  const ZL_TypedRef *ref_ptrs[2] = {data_ref.get(), header_ref.get()};
+  size_t num_refs = data.empty() ? 1 : 2;
+  const ZL_TypedRef **refs = data.empty() ? ref_ptrs + 1 : ref_ptrs;
+
+  std::optional<size_t> maybe_bound =
+      multi_typed_compress_bound(data.size() + header.size() * 8, num_refs);
+  if (!maybe_bound.has_value()) {
+    return fine::Error(std::string("compressed output size bound overflow"));
+  }
+
+  size_t bound = *maybe_bound;
+  std::string output(bound, '\0');
+
+  ZL_Report result = ZL_CCtx_compressMultiTypedRef(cctx->ctx, output.data(),
+                                                   bound, refs, num_refs);
+
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
+    std::string msg = err ? std::string(err) : "tensor compression failed";
+    return fine::Error(std::move(msg));
+  }
+
+  output.resize(ZL_validResult(result));
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_tensor, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_tensor/2
+// Returns {data, kind, bits, shape}. Element data is decoded directly into
+// a freshly allocated BEAM binary wrapped as the output buffer, so there is
+// no intermediate copy.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_decompress_tensor(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                      std::string_view compressed) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  FrameInfoPtr fi(ZL_FrameInfo_create(compressed.data(), compressed.size()));
+  if (!fi) {
+    return fine::Error(std::string("failed to create frame info"));
+  }
+
+  ZL_Report num_report = ZL_FrameInfo_getNumOutputs(fi.get());
+  if (ZL_isError(num_report) || (ZL_validResult(num_report) != 1 &&
+                                 ZL_validResult(num_report) != 2)) {
+    return fine::Error(std::string("frame is not a tensor frame"));
+  }
+  // A header-only frame holds an empty tensor
+  bool empty = ZL_validResult(num_report) == 1;
+
+  size_t byte_size = 0;
+  size_t num_elts = 0;
+  if (!empty) {
+    ZL_Report type_report = ZL_FrameInfo_getOutputType(fi.get(), 0);
+    ZL_Report size_report = ZL_FrameInfo_getDecompressedSize(fi.get(), 0);
+    ZL_Report elts_report = ZL_FrameInfo_getNumElts(fi.get(), 0);
+    if (ZL_isError(type_report) ||
+        (ZL_Type)ZL_validResult(type_report) != ZL_Type_numeric ||
+        ZL_isError(size_report) || ZL_isError(elts_report) ||
+        ZL_validResult(elts_report) == 0) {
+      return fine::Error(std::string("frame is not a tensor frame"));
+    }
+    byte_size = ZL_validResult(size_report);
+    num_elts = ZL_validResult(elts_report);
+    if (byte_size % num_elts != 0) {
+      return fine::Error(std::string("frame is not a tensor frame"));
+    }
+  }
+
+  ErlNifBinary data_bin;
+  if (!enif_alloc_binary(byte_size, &data_bin)) {
+    return fine::Error(std::string("failed to allocate tensor binary"));
+  }
+
+  TypedBufferPtr data_buf;
+  if (!empty) {
+    data_buf.reset(ZL_TypedBuffer_createWrapNumeric(
+        data_bin.data, byte_size / num_elts, num_elts));
+  }
+  TypedBufferPtr header_buf(ZL_TypedBuffer_create());
+  if ((!empty && !data_buf) || !header_buf) {
+    enif_release_binary(&data_bin);
+    return fine::Error(std::string("failed to create typed buffer"));
+  }
+
+  ZL_TypedBuffer *buf_ptrs[2] = {data_buf.get(), header_buf.get()};
+  ZL_Report result = ZL_DCtx_decompressMultiTBuffer(
+      dctx->ctx, empty ? buf_ptrs + 1 : buf_ptrs, empty ? 1 : 2,
+      compressed.data(), compressed.size());
+
+  if (ZL_isError(result)) {
+    enif_release_binary(&data_bin);
+    const char *err = ZL_DCtx_getErrorContextString(dctx->ctx, result);
+    std::string msg = err ? std::string(err) : "tensor decompression failed";
+    return fine::Error(std::move(msg));
+  }
+
+  size_t header_len = ZL_TypedBuffer_numElts(header_buf.get());
+  const uint64_t *header =
+      static_cast<const uint64_t *>(ZL_TypedBuffer_rPtr(header_buf.get()));
+  if (ZL_TypedBuffer_eltWidth(header_buf.get()) != 8 ||
+      header_len < kTensorHeaderFixed || header[0] != kTensorMagic ||
+      header_len != kTensorHeaderFixed + header[3]) {
+    enif_release_binary(&data_bin);
+    return fine::Error(std::string("frame is not a tensor frame"));
+  }
+  // The recorded type must match how the data was actually stored
+  std::optional<size_t> width = tensor_element_width(header[1], header[2]);
+  bool has_zero_dim = std::find(header + kTensorHeaderFixed,
+                                header + header_len, 0) != header + header_len;
+  if (!width || (!empty && *width != byte_size / num_elts) ||
+      empty != has_zero_dim) {
+    enif_release_binary(&data_bin);
+    return fine::Error(std::string("tensor header does not match its data"));
+  }
+
+  std::vector<ERL_NIF_TERM> dims;
+  for (size_t i = kTensorHeaderFixed; i < header_len; i++) {
+    dims.push_back(enif_make_uint64(env, header[i]));
+  }
+
+  ERL_NIF_TERM items[4] = {
+      enif_make_binary(env, &data_bin),
+      enif_make_uint64(env, header[1]),
+      enif_make_uint64(env, header[2]),
+      enif_make_list_from_array(env, dims.data(), dims.size()),
+  };
+  return fine::Ok(fine::Term(enif_make_tuple_from_array(env, items, 4)));
+}
+
+FINE_NIF(nif_decompress_tensor, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 7: Arrow Record Batches
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Columns are exchanged in Arrow C Data Interface layout: an ArrowSchema
+// format string plus the ArrowArray length and buffers. Supported layouts:
+//   fixed width  "c" "C" "s" "S" "i" "I" "l" "L" "e" "f" "g", dates, times,
+//                timestamps, durations   -> numeric output
+//   fixed binary "w:N", decimals "d:.."  -> struct output
+//   boolean      "b" (bit-packed)        -> numeric u8 output
+//   variable     "u" "z" (int32 offsets), "U" "Z" (int64 offsets)
+//                                        -> string output (offsets -> lengths)
+// A validity bitmap adds a numeric u8 output right after its column.
+//
+// Frame layout:
+//   0: column names and format strings (string, two entries per column)
+//   1: column metadata (u64: length, null_count, has_validity per column)
+//   2..: column data outputs, each followed by its validity bitmap if any
+// ---------------------------------------------------------------------------
+
+enum class ArrowLayout { Numeric, Struct, Bitmap, Binary32, Binary64 };
+
+struct ArrowColumnKind {
+  ArrowLayout layout;
+  size_t width;
+};
+
+static std::optional<ArrowColumnKind>
+arrow_column_kind(const std::string &format) {
+  if (format.size() == 1) {
+    switch (format[0]) {
+    case 'c':
+    case 'C':
+      return ArrowColumnKind{ArrowLayout::Numeric, 1};
+    case 's':
+    case 'S':
+    case 'e':
+      return ArrowColumnKind{ArrowLayout::Numeric, 2};
+    case 'i':
+    case 'I':
+    case 'f':
+      return ArrowColumnKind{ArrowLayout::Numeric, 4};
+    case 'l':
+    case 'L':
+    case 'g':
+      return ArrowColumnKind{ArrowLayout::Numeric, 8};
+    case 'b':
+      return ArrowColumnKind{ArrowLayout::Bitmap, 1};
+    case 'u':
+    case 'z':
+      return ArrowColumnKind{ArrowLayout::Binary32, 0};
+    case 'U':
+    case 'Z':
+      return ArrowColumnKind{ArrowLayout::Binary64, 0};
+    default:
+      return std::nullopt;
+    }
+  }
+
+  if (format.rfind("w:", 0) == 0) {
+    size_t width = std::strtoull(format.c_str() + 2, nullptr, 10);
+    if (width == 0) {
+      return std::nullopt;
+    }
+    return ArrowColumnKind{ArrowLayout::Struct, width};
+  }
+  if (format.rfind("d:", 0) == 0) {
+    // Decimal: "d:precision,scale[,bitwidth]", 128-bit unless stated
+    size_t width = 16;
+    size_t second_comma = format.find(',', format.find(',') + 1);
+    if (second_comma != std::string::npos) {
+      width = std::strtoull(format.c_str() + second_comma + 1, nullptr, 10) / 8;
+    }
+    if (width == 0) {
+      return std::nullopt;
+    }
+    return ArrowColumnKind{ArrowLayout::Struct, width};
+  }
+  if (format == "tdD" || format == "tts" || format == "ttm") {
+    return ArrowColumnKind{ArrowLayout::Numeric, 4};
+  }
+  if (format == "tdm" || format == "ttu" || format == "ttn" ||
+      format.rfind("ts", 0) == 0 || format.rfind("tD", 0) == 0) {
+    return ArrowColumnKind{ArrowLayout::Numeric, 8};
+  }
+
+  return std::nullopt;
+}
+
+static uint64_t arrow_null_count(const unsigned char *validity,
+                                 uint64_t length) {
+  uint64_t valid = kKernels.popcount(validity, length / 8);
+  if (length % 8 != 0) {
+    unsigned mask = (1u << (length % 8)) - 1;
+    valid += static_cast<uint64_t>(__builtin_popcount(validity[length / 8] & mask));
+  }
+  return length - valid;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: compress_record_batch/2
+// Input: (cctx, [{name, format, length, validity | nil, [buffer]}])
+// Buffers are referenced in place; only variable-width offsets are
+// converted to the u32 lengths OpenZL expects.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_record_batch(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                          fine::Term list_term) {
+  std::string schema_data;
+  std::vector<uint32_t> schema_lengths;
+  std::vector<uint64_t> metadata;
+  // Inner vectors own converted lengths; their heap storage stays put when
+  // the outer vector grows.
+  std::vector<std::vector<uint32_t>> converted_lengths;
+  std::vector<TypedRefPtr> refs;
+  size_t total_size = 0;
+
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM current = list_term;
+
+  while (enif_get_list_cell(env, current, &head, &tail)) {
+    int arity;
+    const ERL_NIF_TERM *t;
+    if (!enif_get_tuple(env, head, &arity, &t) || arity != 5) {
+      return fine::Error(std::string(
+          "each column must be {name, format, length, validity, buffers}"));
+    }
+
+    ErlNifBinary name_bin, format_bin;
+    ErlNifUInt64 length;
+    if (!enif_inspect_binary(env, t[0], &name_bin) ||
+        !enif_inspect_binary(env, t[1], &format_bin) ||
+        !enif_get_uint64(env, t[2], &length)) {
+      return fine::Error(std::string(
+          "column name and format must be binaries and length an integer"));
+    }
+
+    std::string format(reinterpret_cast<const char *>(format_bin.data),
+                       format_bin.size);
+    std::optional<ArrowColumnKind> kind = arrow_column_kind(format);
+    if (!kind.has_value()) {
+      return fine::Error(std::string("unsupported Arrow format: ") + format);
+    }
+
+    // Lengths are caller-supplied, so every bound below is checked by
+    // division before anything is multiplied by them
+    uint64_t bitmap_size = length / 8 + (length % 8 != 0);
+
+    ErlNifBinary validity;
+    bool has_validity = enif_inspect_binary(env, t[3], &validity);
+    if (has_validity && validity.size < bitmap_size) {
+      return fine::Error(std::string("validity bitmap is too short"));
+    }
+
+    std::vector<ErlNifBinary> buffers;
+    ERL_NIF_TERM buf_head, buf_tail, buf_current = t[4];
+    while (enif_get_list_cell(env, buf_current, &buf_head, &buf_tail)) {
+      ErlNifBinary buf;
+      if (!enif_inspect_binary(env, buf_head, &buf)) {
+        return fine::Error(std::string("column buffers must be binaries"));
+      }
+      buffers.push_back(buf);
+      buf_current = buf_tail;
+    }
+
+    TypedRefPtr ref;
+    switch (kind->layout) {
+    case ArrowLayout::Numeric:
+    case ArrowLayout::Struct:
+    case ArrowLayout::Bitmap: {
+      size_t count =
+          kind->layout == ArrowLayout::Bitmap ? bitmap_size : length;
+      if (buffers.size() != 1 || count > buffers[0].size / kind->width) {
+        return fine::Error(std::string("column ") + format +
+                           " needs one values buffer of length elements");
+      }
+      if (count == 0) {
+        return fine::Error(std::string("columns must not be empty"));
+      }
+      ref.reset(kind->layout == ArrowLayout::Struct
+                    ? ZL_TypedRef_createStruct(buffers[0].data, kind->width,
+                                               count)
+                    : ZL_TypedRef_createNumeric(buffers[0].data, kind->width,
+                                                count));
+      total_size += count * kind->width;
+      break;
+    }
+    case ArrowLayout::Binary32:
+    case ArrowLayout::Binary64: {
+      size_t offset_width = kind->layout == ArrowLayout::Binary32 ? 4 : 8;
+      if (buffers.size() != 2 ||
+          length >= buffers[0].size / offset_width) {
+        return fine::Error(
+            std::string("variable-width column needs offsets and data buffers"));
+      }
+      auto offset_at = [&](size_t i) -> uint64_t {
+        const unsigned char *p = buffers[0].data + i * offset_width;
+        return offset_width == 4 ? get_le32(p) : get_le64(p);
+      };
+      uint64_t first = offset_at(0);
+      uint64_t last = offset_at(length);
+      if (last < first || last > buffers[1].size) {
+        return fine::Error(std::string("column offsets are out of range"));
+      }
+      std::vector<uint32_t> lengths(length);
+      uint64_t prev = first;
+      for (size_t i = 0; i < length; i++) {
+        uint64_t next = offset_at(i + 1);
+        if (next < prev || next - prev > std::numeric_limits<uint32_t>::max()) {
+          return fine::Error(std::string("column offsets must be increasing"));
+        }
+        lengths[i] = static_cast<uint32_t>(next - prev);
+        prev = next;
+      }
+      ref.reset(ZL_TypedRef_createString(buffers[1].data + first, last - first,
+                                         lengths.data(), lengths.size()));
+      converted_lengths.push_back(std::move(lengths));
+      total_size += (last - first) + length * sizeof(uint32_t);
+      break;
+    }
+    }
+    if (!ref) {
+      return fine::Error(std::string("failed to create typed ref for column"));
+    }
+    refs.push_back(std::move(ref));
+
+    if (has_validity) {
+      TypedRefPtr vref(
+          ZL_TypedRef_createNumeric(validity.data, 1, bitmap_size));
+      if (!vref) {
+        return fine::Error(std::string("failed to create validity typed ref"));
+      }
+      refs.push_back(std::move(vref));
+      total_size += bitmap_size;
+    }
+
+    schema_data.append(reinterpret_cast<const char *>(name_bin.data),
+                       name_bin.size);
+    schema_lengths.push_back(static_cast<uint32_t>(name_bin.size));
+    schema_data.append(format);
+    schema_lengths.push_back(static_cast<uint32_t>(format.size()));
+    metadata.push_back(length);
+    metadata.push_back(has_validity ? arrow_null_count(validity.data, length)
+                                    : 0);
+    metadata.push_back(has_validity ? 1 : 0);
+
+    current = tail;
+  }
+
+  if (metadata.empty()) {
+    return fine::Error(std::string("record batch must have at least one column"));
+  }
+
+  TypedRefPtr schema_ref(ZL_TypedRef_createString(
+      schema_data.data(), schema_data.size(), schema_lengths.data(),
+      schema_lengths.size()));
+  TypedRefPtr meta_ref(
+      ZL_TypedRef_createNumeric(metadata.data(), 8, metadata.size()));
+  if (!schema_ref || !meta_ref) {
+    return fine::Error(std::string("failed to create schema typed refs"));
+  }
+
+  std::vector<const ZL_TypedRef *> ref_ptrs = {schema_ref.get(),
+                                               meta_ref.get()};
+  for (const TypedRefPtr &ref : refs) {
+    ref_ptrs.push_back(ref.get());
+  }
+  total_size += schema_data.size() + schema_lengths.size() * sizeof(uint32_t) +
+                metadata.size() * 8;
+
+  std::optional<size_t> maybe_bound =
+      multi_typed_compress_bound(total_size, ref_ptrs.size());
+  if (!maybe_bound.has_value()) {
+    return fine::Error(std::string("compressed output size bound overflow"));
+  }
+
+  size_t bound = *maybe_bound;
+  std::string output(bound, '\0');
+
+  ZL_Report result = ZL_CCtx_compressMultiTypedRef(
+      cctx->ctx, output.data(), bound, ref_ptrs.data(), ref_ptrs.size());
+
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
+    std::string msg = err ? std::string(err) : "record batch compression failed";
+    return fine::Error(std::move(msg));
+  }
+
+  output.resize(ZL_validResult(result));
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_record_batch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_record_batch/2
+// Returns [{name, format, length, null_count, validity | nil, [buffer]}],
+// rebuilding Arrow offsets for variable-width columns.
+// ---------------------------------------------------------------------------
+
+static ERL_NIF_TERM copy_to_binary(ErlNifEnv *env, const void *data,
+                                   size_t size) {
+  ERL_NIF_TERM bin;
+  unsigned char *ptr = enif_make_new_binary(env, size, &bin);
+  if (size > 0) {
+    std::memcpy(ptr, data, size);
+  }
+  return bin;
+}
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_decompress_record_batch(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                            std::string_view compressed) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  std::vector<TypedBufferPtr> bufs;
+  std::optional<std::string> err =
+      decompress_to_tbuffers(dctx->ctx, compressed, bufs);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  const std::string not_a_batch = "frame is not a record batch frame";
+  if (bufs.size() < 2 || ZL_TypedBuffer_type(bufs[0].get()) != ZL_Type_string ||
+      ZL_TypedBuffer_type(bufs[1].get()) != ZL_Type_numeric ||
+      ZL_TypedBuffer_eltWidth(bufs[1].get()) != 8) {
+    return fine::Error(not_a_batch);
+  }
+
+  size_t num_columns = ZL_TypedBuffer_numElts(bufs[1].get()) / 3;
+  if (ZL_TypedBuffer_numElts(bufs[0].get()) != num_columns * 2) {
+    return fine::Error(not_a_batch);
+  }
+
+  const char *schema =
+      static_cast<const char *>(ZL_TypedBuffer_rPtr(bufs[0].get()));
+  const uint32_t *schema_lens = ZL_TypedBuffer_rStringLens(bufs[0].get());
+  const uint64_t *metadata =
+      static_cast<const uint64_t *>(ZL_TypedBuffer_rPtr(bufs[1].get()));
+
+  std::vector<ERL_NIF_TERM> columns;
+  size_t schema_offset = 0;
+  size_t next_output = 2;
+
+  for (size_t c = 0; c < num_columns; c++) {
+    std::string name(schema + schema_offset, schema_lens[2 * c]);
+    schema_offset += schema_lens[2 * c];
+    std::string format(schema + schema_offset, schema_lens[2 * c + 1]);
+    schema_offset += schema_lens[2 * c + 1];
+
+    uint64_t length = metadata[3 * c];
+    uint64_t null_count = metadata[3 * c + 1];
+    bool has_validity = metadata[3 * c + 2] != 0;
+
+    std::optional<ArrowColumnKind> kind = arrow_column_kind(format);
+    size_t outputs_needed = has_validity ? 2 : 1;
+    if (!kind.has_value() || next_output + outputs_needed > bufs.size()) {
+      return fine::Error(not_a_batch);
+    }
+
+    ZL_TypedBuffer *data_buf = bufs[next_output++].get();
+    const void *data_ptr = ZL_TypedBuffer_rPtr(data_buf);
+    size_t data_size = ZL_TypedBuffer_byteSize(data_buf);
+
+    std::vector<ERL_NIF_TERM> buffers;
+    if (kind->layout == ArrowLayout::Binary32 ||
+        kind->layout == ArrowLayout::Binary64) {
+      if (ZL_TypedBuffer_type(data_buf) != ZL_Type_string ||
+          ZL_TypedBuffer_numElts(data_buf) != length) {
+        return fine::Error(not_a_batch);
+      }
+      const uint32_t *lens = ZL_TypedBuffer_rStringLens(data_buf);
+      size_t offset_width = kind->layout == ArrowLayout::Binary32 ? 4 : 8;
+      if (offset_width == 4 && data_size > std::numeric_limits<int32_t>::max()) {
+        return fine::Error(std::string("column too large for int32 offsets"));
+      }
+
+      ERL_NIF_TERM offsets_bin;
+      unsigned char *out = enif_make_new_binary(
+          env, (length + 1) * offset_width, &offsets_bin);
+      uint64_t offset = 0;
+      for (size_t i = 0; i <= length; i++) {
+        for (size_t b = 0; b < offset_width; b++) {
+          out[i * offset_width + b] = static_cast<unsigned char>(offset >> (8 * b));
+        }
+        if (i < length) {
+          offset += lens[i];
+        }
+      }
+      buffers.push_back(offsets_bin);
+    }
+    buffers.push_back(copy_to_binary(env, data_ptr, data_size));
+
+    ERL_NIF_TERM validity_term = fine::__private__::make_atom(env, "nil");
+    if (has_validity) {
+      ZL_TypedBuffer *vbuf = bufs[next_output++].get();
+      validity_term = copy_to_binary(env, ZL_TypedBuffer_rPtr(vbuf),
+                                     ZL_TypedBuffer_byteSize(vbuf));
+    }
+
+    ERL_NIF_TERM items[6] = {
+        copy_to_binary(env, name.data(), name.size()),
+        copy_to_binary(env, format.data(), format.size()),
+        enif_make_uint64(env, length),
+        enif_make_uint64(env, null_count),
+        validity_term,
+        enif_make_list_from_array(env, buffers.data(), buffers.size()),
+    };
+    columns.push_back(enif_make_tuple_from_array(env, items, 6));
+  }
+
+  ERL_NIF_TERM list =
+      enif_make_list_from_array(env, columns.data(), columns.size());
+  return fine::Ok(fine::Term(list));
+}
+
+FINE_NIF(nif_decompress_record_batch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 8: Columnar Files
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: bounds-checked little-endian reader for native container formats.
+// Reads past the end return zero and clear `ok`.
+// ---------------------------------------------------------------------------
+
+struct ByteReader {
+  const unsigned char *p;
+  const unsigned char *end;
+  bool ok;
+
+  ByteReader(const void *data, size_t size)
+      : p(static_cast<const unsigned char *>(data)), end(p + size), ok(true) {}
+
+  bool take(size_t n) {
+    if (!ok || static_cast<size_t>(end - p) < n) {
+      ok = false;
+      return false;
+    }
+    return true;
+  }
+
+  uint8_t u8() {
+    if (!take(1))
+      return 0;
+    return *p++;
+  }
+
+  uint32_t u32() {
+    if (!take(4))
+      return 0;
+    uint32_t v = get_le32(p);
+    p += 4;
+    return v;
+  }
+
+  uint64_t u64() {
+    if (!take(8))
+      return 0;
+    uint64_t v = get_le64(p);
+    p += 8;
+    return v;
+  }
+
+  std::string str(size_t n) {
+    if (!take(n))
+      return std::string();
+    std::string s(reinterpret_cast<const char *>(p), n);
+    p += n;
+    return s;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Columnar file layout
+//
+//   header:  "EZLC" u32 version
+//   chunks:  one typed OpenZL frame per column per row group
+//   footer:  u32 num_columns, {u32 name_len, name, u8 kind, u32 width}*
+//            u32 num_row_groups, {u64 num_rows,
+//              {u64 offset, u64 size, u8 has_stats, u64 min, u64 max}*}*
+//   trailer: u64 footer_size, "EZLC"
+//
+// Each column chunk is its own frame so a reader decodes only the columns
+// and row groups it projects. min/max hold the raw 8-byte zone map value
+// (int64, uint64 or double bits depending on the column kind).
+// ---------------------------------------------------------------------------
+
+static constexpr uint32_t kColumnarVersion = 1;
+static constexpr size_t kColumnarHeaderSize = 8;
+static constexpr size_t kColumnarTrailerSize = 12;
+
+enum class ColumnKind : uint8_t {
+  UInt = 0,
+  Int = 1,
+  Float = 2,
+  Struct = 3,
+  String = 4
+};
+
+struct ColumnSpec {
+  std::string name;
+  ColumnKind kind;
+  uint32_t width;
+};
+
+struct ColumnChunk {
+  uint64_t offset;
+  uint64_t size;
+  bool has_stats;
+  uint64_t min;
+  uint64_t max;
+};
+
+struct RowGroupMeta {
+  uint64_t num_rows;
+  std::vector<ColumnChunk> chunks;
+};
+
+static bool column_spec_valid(const ColumnSpec &spec) {
+  switch (spec.kind) {
+  case ColumnKind::UInt:
+  case ColumnKind::Int:
+    return spec.width == 1 || spec.width == 2 || spec.width == 4 ||
+           spec.width == 8;
+  case ColumnKind::Float:
+    return spec.width == 4 || spec.width == 8;
+  case ColumnKind::Struct:
+    return spec.width > 0;
+  case ColumnKind::String:
+    return true;
+  }
+  return false;
+}
+
+// ---------------------------------------------------------------------------
+// Helper: zone map (min/max) of a numeric column chunk
+// ---------------------------------------------------------------------------
+
+static bool column_zone_map(const ColumnSpec &spec, const unsigned char *data,
+                            size_t count, uint64_t &min_bits,
+                            uint64_t &max_bits) {
+  ElementKind kind;
+  switch (spec.kind) {
+  case ColumnKind::UInt:
+    kind = ElementKind::UInt;
+    break;
+  case ColumnKind::Int:
+    kind = ElementKind::Int;
+    break;
+  case ColumnKind::Float:
+    kind = ElementKind::Float;
+    break;
+  default:
+    return false;
+  }
+  int index = element_type_index(kind, spec.width);
+  if (index < 0) {
+    return false;
+  }
+  return kElementKernels[index].min_max(data, count, min_bits, max_bits);
+}
+
+static ERL_NIF_TERM make_zone_value(ErlNifEnv *env, ColumnKind kind,
+                                    uint64_t bits) {
+  switch (kind) {
+  case ColumnKind::Int: {
+    int64_t v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return enif_make_int64(env, v);
+  }
+  case ColumnKind::Float: {
+    double v;
+    std::memcpy(&v, &bits, sizeof(v));
+    return enif_make_double(env, v);
+  }
+  default:
+    return enif_make_uint64(env, bits);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Resource: Columnar file writer
+// ---------------------------------------------------------------------------
+
+class ColumnarWriter {
+public:
+  std::mutex mutex;
+  int fd;
+  // Hold a reference to the compression context to prevent GC
+  std::optional<fine::ResourcePtr<CCtx>> cctx_ref;
+  std::vector<ColumnSpec> schema;
+  std::vector<RowGroupMeta> row_groups;
+  uint64_t offset;
+
+  ColumnarWriter() noexcept : fd(-1), offset(0) {}
+
+  ~ColumnarWriter() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  ColumnarWriter(const ColumnarWriter &) = delete;
+  ColumnarWriter &operator=(const ColumnarWriter &) = delete;
+};
+
+FINE_RESOURCE(ColumnarWriter);
+
+// ---------------------------------------------------------------------------
+// Resource: Columnar file reader (memory-mapped)
+// ---------------------------------------------------------------------------
+
+class ColumnarReader {
+public:
+  void *map;
+  size_t map_size;
+  std::vector<ColumnSpec> schema;
+  std::vector<RowGroupMeta> row_groups;
+
+  ColumnarReader() noexcept : map(MAP_FAILED), map_size(0) {}
+
+  ~ColumnarReader() {
+    if (map != MAP_FAILED) {
+      ::munmap(map, map_size);
+    }
+  }
+
+  ColumnarReader(const ColumnarReader &) = delete;
+  ColumnarReader &operator=(const ColumnarReader &) = delete;
+};
+
+FINE_RESOURCE(ColumnarReader);
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_open/3
+// Create a columnar file: (path, cctx, [{name, kind, width}])
+// kind is 0 = uint, 1 = int, 2 = float, 3 = struct, 4 = string.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<ColumnarWriter>>,
+                    fine::Error<std::string>>
+nif_columnar_open(ErlNifEnv *env, std::string path,
+                  fine::ResourcePtr<CCtx> cctx, fine::Term schema_term) {
+  std::vector<ColumnSpec> schema;
+
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM current = schema_term;
+  while (enif_get_list_cell(env, current, &head, &tail)) {
+    int arity;
+    const ERL_NIF_TERM *t;
+    ErlNifBinary name_bin;
+    ErlNifUInt64 kind, width;
+    if (!enif_get_tuple(env, head, &arity, &t) || arity != 3 ||
+        !enif_inspect_binary(env, t[0], &name_bin) ||
+        !enif_get_uint64(env, t[1], &kind) ||
+        !enif_get_uint64(env, t[2], &width)) {
+      return fine::Error(
+          std::string("each schema entry must be {name, kind, width}"));
+    }
+
+    ColumnSpec spec{std::string(reinterpret_cast<const char *>(name_bin.data),
+                                name_bin.size),
+                    static_cast<ColumnKind>(kind),
+                    static_cast<uint32_t>(width)};
+    if (kind > static_cast<uint64_t>(ColumnKind::String) ||
+        width > std::numeric_limits<uint32_t>::max() ||
+        !column_spec_valid(spec)) {
+      return fine::Error(std::string("invalid type for column ") + spec.name);
+    }
+    schema.push_back(std::move(spec));
+    current = tail;
+  }
+
+  if (schema.empty()) {
+    return fine::Error(std::string("schema must have at least one column"));
+  }
+
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return fine::Error(std::string("failed to open columnar file: ") +
+                       std::strerror(errno));
+  }
+
+  auto writer = fine::make_resource<ColumnarWriter>();
+  writer->fd = fd;
+  writer->schema = std::move(schema);
+
+  std::string header(kColumnarMagic, sizeof(kColumnarMagic));
+  put_le32(header, kColumnarVersion);
+  if (!write_all(fd, header.data(), header.size())) {
+    return fine::Error(std::string("failed to write columnar header"));
+  }
+  writer->offset = kColumnarHeaderSize;
+  writer->cctx_ref = cctx;
+
+  return fine::Ok(std::move(writer));
+}
+
+FINE_NIF(nif_columnar_open, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_write_row_group/2
+// Append one row group: (writer, columns) in schema order. Fixed-width
+// columns are binaries; string columns are {data, lengths_u32_binary}.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_columnar_write_row_group(ErlNifEnv *env,
+                             fine::ResourcePtr<ColumnarWriter> writer,
+                             fine::Term columns_term) {
+  std::lock_guard<std::mutex> lock(writer->mutex);
+
+  if (writer->fd < 0) {
+    return fine::Error(std::string("columnar file is closed"));
+  }
+
+  ZL_CCtx *cctx = (*writer->cctx_ref)->ctx;
+  RowGroupMeta row_group{0, {}};
+  std::string chunks;
+  bool first = true;
+
+  ERL_NIF_TERM head, tail;
+  ERL_NIF_TERM current = columns_term;
+  size_t c = 0;
+  for (; enif_get_list_cell(env, current, &head, &tail); c++, current = tail) {
+    if (c >= writer->schema.size()) {
+      return fine::Error(std::string("more columns than the schema defines"));
+    }
+    const ColumnSpec &spec = writer->schema[c];
+
+    ErlNifBinary data;
+    std::vector<uint32_t> lengths;
+    size_t rows;
+    TypedRefPtr ref;
+
+    if (spec.kind == ColumnKind::String) {
+      int arity;
+      const ERL_NIF_TERM *t;
+      ErlNifBinary lens_bin;
+      if (!enif_get_tuple(env, head, &arity, &t) || arity != 2 ||
+          !enif_inspect_binary(env, t[0], &data) ||
+          !enif_inspect_binary(env, t[1], &lens_bin) ||
+          lens_bin.size % sizeof(uint32_t) != 0) {
+        return fine::Error(std::string("string column ") + spec.name +
+                           " must be {data, lengths_u32_binary}");
+      }
+      rows = lens_bin.size / sizeof(uint32_t);
+      lengths.resize(rows);
+      std::memcpy(lengths.data(), lens_bin.data, lens_bin.size);
+      uint64_t total = 0;
+      for (uint32_t len : lengths) {
+        total += len;
+      }
+      if (total != data.size) {
+        return fine::Error(std::string("string lengths of column ") +
+                           spec.name + " do not sum to the data size");
+      }
+      ref.reset(ZL_TypedRef_createString(data.data, data.size, lengths.data(),
+                                         rows));
+    } else {
+      if (!enif_inspect_binary(env, head, &data) ||
+          data.size % spec.width != 0) {
+        return fine::Error(std::string("column ") + spec.name +
+                           " must be a binary of whole elements");
+      }
+      rows = data.size / spec.width;
+      ref.reset(spec.kind == ColumnKind::Struct
+                    ? ZL_TypedRef_createStruct(data.data, spec.width, rows)
+                    : ZL_TypedRef_createNumeric(data.data, spec.width, rows));
+    }
+
+    if (first) {
+      row_group.num_rows = rows;
+      first = false;
+    } else if (rows != row_group.num_rows) {
+      return fine::Error(std::string("column ") + spec.name +
+                         " has a different row count");
+    }
+    if (rows == 0) {
+      return fine::Error(std::string("row groups must not be empty"));
+    }
+    if (!ref) {
+      return fine::Error(std::string("failed to create typed ref for column ") +
+                         spec.name);
+    }
+
+    std::optional<size_t> maybe_bound = multi_typed_compress_bound(
+        data.size + lengths.size() * sizeof(uint32_t), 1);
+    if (!maybe_bound.has_value()) {
+      return fine::Error(std::string("compressed output size bound overflow"));
+    }
+    size_t start = chunks.size();
+    chunks.resize(start + *maybe_bound);
+    ZL_Report result = ZL_CCtx_compressTypedRef(cctx, chunks.data() + start,
+                                                *maybe_bound, ref.get());
+    if (ZL_isError(result)) {
+      const char *err = ZL_CCtx_getErrorContextString(cctx, result);
+      std::string msg = err ? std::string(err) : "column compression failed";
+      return fine::Error(std::move(msg));
+    }
+    size_t size = ZL_validResult(result);
+    chunks.resize(start + size);
+
+    ColumnChunk chunk{writer->offset + start, size, false, 0, 0};
+    chunk.has_stats =
+        column_zone_map(spec, data.data, rows, chunk.min, chunk.max);
+    row_group.chunks.push_back(chunk);
+  }
+
+  if (c != writer->schema.size()) {
+    return fine::Error(std::string("row group must have one entry per column"));
+  }
+
+  if (!write_all(writer->fd, chunks.data(), chunks.size())) {
+    return fine::Error(std::string("failed to write row group: ") +
+                       std::strerror(errno));
+  }
+  writer->offset += chunks.size();
+  writer->row_groups.push_back(std::move(row_group));
+
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_columnar_write_row_group, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_close/1
+// Write the footer and close the file.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_columnar_close(ErlNifEnv *env, fine::ResourcePtr<ColumnarWriter> writer) {
+  std::lock_guard<std::mutex> lock(writer->mutex);
+
+  if (writer->fd < 0) {
+    return fine::Error(std::string("columnar file is closed"));
+  }
+
+  std::string footer;
+  put_le32(footer, static_cast<uint32_t>(writer->schema.size()));
+  for (const ColumnSpec &spec : writer->schema) {
+    put_le32(footer, static_cast<uint32_t>(spec.name.size()));
+    footer.append(spec.name);
+    footer.push_back(static_cast<char>(spec.kind));
+    put_le32(footer, spec.width);
+  }
+  put_le32(footer, static_cast<uint32_t>(writer->row_groups.size()));
+  for (const RowGroupMeta &row_group : writer->row_groups) {
+    put_le64(footer, row_group.num_rows);
+    for (const ColumnChunk &chunk : row_group.chunks) {
+      put_le64(footer, chunk.offset);
+      put_le64(footer, chunk.size);
+      footer.push_back(chunk.has_stats ? 1 : 0);
+      put_le64(footer, chunk.min);
+      put_le64(footer, chunk.max);
+    }
+  }
+  uint64_t footer_size = footer.size();
+  put_le64(footer, footer_size);
+  footer.append(kColumnarMagic, sizeof(kColumnarMagic));
+
+  bool ok = write_all(writer->fd, footer.data(), footer.size()) &&
+            ::fsync(writer->fd) == 0;
+  ::close(writer->fd);
+  writer->fd = -1;
+
+  if (!ok) {
+    return fine::Error(std::string("failed to write columnar footer"));
+  }
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_columnar_close, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// Decodes the footer of a columnar file whose chunk data ends at data_end.
+// Returns false if the footer is truncated or references bytes outside
+// the data region.
+static bool columnar_parse_footer(const unsigned char *footer,
+                                  uint64_t footer_size, uint64_t data_end,
+                                  std::vector<ColumnSpec> &schema,
+                                  std::vector<RowGroupMeta> &row_groups) {
+  ByteReader in(footer, footer_size);
+
+  uint32_t num_columns = in.u32();
+  for (uint32_t i = 0; i < num_columns && in.ok; i++) {
+    ColumnSpec spec;
+    spec.name = in.str(in.u32());
+    spec.kind = static_cast<ColumnKind>(in.u8());
+    spec.width = in.u32();
+    if (static_cast<uint8_t>(spec.kind) >
+        static_cast<uint8_t>(ColumnKind::String)) {
+      in.ok = false;
+    }
+    schema.push_back(std::move(spec));
+  }
+
+  uint32_t num_row_groups = in.u32();
+  for (uint32_t g = 0; g < num_row_groups && in.ok; g++) {
+    RowGroupMeta row_group{in.u64(), {}};
+    for (uint32_t c = 0; c < num_columns && in.ok; c++) {
+      ColumnChunk chunk;
+      chunk.offset = in.u64();
+      chunk.size = in.u64();
+      chunk.has_stats = in.u8() != 0;
+      chunk.min = in.u64();
+      chunk.max = in.u64();
+      if (chunk.offset < kColumnarHeaderSize || chunk.offset > data_end ||
+          chunk.size > data_end - chunk.offset) {
+        in.ok = false;
+      }
+      row_group.chunks.push_back(chunk);
+    }
+    row_groups.push_back(std::move(row_group));
+  }
+
+  return in.ok;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_open_reader/1
+// Memory-map a columnar file and parse its footer.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<ColumnarReader>>,
+                    fine::Error<std::string>>
+nif_columnar_open_reader(ErlNifEnv *env, std::string path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return fine::Error(std::string("failed to open columnar file: ") +
+                       std::strerror(errno));
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return fine::Error(std::string("failed to stat columnar file"));
+  }
+  size_t file_size = static_cast<size_t>(st.st_size);
+  if (file_size < kColumnarHeaderSize + kColumnarTrailerSize) {
+    ::close(fd);
+    return fine::Error(std::string("not an ExOpenzl columnar file"));
+  }
+
+  auto reader = fine::make_resource<ColumnarReader>();
+  reader->map = ::mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (reader->map == MAP_FAILED) {
+    return fine::Error(std::string("failed to map columnar file"));
+  }
+  reader->map_size = file_size;
+
+  const unsigned char *base = static_cast<const unsigned char *>(reader->map);
+  const unsigned char *trailer = base + file_size - kColumnarTrailerSize;
+  if (std::memcmp(base, kColumnarMagic, sizeof(kColumnarMagic)) != 0 ||
+      get_le32(base + 4) != kColumnarVersion ||
+      std::memcmp(trailer + 8, kColumnarMagic, sizeof(kColumnarMagic)) != 0) {
+    return fine::Error(std::string("not an ExOpenzl columnar file"));
+  }
+
+  uint64_t footer_size = get_le64(trailer);
+  if (footer_size >
+      file_size - kColumnarHeaderSize - kColumnarTrailerSize) {
+    return fine::Error(std::string("columnar footer is corrupt"));
+  }
+  uint64_t data_end = file_size - kColumnarTrailerSize - footer_size;
+  if (!columnar_parse_footer(base + data_end, footer_size, data_end,
+                             reader->schema, reader->row_groups)) {
+    return fine::Error(std::string("columnar footer is corrupt"));
+  }
+
+  return fine::Ok(std::move(reader));
+}
+
+FINE_NIF(nif_columnar_open_reader, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_metadata/1
+// Schema and per-row-group chunk metadata including zone maps.
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_columnar_metadata(ErlNifEnv *env,
+                                        fine::ResourcePtr<ColumnarReader> reader) {
+  static const char *kind_names[] = {"uint", "int", "float", "struct",
+                                     "string"};
+
+  std::vector<ERL_NIF_TERM> schema_items;
+  for (const ColumnSpec &spec : reader->schema) {
+    ERL_NIF_TERM keys[3], vals[3];
+    keys[0] = fine::__private__::make_atom(env, "name");
+    vals[0] = copy_to_binary(env, spec.name.data(), spec.name.size());
+    keys[1] = fine::__private__::make_atom(env, "type");
+    vals[1] = fine::__private__::make_atom(
+        env, kind_names[static_cast<uint8_t>(spec.kind)]);
+    keys[2] = fine::__private__::make_atom(env, "width");
+    vals[2] = enif_make_uint64(env, spec.width);
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, vals, 3, &map);
+    schema_items.push_back(map);
+  }
+
+  uint64_t total_rows = 0;
+  std::vector<ERL_NIF_TERM> group_items;
+  for (const RowGroupMeta &row_group : reader->row_groups) {
+    total_rows += row_group.num_rows;
+
+    std::vector<ERL_NIF_TERM> chunk_items;
+    for (size_t c = 0; c < row_group.chunks.size(); c++) {
+      const ColumnChunk &chunk = row_group.chunks[c];
+      ColumnKind kind = reader->schema[c].kind;
+      ERL_NIF_TERM nil = fine::__private__::make_atom(env, "nil");
+
+      ERL_NIF_TERM keys[4], vals[4];
+      keys[0] = fine::__private__::make_atom(env, "offset");
+      vals[0] = enif_make_uint64(env, chunk.offset);
+      keys[1] = fine::__private__::make_atom(env, "compressed_size");
+      vals[1] = enif_make_uint64(env, chunk.size);
+      keys[2] = fine::__private__::make_atom(env, "min");
+      vals[2] = chunk.has_stats ? make_zone_value(env, kind, chunk.min) : nil;
+      keys[3] = fine::__private__::make_atom(env, "max");
+      vals[3] = chunk.has_stats ? make_zone_value(env, kind, chunk.max) : nil;
+
+      ERL_NIF_TERM map;
+      enif_make_map_from_arrays(env, keys, vals, 4, &map);
+      chunk_items.push_back(map);
+    }
+
+    ERL_NIF_TERM keys[2], vals[2];
+    keys[0] = fine::__private__::make_atom(env, "num_rows");
+    vals[0] = enif_make_uint64(env, row_group.num_rows);
+    keys[1] = fine::__private__::make_atom(env, "columns");
+    vals[1] =
+        enif_make_list_from_array(env, chunk_items.data(), chunk_items.size());
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, vals, 2, &map);
+    group_items.push_back(map);
+  }
+
+  ERL_NIF_TERM keys[3], vals[3];
+  keys[0] = fine::__private__::make_atom(env, "num_rows");
+  vals[0] = enif_make_uint64(env, total_rows);
+  keys[1] = fine::__private__::make_atom(env, "schema");
+  vals[1] =
+      enif_make_list_from_array(env, schema_items.data(), schema_items.size());
+  keys[2] = fine::__private__::make_atom(env, "row_groups");
+  vals[2] =
+      enif_make_list_from_array(env, group_items.data(), group_items.size());
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 3, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_columnar_metadata, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: columnar_read/4
+// Project columns and row groups: (reader, dctx, column_indices,
+// row_group_indices) -> one list of column values per row group.
+// Frames are decompressed straight from the mapping.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_columnar_read(ErlNifEnv *env, fine::ResourcePtr<ColumnarReader> reader,
+                  fine::ResourcePtr<DCtx> dctx, std::vector<uint64_t> columns,
+                  std::vector<uint64_t> row_groups) {
+  const unsigned char *base = static_cast<const unsigned char *>(reader->map);
+
+  std::vector<ERL_NIF_TERM> group_items;
+  for (uint64_t g : row_groups) {
+    if (g >= reader->row_groups.size()) {
+      return fine::Error(std::string("row group index out of range"));
+    }
+    const RowGroupMeta &row_group = reader->row_groups[g];
+
+    std::vector<ERL_NIF_TERM> column_items;
+    for (uint64_t c : columns) {
+      if (c >= reader->schema.size()) {
+        return fine::Error(std::string("column index out of range"));
+      }
+      const ColumnChunk &chunk = row_group.chunks[c];
+
+      TypedBufferPtr tbuf(ZL_TypedBuffer_create());
+      if (!tbuf) {
+        return fine::Error(std::string("failed to create typed buffer"));
+      }
+      ZL_Report result = ZL_DCtx_decompressTBuffer(
+          dctx->ctx, tbuf.get(), base + chunk.offset, chunk.size);
+      if (ZL_isError(result)) {
+        const char *err = ZL_DCtx_getErrorContextString(dctx->ctx, result);
+        std::string msg =
+            err ? std::string(err) : "column chunk decompression failed";
+        return fine::Error(std::move(msg));
+      }
+
+      ERL_NIF_TERM data_bin =
+          copy_to_binary(env, ZL_TypedBuffer_rPtr(tbuf.get()),
+                         ZL_TypedBuffer_byteSize(tbuf.get()));
+      if (reader->schema[c].kind == ColumnKind::String) {
+        ERL_NIF_TERM lens_bin = copy_to_binary(
+            env, ZL_TypedBuffer_rStringLens(tbuf.get()),
+            ZL_TypedBuffer_numElts(tbuf.get()) * sizeof(uint32_t));
+        column_items.push_back(enif_make_tuple2(env, data_bin, lens_bin));
+      } else {
+        column_items.push_back(data_bin);
+      }
+    }
+    group_items.push_back(enif_make_list_from_array(env, column_items.data(),
+                                                    column_items.size()));
+  }
+
+  ERL_NIF_TERM list =
+      enif_make_list_from_array(env, group_items.data(), group_items.size());
+  return fine::Ok(fine::Term(list));
+}
+
+FINE_NIF(nif_columnar_read, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 9: SDDL Columns
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: SDDL record layout
+//
+// A native parser for the fixed-layout subset of SDDL, used to locate the
+// fields the SDDL graph splits into streams:
+//
+//   Name = { [field :] Type ... }     record definitions
+//   Type[N]                           fixed-count arrays
+//   : Type[_rem / N] | : Type[N] | : Type
+//                                     root consumption
+//
+// Types are the builtin integer/float types (Byte, [U]Int{8,16,32,64}{LE,BE},
+// Float{32,64}{LE,BE}) and previously defined records. Nested records are
+// flattened into dotted field names; unnamed fields are called field_<n>.
+// Anything else (conditionals, variable-size arrays, expressions) is
+// rejected with an error rather than mis-parsed.
+//
+// The compiled description is opaque bytecode with no layout API, so the
+// layout cannot be read back from openzl::sddl::Compiler. To keep the two
+// from drifting, callers also compile the source and fail when the real
+// compiler rejects it; this parser only ever narrows what is accepted.
+// Record widths and field counts are capped, and sizes are overflow
+// checked, since a short description can expand to a huge layout.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kSddlMaxRecordWidth = 1 << 20;
+static constexpr size_t kSddlMaxFields = 4096;
+
+enum class SddlScalar : uint8_t { UInt = 0, Int = 1, Float = 2 };
+
+static const char *kSddlScalarNames[] = {"uint", "int", "float"};
+
+struct SddlField {
+  std::string name;
+  size_t offset;     // byte offset within the record
+  size_t width;      // element width in bytes
+  size_t count;      // elements per record (1 unless an array)
+  SddlScalar scalar;
+  bool big_endian;
+};
+
+struct SddlLayout {
+  std::vector<SddlField> fields;
+  size_t record_width;
+};
+
+struct SddlBuiltin {
+  const char *name;
+  size_t width;
+  SddlScalar scalar;
+  bool big_endian;
+};
+
+static const SddlBuiltin kSddlBuiltins[] = {
+    {"Byte", 1, SddlScalar::UInt, false},
+    {"UInt8", 1, SddlScalar::UInt, false},
+    {"Int8", 1, SddlScalar::Int, false},
+    {"UInt16LE", 2, SddlScalar::UInt, false},
+    {"UInt16BE", 2, SddlScalar::UInt, true},
+    {"Int16LE", 2, SddlScalar::Int, false},
+    {"Int16BE", 2, SddlScalar::Int, true},
+    {"UInt32LE", 4, SddlScalar::UInt, false},
+    {"UInt32BE", 4, SddlScalar::UInt, true},
+    {"Int32LE", 4, SddlScalar::Int, false},
+    {"Int32BE", 4, SddlScalar::Int, true},
+    {"UInt64LE", 8, SddlScalar::UInt, false},
+    {"UInt64BE", 8, SddlScalar::UInt, true},
+    {"Int64LE", 8, SddlScalar::Int, false},
+    {"Int64BE", 8, SddlScalar::Int, true},
+    {"Float32LE", 4, SddlScalar::Float, false},
+    {"Float32BE", 4, SddlScalar::Float, true},
+    {"Float64LE", 8, SddlScalar::Float, false},
+    {"Float64BE", 8, SddlScalar::Float, true},
+};
+
+class SddlLayoutParser {
+public:
+  explicit SddlLayoutParser(std::string_view source) : src_(source), pos_(0) {}
+
+  std::optional<std::string> parse(SddlLayout &layout) {
+    bool have_root = false;
+    skip_separators();
+    while (pos_ < src_.size()) {
+      if (peek() == ':') {
+        pos_++;
+        if (have_root) {
+          return error("multiple root consumptions");
+        }
+        SddlLayout root;
+        bool repeated = false;
+        if (!parse_type(root, true, repeated)) {
+          return error_;
+        }
+        layout = std::move(root);
+        have_root = true;
+      } else {
+        std::string name = identifier();
+        if (name.empty()) {
+          return error("expected a definition or ':'");
+        }
+        skip_spaces();
+        if (peek() != '=') {
+          return error("expected '=' after " + name);
+        }
+        pos_++;
+        SddlLayout type;
+        bool repeated = false;
+        if (!parse_type(type, false, repeated)) {
+          return error_;
+        }
+        types_.emplace_back(std::move(name), std::move(type));
+      }
+      skip_separators();
+    }
+    if (!have_root) {
+      return error("description has no root ':' consumption");
+    }
+    if (layout.record_width == 0) {
+      return error("record has no fields");
+    }
+    return std::nullopt;
+  }
+
+private:
+  std::string_view src_;
+  size_t pos_;
+  std::string error_;
+  std::vector<std::pair<std::string, SddlLayout>> types_;
+
+  char peek() const { return pos_ < src_.size() ? src_[pos_] : '\0'; }
+
+  std::optional<std::string> error(const std::string &msg) {
+    error_ = "unsupported SDDL for column layout: " + msg;
+    return error_;
+  }
+
+  bool fail(const std::string &msg) {
+    error(msg);
+    return false;
+  }
+
+  void skip_comment() {
+    if (peek() == '#' ||
+        (peek() == '/' && pos_ + 1 < src_.size() && src_[pos_ + 1] == '/')) {
+      while (pos_ < src_.size() && src_[pos_] != '\n') {
+        pos_++;
+      }
+    }
+  }
+
+  void skip_spaces() {
+    while (pos_ < src_.size()) {
+      char c = src_[pos_];
+      if (c == ' ' || c == '\t' || c == '\r') {
+        pos_++;
+      } else if (c == '#' || c == '/') {
+        size_t before = pos_;
+        skip_comment();
+        if (pos_ == before) {
+          return;
+        }
+      } else {
+        return;
+      }
+    }
+  }
+
+  void skip_separators() {
+    for (;;) {
+      skip_spaces();
+      if (peek() == '\n' || peek() == ';' || peek() == ',') {
+        pos_++;
+      } else {
+        return;
+      }
+    }
+  }
+
+  std::string identifier() {
+    skip_spaces();
+    size_t start = pos_;
+    while (pos_ < src_.size() &&
+           (std::isalnum(static_cast<unsigned char>(src_[pos_])) ||
+            src_[pos_] == '_')) {
+      pos_++;
+    }
+    if (start < src_.size() &&
+        std::isdigit(static_cast<unsigned char>(src_[start]))) {
+      pos_ = start;
+      return std::string();
+    }
+    return std::string(src_.substr(start, pos_ - start));
+  }
+
+  bool number(size_t &out) {
+    skip_spaces();
+    size_t start = pos_;
+    out = 0;
+    while (pos_ < src_.size() &&
+           std::isdigit(static_cast<unsigned char>(src_[pos_]))) {
+      if (out > kSddlMaxRecordWidth) {
+        return fail("number too large");
+      }
+      out = out * 10 + static_cast<size_t>(src_[pos_] - '0');
+      pos_++;
+    }
+    return pos_ > start;
+  }
+
+  // Width of `count` repeats of `width`, failing past the record cap.
+  bool repeat_width(size_t width, size_t count, size_t &out) {
+    if (count != 0 && width > kSddlMaxRecordWidth / count) {
+      return fail("record wider than " + std::to_string(kSddlMaxRecordWidth) +
+                  " bytes");
+    }
+    out = width * count;
+    return true;
+  }
+
+  // Append `type` to `into` at the current end, prefixing field names.
+  bool append_fields(SddlLayout &into, const SddlLayout &type,
+                     const std::string &prefix) {
+    if (type.record_width > kSddlMaxRecordWidth - into.record_width) {
+      return fail("record wider than " + std::to_string(kSddlMaxRecordWidth) +
+                  " bytes");
+    }
+    if (type.fields.size() > kSddlMaxFields - into.fields.size()) {
+      return fail("more than " + std::to_string(kSddlMaxFields) + " fields");
+    }
+    for (const SddlField &field : type.fields) {
+      SddlField copy = field;
+      copy.offset += into.record_width;
+      if (!prefix.empty()) {
+        copy.name = field.name.empty() ? prefix : prefix + "." + field.name;
+      }
+      into.fields.push_back(std::move(copy));
+    }
+    into.record_width += type.record_width;
+    return true;
+  }
+
+  bool lookup(const std::string &name, SddlLayout &out) {
+    for (const SddlBuiltin &builtin : kSddlBuiltins) {
+      if (name == builtin.name) {
+        out.fields = {SddlField{"", 0, builtin.width, 1, builtin.scalar,
+                                builtin.big_endian}};
+        out.record_width = builtin.width;
+        return true;
+      }
+    }
+    for (auto it = types_.rbegin(); it != types_.rend(); ++it) {
+      if (it->first == name) {
+        out = it->second;
+        return true;
+      }
+    }
+    return fail("unknown type " + name);
+  }
+
+  bool parse_record(SddlLayout &out) {
+    out.fields.clear();
+    out.record_width = 0;
+    size_t unnamed = 0;
+    skip_separators();
+    while (peek() != '}') {
+      if (pos_ >= src_.size()) {
+        return fail("unterminated record");
+      }
+
+      // Either "name : Type" or a bare "Type"
+      size_t save = pos_;
+      std::string name = identifier();
+      skip_spaces();
+      if (!name.empty() && peek() == ':') {
+        pos_++;
+      } else {
+        pos_ = save;
+        name = "field_" + std::to_string(unnamed);
+      }
+      unnamed++;
+
+      SddlLayout field_type;
+      bool repeated = false;
+      if (!parse_type(field_type, false, repeated)) {
+        return false;
+      }
+      if (!append_fields(out, field_type, name)) {
+        return false;
+      }
+      skip_separators();
+    }
+    pos_++; // '}'
+    return true;
+  }
+
+  bool parse_type(SddlLayout &out, bool is_root, bool &repeated) {
+    skip_spaces();
+    if (peek() == '{') {
+      pos_++;
+      if (!parse_record(out)) {
+        return false;
+      }
+    } else {
+      std::string name = identifier();
+      if (name.empty()) {
+        return fail("expected a type");
+      }
+      if (!lookup(name, out)) {
+        return false;
+      }
+    }
+
+    skip_spaces();
+    if (peek() != '[') {
+      return true;
+    }
+    pos_++;
+
+    size_t count = 0;
+    std::string rem = identifier();
+    if (rem == "_rem") {
+      if (!is_root) {
+        return fail("_rem arrays are only supported at the root");
+      }
+      skip_spaces();
+      if (peek() == '/') {
+        pos_++;
+        size_t divisor;
+        if (!number(divisor) || divisor != out.record_width) {
+          return fail("_rem divisor must equal the record width (" +
+                      std::to_string(out.record_width) + ")");
+        }
+      }
+      repeated = true;
+    } else if (!rem.empty() || !number(count) || count == 0) {
+      return fail("array sizes must be positive integer literals");
+    }
+
+    skip_spaces();
+    if (peek() != ']') {
+      return fail("expected ']'");
+    }
+    pos_++;
+
+    if (repeated || is_root) {
+      // Root arrays repeat the record; the layout stays one record wide.
+      return true;
+    }
+
+    size_t width;
+    if (!repeat_width(out.record_width, count, width)) {
+      return false;
+    }
+    if (out.fields.size() == 1 && out.fields[0].name.empty()) {
+      out.fields[0].count *= count;
+      out.record_width = width;
+      return true;
+    }
+    if (out.fields.size() > kSddlMaxFields / count) {
+      return fail("more than " + std::to_string(kSddlMaxFields) + " fields");
+    }
+
+    SddlLayout element = out;
+    out.fields.clear();
+    out.record_width = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (!append_fields(out, element, std::to_string(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+static std::optional<std::string> sddl_parse_layout(std::string_view source,
+                                                    SddlLayout &layout) {
+  if (source.empty()) {
+    return std::string("SDDL source must not be empty");
+  }
+  return SddlLayoutParser(source).parse(layout);
+}
+
+// ---------------------------------------------------------------------------
+// Helper: gather one field of every record into a contiguous column,
+// converting big-endian elements to native order.
+// ---------------------------------------------------------------------------
+
+static void gather_field(const unsigned char *records, size_t num_records,
+                         size_t record_width, const SddlField &field,
+                         unsigned char *out) {
+  kKernels.gather(records + field.offset, num_records, record_width,
+                  field.width * field.count, out);
+  if (field.big_endian) {
+    kKernels.byteswap(out, out, field.width, num_records * field.count);
+  }
+}
+
+static ERL_NIF_TERM make_sddl_field_map(ErlNifEnv *env,
+                                        const SddlField &field,
+                                        size_t num_records,
+                                        ERL_NIF_TERM data) {
+  ERL_NIF_TERM keys[6], vals[6];
+  keys[0] = fine::__private__::make_atom(env, "name");
+  vals[0] = copy_to_binary(env, field.name.data(), field.name.size());
+  keys[1] = fine::__private__::make_atom(env, "kind");
+  vals[1] = fine::__private__::make_atom(
+      env, kSddlScalarNames[static_cast<uint8_t>(field.scalar)]);
+  keys[2] = fine::__private__::make_atom(env, "element_width");
+  vals[2] = enif_make_uint64(env, field.width);
+  keys[3] = fine::__private__::make_atom(env, "elements_per_record");
+  vals[3] = enif_make_uint64(env, field.count);
+  keys[4] = fine::__private__::make_atom(env, "num_elements");
+  vals[4] = enif_make_uint64(env, num_records * field.count);
+  keys[5] = fine::__private__::make_atom(env, "data");
+  vals[5] = data;
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 6, &map);
+  return map;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_sddl_columns/3
+// Decompress a frame into one typed column per SDDL field:
+// (dctx, frame, sddl_source).
+//
+// The frame's outputs are decoded as typed buffers. A frame that already
+// carries one numeric output per field (for example the columns written
+// back with compress_multi_typed/2) maps straight onto the field names. A
+// frame from the SDDL graph has a single serial output: the graph's field
+// streams are internal to the frame and the decoder always reassembles
+// records from them, so fields are gathered out of those records.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_decompress_sddl_columns(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                            std::string_view compressed,
+                            std::string_view source) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  SddlLayout layout;
+  std::optional<std::string> err = sddl_parse_layout(source, layout);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+  // Refuse what the real compiler refuses, so the layout never describes
+  // a source the SDDL graph would not accept
+  std::string compiled;
+  err = sddl_compile_cached(source, compiled);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  ZL_Report num_report =
+      ZL_getNumOutputs(compressed.data(), compressed.size());
+  if (ZL_isError(num_report)) {
+    return fine::Error(
+        std::string("failed to get number of outputs from frame"));
+  }
+  size_t nb_outputs = ZL_validResult(num_report);
+  if (nb_outputs != 1 && nb_outputs != layout.fields.size()) {
+    return fine::Error(
+        std::string("frame needs one record output or one output per field"));
+  }
+
+  std::vector<TypedBufferPtr> bufs;
+  std::vector<ZL_TypedBuffer *> buf_ptrs;
+  for (size_t i = 0; i < nb_outputs; i++) {
+    TypedBufferPtr buf(ZL_TypedBuffer_create());
+    if (!buf) {
+      return fine::Error(std::string("failed to create typed buffer"));
+    }
+    buf_ptrs.push_back(buf.get());
+    bufs.push_back(std::move(buf));
+  }
+  ZL_Report result = ZL_DCtx_decompressMultiTBuffer(
+      dctx->ctx, buf_ptrs.data(), nb_outputs, compressed.data(),
+      compressed.size());
+  if (ZL_isError(result)) {
+    return fine::Error(std::string("decompression failed"));
+  }
+
+  std::vector<ERL_NIF_TERM> columns;
+
+  if (nb_outputs == 1 && ZL_TypedBuffer_type(buf_ptrs[0]) == ZL_Type_serial) {
+    size_t size = ZL_TypedBuffer_byteSize(buf_ptrs[0]);
+    if (size % layout.record_width != 0) {
+      return fine::Error(
+          std::string("decompressed size is not a whole number of records"));
+    }
+    size_t num_records = size / layout.record_width;
+    const unsigned char *src =
+        static_cast<const unsigned char *>(ZL_TypedBuffer_rPtr(buf_ptrs[0]));
+
+    for (const SddlField &field : layout.fields) {
+      ERL_NIF_TERM data_bin;
+      unsigned char *out = enif_make_new_binary(
+          env, num_records * field.width * field.count, &data_bin);
+      gather_field(src, num_records, layout.record_width, field, out);
+      columns.push_back(make_sddl_field_map(env, field, num_records, data_bin));
+    }
+  } else {
+    // One numeric output per field, already in native order; every field
+    // must agree on the record count
+    if (nb_outputs != layout.fields.size()) {
+      return fine::Error(std::string("frame output does not match the layout"));
+    }
+    size_t num_records = 0;
+    for (size_t i = 0; i < nb_outputs; i++) {
+      const SddlField &field = layout.fields[i];
+      ZL_TypedBuffer *tbuf = buf_ptrs[i];
+      size_t num_elts = ZL_TypedBuffer_numElts(tbuf);
+      if (ZL_TypedBuffer_type(tbuf) != ZL_Type_numeric ||
+          ZL_TypedBuffer_eltWidth(tbuf) != field.width ||
+          num_elts % field.count != 0 ||
+          (i > 0 && num_elts / field.count != num_records)) {
+        return fine::Error(std::string("frame output ") + std::to_string(i) +
+                           " does not match field " + field.name);
+      }
+      num_records = num_elts / field.count;
+      ERL_NIF_TERM data_bin = copy_to_binary(
+          env, ZL_TypedBuffer_rPtr(tbuf), ZL_TypedBuffer_byteSize(tbuf));
+      columns.push_back(make_sddl_field_map(env, field, num_records, data_bin));
+    }
+  }
+
+  ERL_NIF_TERM list =
+      enif_make_list_from_array(env, columns.data(), columns.size());
+  return fine::Ok(fine::Term(list));
+}
+
+FINE_NIF(nif_decompress_sddl_columns, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 10: SDDL Introspection
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: compress with a throwaway context bound to `compressor`, returning
+// the compressed size and the encode time.
+// ---------------------------------------------------------------------------
+
+struct EncodeCost {
+  size_t compressed_size;
+  uint64_t encode_ns;
+};
+
+static std::optional<std::string> measure_encode(ZL_Compressor *compressor,
+                                                 std::string_view raw,
+                                                 EncodeCost &cost) {
+  CCtx cctx;
+  if (!cctx.ctx) {
+    return std::string("failed to create compression context");
+  }
+  (void)ZL_CCtx_setParameter(cctx.ctx, ZL_CParam_formatVersion,
+                             static_cast<int>(ZL_getDefaultEncodingVersion()));
+  ZL_Report ref = ZL_CCtx_refCompressor(cctx.ctx, compressor);
+  if (ZL_isError(ref)) {
+    return std::string("failed to attach compressor");
+  }
+
+  size_t bound = ZL_compressBound(raw.size());
+  std::string output(bound, '\0');
+
+  auto start = std::chrono::steady_clock::now();
+  ZL_Report result = ZL_CCtx_compress(cctx.ctx, output.data(), bound,
+                                      raw.data(), raw.size());
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx.ctx, result);
+    return err ? std::string(err) : "compression failed";
+  }
+
+  cost.compressed_size = ZL_validResult(result);
+  cost.encode_ns = static_cast<uint64_t>(elapsed.count());
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: sddl_describe/2
+// Describe the record layout of an SDDL source and measure each field's
+// cost on a sample: (source, sample).
+//
+// The whole sample is compressed with the SDDL profile for the total. Each
+// field's cost is then measured under the same profile as its marginal
+// size and time: the total minus the size (and encode time) of the sample
+// with that field zeroed in every record, which is what the field's values
+// add to the frame. Each marginal is a full compression of the sample, so
+// only the kSddlDescribeMaxMeasured widest fields are measured; the rest
+// report nil costs.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kSddlDescribeMaxMeasured = 64;
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_sddl_describe(ErlNifEnv *env, std::string_view source,
+                  std::string_view sample) {
+  SddlLayout layout;
+  std::optional<std::string> err = sddl_parse_layout(source, layout);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+  if (sample.empty() || sample.size() % layout.record_width != 0) {
+    return fine::Error(
+        std::string("sample must be a non-empty whole number of records"));
+  }
+  size_t num_records = sample.size() / layout.record_width;
+
+  std::string compiled;
+  err = sddl_compile_cached(source, compiled);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  Compressor profile;
+  if (!profile.compressor) {
+    return fine::Error(std::string("failed to create compressor"));
+  }
+  err = sddl_setup_compressor(profile.compressor, compiled);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  EncodeCost total;
+  err = measure_encode(profile.compressor, sample, total);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  // Pick the widest fields to measure; ties keep layout order
+  std::vector<size_t> order(layout.fields.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return layout.fields[a].width * layout.fields[a].count >
+           layout.fields[b].width * layout.fields[b].count;
+  });
+  std::vector<bool> measured(layout.fields.size(), false);
+  for (size_t i = 0; i < order.size() && i < kSddlDescribeMaxMeasured; i++) {
+    measured[order[i]] = true;
+  }
+
+  std::string masked;
+  std::vector<ERL_NIF_TERM> fields;
+  ERL_NIF_TERM nil = fine::__private__::make_atom(env, "nil");
+
+  for (size_t f = 0; f < layout.fields.size(); f++) {
+    const SddlField &field = layout.fields[f];
+    size_t field_size = field.width * field.count;
+    ERL_NIF_TERM size_term = nil;
+    ERL_NIF_TERM time_term = nil;
+
+    if (measured[f]) {
+      masked.assign(sample.data(), sample.size());
+      for (size_t r = 0; r < num_records; r++) {
+        std::memset(&masked[r * layout.record_width + field.offset], 0,
+                    field_size);
+      }
+
+      EncodeCost without;
+      err = measure_encode(profile.compressor, masked, without);
+      if (err.has_value()) {
+        return fine::Error(std::move(*err));
+      }
+      // Zeroing can occasionally cost a few bytes or a little time; report
+      // that as free
+      size_term = enif_make_uint64(
+          env, total.compressed_size > without.compressed_size
+                   ? total.compressed_size - without.compressed_size
+                   : 0);
+      time_term = enif_make_uint64(env, total.encode_ns > without.encode_ns
+                                            ? total.encode_ns -
+                                                  without.encode_ns
+                                            : 0);
+    }
+
+    ERL_NIF_TERM keys[8], vals[8];
+    keys[0] = fine::__private__::make_atom(env, "name");
+    vals[0] = copy_to_binary(env, field.name.data(), field.name.size());
+    keys[1] = fine::__private__::make_atom(env, "kind");
+    vals[1] = fine::__private__::make_atom(
+        env, kSddlScalarNames[static_cast<uint8_t>(field.scalar)]);
+    keys[2] = fine::__private__::make_atom(env, "offset");
+    vals[2] = enif_make_uint64(env, field.offset);
+    keys[3] = fine::__private__::make_atom(env, "element_width");
+    vals[3] = enif_make_uint64(env, field.width);
+    keys[4] = fine::__private__::make_atom(env, "elements_per_record");
+    vals[4] = enif_make_uint64(env, field.count);
+    keys[5] = fine::__private__::make_atom(env, "raw_size");
+    vals[5] = enif_make_uint64(env, num_records * field_size);
+    keys[6] = fine::__private__::make_atom(env, "compressed_size");
+    vals[6] = size_term;
+    keys[7] = fine::__private__::make_atom(env, "encode_time_ns");
+    vals[7] = time_term;
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, vals, 8, &map);
+    fields.push_back(map);
+  }
+
+  ERL_NIF_TERM keys[6], vals[6];
+  keys[0] = fine::__private__::make_atom(env, "record_width");
+  vals[0] = enif_make_uint64(env, layout.record_width);
+  keys[1] = fine::__private__::make_atom(env, "num_records");
+  vals[1] = enif_make_uint64(env, num_records);
+  keys[2] = fine::__private__::make_atom(env, "raw_size");
+  vals[2] = enif_make_uint64(env, sample.size());
+  keys[3] = fine::__private__::make_atom(env, "compressed_size");
+  vals[3] = enif_make_uint64(env, total.compressed_size);
+  keys[4] = fine::__private__::make_atom(env, "encode_time_ns");
+  vals[4] = enif_make_uint64(env, total.encode_ns);
+  keys[5] = fine::__private__::make_atom(env, "fields");
+  vals[5] = enif_make_list_from_array(env, fields.data(), fields.size());
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 6, &map);
+  return fine::Ok(fine::Term(map));
+}
+
+FINE_NIF(nif_sddl_describe, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 11: SDDL Record-Type Dispatch
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: prepare a context for one-shot use with `compressor` (or the
+// default graph when null).
+// ---------------------------------------------------------------------------
+
+static std::optional<std::string> init_cctx(ZL_CCtx *ctx,
+                                            ZL_Compressor *compressor) {
+  if (!ctx) {
+    return std::string("failed to create compression context");
+  }
+  (void)ZL_CCtx_setParameter(ctx, ZL_CParam_formatVersion,
+                             static_cast<int>(ZL_getDefaultEncodingVersion()));
+  (void)ZL_CCtx_setParameter(ctx, ZL_CParam_stickyParameters, 1);
+  if (compressor) {
+    ZL_Report ref = ZL_CCtx_refCompressor(ctx, compressor);
+    if (ZL_isError(ref)) {
+      const char *err = ZL_CCtx_getErrorContextString(ctx, ref);
+      return err ? std::string(err) : "failed to attach compressor";
+    }
+  }
+  return std::nullopt;
+}
+
+static std::optional<std::string> compress_serial(ZL_CCtx *ctx,
+                                                  std::string_view input,
+                                                  std::string &output) {
+  size_t bound = ZL_compressBound(input.size());
+  output.resize(bound);
+  ZL_Report result =
+      ZL_CCtx_compress(ctx, output.data(), bound, input.data(), input.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(ctx, result);
+    return err ? std::string(err) : "compression failed";
+  }
+  output.resize(ZL_validResult(result));
+  return std::nullopt;
+}
+
+static std::optional<std::string> decompress_serial(ZL_DCtx *ctx,
+                                                    std::string_view frame,
+                                                    std::string &output) {
+  ZL_Report size = ZL_getDecompressedSize(frame.data(), frame.size());
+  if (ZL_isError(size)) {
+    return std::string("failed to read decompressed size from frame");
+  }
+  output.resize(ZL_validResult(size));
+  ZL_Report result = ZL_DCtx_decompress(ctx, output.data(), output.size(),
+                                        frame.data(), frame.size());
+  if (ZL_isError(result)) {
+    return std::string("decompression failed");
+  }
+  output.resize(ZL_validResult(result));
+  return std::nullopt;
+}
+
+// ---------------------------------------------------------------------------
+// Resource: SDDL dispatch compressor
+//
+// Input is a sequence of records, each a tag byte followed by a body whose
+// fixed layout is given by that tag's SDDL description. Compression splits
+// the input into a tag stream and one body stream per type, compresses
+// each body stream with its own SDDL graph and the tag stream with the
+// default graph, and packs them into one envelope:
+//
+//   "EZLD" u32 version=1
+//   u32 num_types
+//   num_types * { u8 tag, u32 record_width, u64 frame_size }
+//   u64 tag_frame_size
+//   tag frame, then each type's frame in the order listed
+//
+// Types with no records in the input have frame_size 0 and no frame. The
+// envelope is self-describing, so decoding needs only a DCtx.
+//
+// This is a container of several OpenZL frames rather than one frame. A
+// single frame would need one graph that selects a per-tag SDDL subgraph,
+// and the bundled SDDL graph takes one description per compressor with no
+// way to route records between descriptions. Each body stream therefore
+// gets its own frame and compressor, and the envelope ties them together.
+// ---------------------------------------------------------------------------
+
+static constexpr uint32_t kDispatchVersion = 1;
+
+struct DispatchType {
+  uint8_t tag;
+  size_t record_width;
+  fine::ResourcePtr<Compressor> compressor;
+  std::unique_ptr<CCtx> cctx;
+};
+
+class SddlDispatch {
+public:
+  std::mutex mutex;
+  std::vector<DispatchType> types;
+  CCtx tag_cctx;
+  // Type index per tag byte, -1 when unregistered
+  int16_t slot[256];
+
+  SddlDispatch() noexcept { std::fill(std::begin(slot), std::end(slot), -1); }
+};
+
+FINE_RESOURCE(SddlDispatch);
+
+// ---------------------------------------------------------------------------
+// NIF: create_dispatch_compressor/1
+// Build a dispatcher from [{tag, sddl_source}].
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<SddlDispatch>>,
+                    fine::Error<std::string>>
+nif_create_dispatch_compressor(
+    ErlNifEnv *env,
+    std::vector<std::tuple<uint64_t, std::string>> type_specs) {
+  if (type_specs.empty()) {
+    return fine::Error(std::string("at least one record type is required"));
+  }
+
+  auto dispatch = fine::make_resource<SddlDispatch>();
+  std::optional<std::string> err = init_cctx(dispatch->tag_cctx.ctx, nullptr);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  for (auto &[tag, source] : type_specs) {
+    if (tag > 255) {
+      return fine::Error(std::string("record tags must be 0..255"));
+    }
+    if (dispatch->slot[tag] >= 0) {
+      return fine::Error("duplicate record tag " + std::to_string(tag));
+    }
+
+    SddlLayout layout;
+    err = sddl_parse_layout(source, layout);
+    if (err.has_value()) {
+      return fine::Error("tag " + std::to_string(tag) + ": " + *err);
+    }
+
+    std::string compiled;
+    err = sddl_compile_cached(source, compiled);
+    if (err.has_value()) {
+      return fine::Error("tag " + std::to_string(tag) + ": " + *err);
+    }
+
+    auto comp = fine::make_resource<Compressor>();
+    if (!comp->compressor) {
+      return fine::Error(std::string("failed to create compressor"));
+    }
+    err = sddl_setup_compressor(comp->compressor, compiled);
+    if (err.has_value()) {
+      return fine::Error("tag " + std::to_string(tag) + ": " + *err);
+    }
+
+    auto cctx = std::make_unique<CCtx>();
+    err = init_cctx(cctx->ctx, comp->compressor);
+    if (err.has_value()) {
+      return fine::Error(std::move(*err));
+    }
+
+    dispatch->slot[tag] = static_cast<int16_t>(dispatch->types.size());
+    dispatch->types.push_back(DispatchType{static_cast<uint8_t>(tag),
+                                           layout.record_width,
+                                           std::move(comp), std::move(cctx)});
+  }
+
+  return fine::Ok(std::move(dispatch));
+}
+
+FINE_NIF(nif_create_dispatch_compressor, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: compress_dispatch/2
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_dispatch(ErlNifEnv *env, fine::ResourcePtr<SddlDispatch> dispatch,
+                      std::string_view input) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  std::lock_guard<std::mutex> lock(dispatch->mutex);
+  size_t num_types = dispatch->types.size();
+
+  // Split into the tag stream and one body stream per type
+  std::string tags;
+  std::vector<std::string> bodies(num_types);
+  size_t pos = 0;
+  while (pos < input.size()) {
+    uint8_t tag = static_cast<uint8_t>(input[pos]);
+    int16_t slot = dispatch->slot[tag];
+    if (slot < 0) {
+      return fine::Error("unknown record tag " + std::to_string(tag) +
+                         " at offset " + std::to_string(pos));
+    }
+    size_t width = dispatch->types[slot].record_width;
+    if (input.size() - pos - 1 < width) {
+      return fine::Error("truncated record at offset " + std::to_string(pos));
+    }
+    tags.push_back(static_cast<char>(tag));
+    bodies[slot].append(input.data() + pos + 1, width);
+    pos += 1 + width;
+  }
+
+  std::string tag_frame;
+  std::optional<std::string> err =
+      compress_serial(dispatch->tag_cctx.ctx, tags, tag_frame);
+  if (err.has_value()) {
+    return fine::Error(std::move(*err));
+  }
+
+  std::vector<std::string> frames(num_types);
+  for (size_t i = 0; i < num_types; i++) {
+    if (bodies[i].empty()) {
+      continue;
+    }
+    err = compress_serial(dispatch->types[i].cctx->ctx, bodies[i], frames[i]);
+    if (err.has_value()) {
+      return fine::Error("tag " + std::to_string(dispatch->types[i].tag) +
+                         ": " + *err);
+    }
+  }
+
+  std::string output(kDispatchMagic, sizeof(kDispatchMagic));
+  put_le32(output, kDispatchVersion);
+  put_le32(output, static_cast<uint32_t>(num_types));
+  for (size_t i = 0; i < num_types; i++) {
+    output.push_back(static_cast<char>(dispatch->types[i].tag));
+    put_le32(output, static_cast<uint32_t>(dispatch->types[i].record_width));
+    put_le64(output, frames[i].size());
+  }
+  put_le64(output, tag_frame.size());
+  output += tag_frame;
+  for (const std::string &frame : frames) {
+    output += frame;
+  }
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_dispatch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_dispatch/2
+// Reassemble the original tagged records from a dispatch envelope.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_decompress_dispatch(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                        std::string_view frame) {
+  if (frame.size() < 8 ||
+      std::memcmp(frame.data(), kDispatchMagic, sizeof(kDispatchMagic)) != 0) {
+    return fine::Error(std::string("not a dispatch frame"));
+  }
+  ByteReader reader(frame.data() + sizeof(kDispatchMagic),
+                    frame.size() - sizeof(kDispatchMagic));
+  if (reader.u32() != kDispatchVersion) {
+    return fine::Error(std::string("unsupported dispatch frame version"));
+  }
+
+  struct Entry {
+    size_t record_width;
+    uint64_t frame_size;
+  };
+  uint32_t num_types = reader.u32();
+  int16_t slot[256];
+  std::fill(std::begin(slot), std::end(slot), -1);
+  std::vector<Entry> entries;
+  for (uint32_t i = 0; i < num_types && reader.ok; i++) {
+    uint8_t tag = reader.u8();
+    size_t width = reader.u32();
+    uint64_t size = reader.u64();
+    if (slot[tag] >= 0 || size > frame.size()) {
+      return fine::Error(std::string("corrupt dispatch frame header"));
+    }
+    slot[tag] = static_cast<int16_t>(entries.size());
+    entries.push_back(Entry{width, size});
+  }
+  uint64_t tag_frame_size = reader.u64();
+  if (!reader.ok || tag_frame_size > frame.size()) {
+    return fine::Error(std::string("truncated dispatch frame header"));
+  }
+  size_t offset = frame.size() - static_cast<size_t>(reader.end - reader.p);
+
+  uint64_t payload = tag_frame_size;
+  for (const Entry &entry : entries) {
+    payload += entry.frame_size;
+  }
+  if (payload != frame.size() - offset) {
+    return fine::Error(std::string("dispatch frame size mismatch"));
+  }
+
+  std::string tags;
+  std::optional<std::string> err = decompress_serial(
+      dctx->ctx, frame.substr(offset, tag_frame_size), tags);
+  if (err.has_value()) {
+    return fine::Error("tag stream: " + *err);
+  }
+  offset += tag_frame_size;
+
+  std::vector<std::string> bodies(entries.size());
+  size_t total = tags.size();
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i].frame_size > 0) {
+      err = decompress_serial(
+          dctx->ctx, frame.substr(offset, entries[i].frame_size), bodies[i]);
+      if (err.has_value()) {
+        return fine::Error(std::move(*err));
+      }
+      offset += entries[i].frame_size;
+    }
+    total += bodies[i].size();
+  }
+
+  ERL_NIF_TERM out_bin;
+  unsigned char *out = enif_make_new_binary(env, total, &out_bin);
+  std::vector<size_t> cursor(entries.size(), 0);
+  size_t written = 0;
+  for (char c : tags) {
+    int16_t s = slot[static_cast<uint8_t>(c)];
+    if (s < 0 ||
+        bodies[s].size() - cursor[s] < entries[s].record_width) {
+      return fine::Error(std::string("dispatch streams do not match tags"));
+    }
+    out[written++] = static_cast<unsigned char>(c);
+    std::memcpy(out + written, bodies[s].data() + cursor[s],
+                entries[s].record_width);
+    cursor[s] += entries[s].record_width;
+    written += entries[s].record_width;
+  }
+  if (written != total) {
+    return fine::Error(std::string("dispatch streams do not match tags"));
+  }
+
+  return fine::Ok(fine::Term(out_bin));
+}
+
+FINE_NIF(nif_decompress_dispatch, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 12: Build Info
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// NIF: build_info/0
+// Report the OpenZL version, the ISA the NIF's kernels are built for, and
+// the relevant CPU features of the running machine.
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_build_info(ErlNifEnv *env) {
+  std::vector<ERL_NIF_TERM> features;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    features.push_back(fine::__private__::make_atom(env, "sse4_2"));
+  }
+  if (__builtin_cpu_supports("popcnt")) {
+    features.push_back(fine::__private__::make_atom(env, "popcnt"));
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    features.push_back(fine::__private__::make_atom(env, "avx2"));
+  }
+  if (__builtin_cpu_supports("bmi2")) {
+    features.push_back(fine::__private__::make_atom(env, "bmi2"));
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    features.push_back(fine::__private__::make_atom(env, "avx512f"));
+  }
+  if (__builtin_cpu_supports("avx512bw")) {
+    features.push_back(fine::__private__::make_atom(env, "avx512bw"));
+  }
+  if (__builtin_cpu_supports("avx512vl")) {
+    features.push_back(fine::__private__::make_atom(env, "avx512vl"));
+  }
+  if (__builtin_cpu_supports("avx512vpopcntdq")) {
+    features.push_back(fine::__private__::make_atom(env, "avx512vpopcntdq"));
+  }
+#endif
+
+#if defined(__clang__)
+  std::string compiler = std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+  std::string compiler = std::string("gcc ") + __VERSION__;
+#else
+  std::string compiler = "unknown";
+#endif
+
+  std::string version = nif_version(env);
+
+  ERL_NIF_TERM keys[4], vals[4];
+  keys[0] = fine::__private__::make_atom(env, "openzl_version");
+  vals[0] = copy_to_binary(env, version.data(), version.size());
+  keys[1] = fine::__private__::make_atom(env, "kernel_isa");
+  vals[1] = fine::__private__::make_atom(env, kKernels.isa);
+  keys[2] = fine::__private__::make_atom(env, "cpu_features");
+  vals[2] = enif_make_list_from_array(env, features.data(), features.size());
+  keys[3] = fine::__private__::make_atom(env, "compiler");
+  vals[3] = copy_to_binary(env, compiler.data(), compiler.size());
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 4, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_build_info, 0);
+
+// ===================================================================
+// Phase 13: Column Filtering
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: decode a bound term into the widened bits for `kind`.
+// ---------------------------------------------------------------------------
+
+static bool decode_bound(ErlNifEnv *env, ERL_NIF_TERM term, ElementKind kind,
+                         uint64_t &bits) {
+  switch (kind) {
+  case ElementKind::UInt: {
+    ErlNifUInt64 v;
+    if (!enif_get_uint64(env, term, &v)) {
+      return false;
+    }
+    bits = v;
+    return true;
+  }
+  case ElementKind::Int: {
+    ErlNifSInt64 v;
+    if (!enif_get_int64(env, term, &v)) {
+      return false;
+    }
+    int64_t wide = v;
+    std::memcpy(&bits, &wide, sizeof(bits));
+    return true;
+  }
+  case ElementKind::Float: {
+    double v;
+    if (!enif_get_double(env, term, &v)) {
+      return false;
+    }
+    std::memcpy(&bits, &v, sizeof(bits));
+    return true;
+  }
+  }
+  return false;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: filter_range/5
+// Select the elements of a numeric column within [min, max]:
+// (data, kind, width, min, max) -> {bitmap, match_count}
+// kind: 0 = unsigned, 1 = signed, 2 = float. Bounds must already be
+// integers for integer kinds and floats for float kinds.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term, uint64_t>, fine::Error<std::string>>
+nif_filter_range(ErlNifEnv *env, std::string_view data, uint64_t kind_code,
+                 uint64_t width, fine::Term min, fine::Term max) {
+  if (kind_code > 2) {
+    return fine::Error(std::string("unknown element kind"));
+  }
+  ElementKind kind = static_cast<ElementKind>(kind_code);
+  int index = element_type_index(kind, width);
+  if (index < 0) {
+    return fine::Error(std::string("unsupported element kind and width"));
+  }
+  if (data.size() % width != 0) {
+    return fine::Error(
+        std::string("data size must be a multiple of element width"));
+  }
+
+  uint64_t lo_bits, hi_bits;
+  if (!decode_bound(env, min, kind, lo_bits) ||
+      !decode_bound(env, max, kind, hi_bits)) {
+    return fine::Error(std::string("bounds do not match the element kind"));
+  }
+
+  size_t count = data.size() / width;
+  ERL_NIF_TERM bitmap_bin;
+  unsigned char *bitmap =
+      enif_make_new_binary(env, (count + 7) / 8, &bitmap_bin);
+  uint64_t matches = kElementKernels[index].filter_range(
+      reinterpret_cast<const unsigned char *>(data.data()), count, lo_bits,
+      hi_bits, bitmap);
+
+  return fine::Ok(fine::Term(bitmap_bin), matches);
+}
+
+FINE_NIF(nif_filter_range, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 14: Native Buffers
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Resource: fixed-capacity native output buffer
+//
+// Decompression writes into the buffer's memory in place, so a set of
+// buffers can be reused for steady-state decoding with no allocation.
+//
+// The memory lives in a BufferBlock. Views are resource binaries backed by
+// a BufferView that shares ownership of the block, so a view is immutable:
+// when decompress_into finds the block still shared by a live view it
+// moves the buffer to a fresh block and leaves the old one to the views.
+// Blocks are only ever written, or have their string lengths resized,
+// while the buffer owns them alone.
+// ---------------------------------------------------------------------------
+
+struct BufferBlock {
+  std::unique_ptr<unsigned char[]> data;
+  // String lengths of the last string output; grows to the largest count seen
+  std::vector<uint32_t> string_lens;
+
+  explicit BufferBlock(size_t cap)
+      : data(new (std::nothrow) unsigned char[cap]) {}
+};
+
+class NativeBuffer {
+public:
+  std::mutex mutex;
+  std::shared_ptr<BufferBlock> block;
+  size_t capacity;
+  size_t length = 0;
+  ZL_Type type = ZL_Type_serial;
+  size_t elt_width = 1;
+  size_t num_elts = 0;
+
+  explicit NativeBuffer(size_t cap)
+      : block(std::make_shared<BufferBlock>(cap)), capacity(cap) {}
+
+  // Ensures the block is not shared with any view before it is written.
+  // use_count only drops concurrently (views are created under the mutex),
+  // so a stale read can at worst cause a needless replacement.
+  bool own_block() {
+    if (block.use_count() == 1) {
+      return true;
+    }
+    auto fresh = std::make_shared<BufferBlock>(capacity);
+    if (!fresh->data) {
+      return false;
+    }
+    block = std::move(fresh);
+    return true;
+  }
+};
+
+FINE_RESOURCE(NativeBuffer);
+
+// Backing object of a view binary; keeps the viewed block alive.
+class BufferView {
+public:
+  std::shared_ptr<BufferBlock> block;
+
+  explicit BufferView(std::shared_ptr<BufferBlock> b) : block(std::move(b)) {}
+};
+
+FINE_RESOURCE(BufferView);
+
+static ERL_NIF_TERM make_view_binary(ErlNifEnv *env, NativeBuffer &buf,
+                                     const void *data, size_t size) {
+  auto view = fine::make_resource<BufferView>(buf.block);
+  return enif_make_resource_binary(env, view.get(), data, size);
+}
+
+static ERL_NIF_TERM make_buffer_info(ErlNifEnv *env, const NativeBuffer &buf) {
+  ERL_NIF_TERM keys[5], vals[5];
+  keys[0] = fine::__private__::make_atom(env, "capacity");
+  vals[0] = enif_make_uint64(env, buf.capacity);
+  keys[1] = fine::__private__::make_atom(env, "length");
+  vals[1] = enif_make_uint64(env, buf.length);
+  keys[2] = fine::__private__::make_atom(env, "type");
+  vals[2] = fine::__private__::make_atom(env, type_to_string(buf.type));
+  keys[3] = fine::__private__::make_atom(env, "element_width");
+  vals[3] = enif_make_uint64(env, buf.elt_width);
+  keys[4] = fine::__private__::make_atom(env, "num_elements");
+  vals[4] = enif_make_uint64(env, buf.num_elts);
+
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 5, &map);
+  return map;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_new/1
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<NativeBuffer>>,
+                    fine::Error<std::string>>
+nif_buffer_new(ErlNifEnv *env, uint64_t capacity) {
+  if (capacity == 0) {
+    return fine::Error(std::string("capacity must be positive"));
+  }
+  auto buf = fine::make_resource<NativeBuffer>(capacity);
+  if (!buf->block->data) {
+    return fine::Error(std::string("failed to allocate buffer"));
+  }
+  return fine::Ok(std::move(buf));
+}
+
+FINE_NIF(nif_buffer_new, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_info/1
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_buffer_info(ErlNifEnv *env,
+                                  fine::ResourcePtr<NativeBuffer> buf) {
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  return fine::Term(make_buffer_info(env, *buf));
+}
+
+FINE_NIF(nif_buffer_info, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_reset/1
+// ---------------------------------------------------------------------------
+
+static fine::Atom nif_buffer_reset(ErlNifEnv *env,
+                                   fine::ResourcePtr<NativeBuffer> buf) {
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  buf->length = 0;
+  buf->type = ZL_Type_serial;
+  buf->elt_width = 1;
+  buf->num_elts = 0;
+  return fine::Atom("ok");
+}
+
+FINE_NIF(nif_buffer_reset, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_into/3
+// Decompress a single-output frame into a native buffer: (dctx, frame, buf).
+// Serial frames decode as raw bytes; typed frames decode into the buffer
+// wrapped as the output TypedBuffer. Returns the buffer info map.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_decompress_into(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                    std::string_view compressed,
+                    fine::ResourcePtr<NativeBuffer> buf) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  FrameInfoPtr fi(ZL_FrameInfo_create(compressed.data(), compressed.size()));
+  if (!fi) {
+    return fine::Error(std::string("failed to create frame info"));
+  }
+
+  ZL_Report num_report = ZL_FrameInfo_getNumOutputs(fi.get());
+  ZL_Report type_report = ZL_FrameInfo_getOutputType(fi.get(), 0);
+  ZL_Report size_report = ZL_FrameInfo_getDecompressedSize(fi.get(), 0);
+  ZL_Report elts_report = ZL_FrameInfo_getNumElts(fi.get(), 0);
+  if (ZL_isError(num_report) || ZL_isError(type_report) ||
+      ZL_isError(size_report) || ZL_isError(elts_report)) {
+    return fine::Error(std::string("failed to read frame info"));
+  }
+  if (ZL_validResult(num_report) != 1) {
+    return fine::Error(
+        std::string("decompress_into supports single-output frames only"));
+  }
+
+  ZL_Type type = (ZL_Type)ZL_validResult(type_report);
+  size_t byte_size = ZL_validResult(size_report);
+  size_t num_elts = ZL_validResult(elts_report);
+
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  if (byte_size > buf->capacity) {
+    return fine::Error("buffer too small: frame decodes to " +
+                       std::to_string(byte_size) + " bytes, capacity is " +
+                       std::to_string(buf->capacity));
+  }
+
+  if (!buf->own_block()) {
+    return fine::Error(
+        std::string("failed to allocate buffer memory in place of viewed "
+                    "contents"));
+  }
+  unsigned char *data = buf->block->data.get();
+  std::vector<uint32_t> &string_lens = buf->block->string_lens;
+
+  // A failed decode leaves the buffer empty rather than half-described
+  buf->length = 0;
+  buf->num_elts = 0;
+
+  if (type == ZL_Type_serial) {
+    ZL_Report result =
+        ZL_DCtx_decompress(dctx->ctx, data, buf->capacity, compressed.data(),
+                           compressed.size());
+    if (ZL_isError(result)) {
+      const char *err = ZL_DCtx_getErrorContextString(dctx->ctx, result);
+      return fine::Error(err ? std::string(err) : "decompression failed");
+    }
+    buf->type = ZL_Type_serial;
+    buf->length = ZL_validResult(result);
+    buf->elt_width = 1;
+    buf->num_elts = buf->length;
+    return fine::Ok(fine::Term(make_buffer_info(env, *buf)));
+  }
+
+  TypedBufferPtr tbuf;
+  switch (type) {
+  case ZL_Type_numeric:
+  case ZL_Type_struct: {
+    if (num_elts == 0 || byte_size % num_elts != 0) {
+      return fine::Error(std::string("unexpected element layout in frame"));
+    }
+    size_t width = byte_size / num_elts;
+    tbuf.reset(type == ZL_Type_numeric
+                   ? ZL_TypedBuffer_createWrapNumeric(data, width,
+                                                      buf->capacity / width)
+                   : ZL_TypedBuffer_createWrapStruct(data, width,
+                                                     buf->capacity / width));
+    break;
+  }
+  case ZL_Type_string:
+    if (string_lens.size() < num_elts) {
+      string_lens.resize(num_elts);
+    }
+    tbuf.reset(ZL_TypedBuffer_createWrapString(
+        data, buf->capacity, string_lens.data(), string_lens.size()));
+    break;
+  default:
+    return fine::Error(std::string("unsupported output type"));
+  }
+  if (!tbuf) {
+    return fine::Error(std::string("failed to create typed buffer"));
+  }
+
+  ZL_Report result = ZL_DCtx_decompressTBuffer(
+      dctx->ctx, tbuf.get(), compressed.data(), compressed.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_DCtx_getErrorContextString(dctx->ctx, result);
+    return fine::Error(err ? std::string(err) : "typed decompression failed");
+  }
+
+  buf->type = type;
+  buf->length = ZL_TypedBuffer_byteSize(tbuf.get());
+  buf->elt_width = ZL_TypedBuffer_eltWidth(tbuf.get());
+  buf->num_elts = ZL_TypedBuffer_numElts(tbuf.get());
+  return fine::Ok(fine::Term(make_buffer_info(env, *buf)));
+}
+
+FINE_NIF(nif_decompress_into, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_view/3
+// Zero-copy resource binary over buf[offset, offset + size). The view pins
+// the current block, so later decodes into the buffer never change it.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_buffer_view(ErlNifEnv *env, fine::ResourcePtr<NativeBuffer> buf,
+                uint64_t offset, uint64_t size) {
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  if (offset > buf->length || size > buf->length - offset) {
+    return fine::Error(std::string("range is outside the buffer contents"));
+  }
+  return fine::Ok(fine::Term(
+      make_view_binary(env, *buf, buf->block->data.get() + offset, size)));
+}
+
+FINE_NIF(nif_buffer_view, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_string_lengths/1
+// Zero-copy view of the u32 lengths of the last string output.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_buffer_string_lengths(ErlNifEnv *env,
+                          fine::ResourcePtr<NativeBuffer> buf) {
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  if (buf->type != ZL_Type_string) {
+    return fine::Error(std::string("buffer does not hold string output"));
+  }
+  return fine::Ok(fine::Term(
+      make_view_binary(env, *buf, buf->block->string_lens.data(),
+                       buf->num_elts * sizeof(uint32_t))));
+}
+
+FINE_NIF(nif_buffer_string_lengths, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: buffer_copy/3
+// Copy buf[offset, offset + size) into a new, independent binary.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Term>, fine::Error<std::string>>
+nif_buffer_copy(ErlNifEnv *env, fine::ResourcePtr<NativeBuffer> buf,
+                uint64_t offset, uint64_t size) {
+  std::lock_guard<std::mutex> lock(buf->mutex);
+  if (offset > buf->length || size > buf->length - offset) {
+    return fine::Error(std::string("range is outside the buffer contents"));
+  }
+  return fine::Ok(
+      fine::Term(copy_to_binary(env, buf->block->data.get() + offset, size)));
+}
+
+FINE_NIF(nif_buffer_copy, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 15: zstd Transcoding
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: first output allocation for decoding a zstd input. The frame
+// header's content size is untrusted, so it is capped at a generous
+// expansion of the input; decoding grows the buffer by doubling past that.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kZstdMaxInitialExpansion = 64;
+
+static size_t zstd_initial_capacity(std::string_view input) {
+  size_t floor = std::max<size_t>(input.size() * 4, 1 << 16);
+  unsigned long long hint =
+      ZSTD_getFrameContentSize(input.data(), input.size());
+  if (hint == ZSTD_CONTENTSIZE_UNKNOWN || hint == ZSTD_CONTENTSIZE_ERROR ||
+      hint == 0) {
+    return floor;
+  }
+  size_t cap = std::max(floor, input.size() * kZstdMaxInitialExpansion);
+  return static_cast<size_t>(std::min<unsigned long long>(hint, cap));
+}
+
+// ---------------------------------------------------------------------------
+// Helper: grow callback for ZstdStream::feed that doubles the output buffer
+// up to a maximum decoded size of kZstdMaxExpansion times the input (at
+// least kZstdExpansionFloor), so a small bomb cannot exhaust memory. The
+// buffer stops one byte past the limit; filling that byte is the error.
+// ---------------------------------------------------------------------------
+
+static constexpr uint64_t kZstdMaxExpansion = 1024;
+static constexpr uint64_t kZstdExpansionFloor = 64 * 1024 * 1024;
+
+struct ZstdCappedGrow {
+  uint64_t limit;
+
+  explicit ZstdCappedGrow(std::string_view input)
+      : limit(std::max<uint64_t>(kZstdExpansionFloor,
+                                 input.size() * kZstdMaxExpansion)) {}
+
+  std::optional<std::string> operator()(std::string &out, size_t &) const {
+    if (out.size() > limit) {
+      return std::string("zstd: decoded size exceeds ") +
+             std::to_string(limit) + " bytes";
+    }
+    out.resize(static_cast<size_t>(
+        std::min<uint64_t>(uint64_t(out.size()) * 2, limit + 1)));
+    return std::nullopt;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Transcode counters, updated after every chunk so a concurrent caller of
+// transcode_stats/0 sees progress through a long file.
+// ---------------------------------------------------------------------------
+
+struct TranscodeStats {
+  std::atomic<uint64_t> jobs{0};
+  std::atomic<uint64_t> active{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> zstd_bytes{0};
+  std::atomic<uint64_t> raw_bytes{0};
+  std::atomic<uint64_t> openzl_bytes{0};
+  std::atomic<uint64_t> time_ns{0};
+};
+
+static TranscodeStats &transcode_stats() {
+  static TranscodeStats stats;
+  return stats;
+}
+
+// Counts one transcode job as active for its lifetime and records its
+// wall time and outcome.
+class TranscodeJob {
+public:
+  TranscodeJob() : start_(std::chrono::steady_clock::now()) {
+    transcode_stats().jobs.fetch_add(1, std::memory_order_relaxed);
+    transcode_stats().active.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  ~TranscodeJob() {
+    TranscodeStats &stats = transcode_stats();
+    auto elapsed = std::chrono::steady_clock::now() - start_;
+    stats.time_ns.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+        std::memory_order_relaxed);
+    stats.active.fetch_sub(1, std::memory_order_relaxed);
+    if (!ok) {
+      stats.failed.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  bool ok = false;
+
+private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+struct ZstdDCtxDeleter {
+  void operator()(ZSTD_DCtx *ctx) const { ZSTD_freeDCtx(ctx); }
+};
+using ZstdDCtxPtr = std::unique_ptr<ZSTD_DCtx, ZstdDCtxDeleter>;
+
+// ---------------------------------------------------------------------------
+// Helper: streaming zstd decoder over a sequence of input pieces
+//
+// feed() decodes one piece of compressed input into `out`, starting at
+// `fill`, and calls `flush(out, fill)` whenever `out` is full; flush
+// resets `fill` to make room. Concatenated zstd frames are accepted.
+// ---------------------------------------------------------------------------
+
+class ZstdStream {
+public:
+  ZstdStream() : dctx_(ZSTD_createDCtx()) {}
+
+  bool valid() const { return dctx_ != nullptr; }
+
+  template <typename Flush>
+  std::optional<std::string> feed(std::string_view in_bytes, std::string &out,
+                                  size_t &fill, Flush &&flush) {
+    ZSTD_inBuffer in = {in_bytes.data(), in_bytes.size(), 0};
+    bool out_full = false;
+    // Keep going while input remains or the decoder may hold more output
+    // than fit last time.
+    while (in.pos < in.size || out_full) {
+      ZSTD_outBuffer ob = {out.data() + fill, out.size() - fill, 0};
+      size_t ret = ZSTD_decompressStream(dctx_.get(), &ob, &in);
+      if (ZSTD_isError(ret)) {
+        return std::string("zstd: ") + ZSTD_getErrorName(ret);
+      }
+      fill += ob.pos;
+      remaining_ = ret;
+      out_full = ob.pos == ob.size;
+      if (fill == out.size()) {
+        if (auto err = flush(out, fill)) {
+          return err;
+        }
+      } else if (!out_full && in.pos == in.size) {
+        break;
+      }
+    }
+    return std::nullopt;
+  }
+
+  // True when the input so far ended on a frame boundary.
+  bool complete() const { return remaining_ == 0; }
+
+private:
+  ZstdDCtxPtr dctx_;
+  size_t remaining_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// NIF: transcode_zstd/2
+// Decode a zstd binary (one or more frames) and recompress it as a single
+// serial OpenZL frame through cctx, without a BEAM binary in between.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_transcode_zstd(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                   std::string_view input) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  TranscodeJob job;
+  TranscodeStats &stats = transcode_stats();
+
+  ZstdStream zstd;
+  if (!zstd.valid()) {
+    return fine::Error(std::string("failed to create zstd context"));
+  }
+
+  std::string raw(zstd_initial_capacity(input), '\0');
+  size_t fill = 0;
+
+  if (auto err = zstd.feed(input, raw, fill, ZstdCappedGrow(input))) {
+    return fine::Error(std::move(*err));
+  }
+  if (!zstd.complete()) {
+    return fine::Error(std::string("zstd: truncated input"));
+  }
+  if (fill == 0) {
+    return fine::Error(std::string("zstd input decodes to no data"));
+  }
+  raw.resize(fill);
+
+  std::string output;
+  if (auto err = compress_serial(cctx->ctx, raw, output)) {
+    return fine::Error(std::move(*err));
+  }
+
+  stats.zstd_bytes.fetch_add(input.size(), std::memory_order_relaxed);
+  stats.raw_bytes.fetch_add(raw.size(), std::memory_order_relaxed);
+  stats.openzl_bytes.fetch_add(output.size(), std::memory_order_relaxed);
+  job.ok = true;
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_transcode_zstd, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: transcode_zstd_file/4
+// Stream a .zst file into a new append log: (src, dst, cctx, chunk_size)
+// Every chunk_size bytes of decoded data become one record in its own log
+// block, so memory stays bounded by one chunk and the result reads back
+// with log_stream/2. Returns {raw_bytes, log_bytes}.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<uint64_t, uint64_t>, fine::Error<std::string>>
+nif_transcode_zstd_file(ErlNifEnv *env, std::string src_path,
+                        std::string dst_path, fine::ResourcePtr<CCtx> cctx,
+                        uint64_t chunk_size) {
+  if (chunk_size == 0 || chunk_size > kLogMaxBlockSize) {
+    return fine::Error(std::string("chunk_size must be between 1 and 1 GiB"));
+  }
+
+  TranscodeJob job;
+  TranscodeStats &stats = transcode_stats();
+
+  int in_fd = ::open(src_path.c_str(), O_RDONLY);
+  if (in_fd < 0) {
+    return fine::Error(std::string("failed to open source file: ") +
+                       std::strerror(errno));
+  }
+  struct FdCloser {
+    int fd;
+    ~FdCloser() { ::close(fd); }
+  } in_closer{in_fd};
+
+  int out_fd = ::open(dst_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out_fd < 0) {
+    return fine::Error(std::string("failed to open destination file: ") +
+                       std::strerror(errno));
+  }
+
+  // The log writer owns out_fd from here and closes it on every path; a
+  // failed transcode removes the partial log.
+  AppendLog log;
+  struct PartialLogRemover {
+    const std::string &path;
+    const bool &ok;
+    ~PartialLogRemover() {
+      if (!ok) {
+        ::unlink(path.c_str());
+      }
+    }
+  } remover{dst_path, job.ok};
+  log.fd = out_fd;
+  log.block_size = static_cast<size_t>(chunk_size);
+  std::string header(kLogMagic, sizeof(kLogMagic));
+  put_le32(header, kLogVersion);
+  if (!write_all(out_fd, header.data(), header.size())) {
+    return fine::Error(std::string("failed to write log header"));
+  }
+  log.end_offset = kLogHeaderSize;
+  log.cctx_ref = cctx;
+
+  ZstdStream zstd;
+  if (!zstd.valid()) {
+    return fine::Error(std::string("failed to create zstd context"));
+  }
+
+  uint64_t raw_total = 0;
+  auto flush = [&](std::string &chunk,
+                   size_t &fill) -> std::optional<std::string> {
+    uint64_t before = log.end_offset;
+    log.pending_data.assign(chunk.data(), fill);
+    log.pending_lengths.assign(1, static_cast<uint32_t>(fill));
+    if (auto err = log_flush_block(log)) {
+      return err;
+    }
+    raw_total += fill;
+    stats.raw_bytes.fetch_add(fill, std::memory_order_relaxed);
+    stats.openzl_bytes.fetch_add(log.end_offset - before,
+                                 std::memory_order_relaxed);
+    fill = 0;
+    return std::nullopt;
+  };
+
+  std::string in_buf(ZSTD_DStreamInSize(), '\0');
+  std::string chunk(static_cast<size_t>(chunk_size), '\0');
+  size_t fill = 0;
+  for (;;) {
+    ssize_t n = ::read(in_fd, in_buf.data(), in_buf.size());
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return fine::Error(std::string("failed to read source file: ") +
+                         std::strerror(errno));
+    }
+    if (n == 0) {
+      break;
+    }
+    stats.zstd_bytes.fetch_add(static_cast<uint64_t>(n),
+                               std::memory_order_relaxed);
+    if (auto err = zstd.feed(std::string_view(in_buf.data(), n), chunk, fill,
+                             flush)) {
+      return fine::Error(std::move(*err));
+    }
+  }
+
+  if (!zstd.complete()) {
+    return fine::Error(std::string("zstd: truncated input"));
+  }
+  if (fill > 0) {
+    if (auto err = flush(chunk, fill)) {
+      return fine::Error(std::move(*err));
+    }
+  }
+  if (auto err = log_close_file(log)) {
+    return fine::Error(std::move(*err));
+  }
+
+  uint64_t log_bytes = log.end_offset + 4 +
+                       log.index.size() * kLogIndexEntrySize + kLogTrailerSize;
+  job.ok = true;
+  return fine::Ok(raw_total, log_bytes);
+}
+
+FINE_NIF(nif_transcode_zstd_file, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: transcode_stats/0
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_transcode_stats(ErlNifEnv *env) {
+  TranscodeStats &stats = transcode_stats();
+  const std::pair<const char *, uint64_t> fields[] = {
+      {"jobs", stats.jobs.load(std::memory_order_relaxed)},
+      {"active", stats.active.load(std::memory_order_relaxed)},
+      {"failed", stats.failed.load(std::memory_order_relaxed)},
+      {"zstd_bytes", stats.zstd_bytes.load(std::memory_order_relaxed)},
+      {"raw_bytes", stats.raw_bytes.load(std::memory_order_relaxed)},
+      {"openzl_bytes", stats.openzl_bytes.load(std::memory_order_relaxed)},
+      {"time_us", stats.time_ns.load(std::memory_order_relaxed) / 1000},
+  };
+  constexpr size_t n = sizeof(fields) / sizeof(fields[0]);
+  ERL_NIF_TERM keys[n], vals[n];
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = fine::__private__::make_atom(env, fields[i].first);
+    vals[i] = enif_make_uint64(env, fields[i].second);
+  }
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, n, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_transcode_stats, 0);
+
+// ===================================================================
+// Phase 16: LZ4 Fast Mode
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// NIF: compress_fast/2
+// Wrap data in an LZ4 envelope: (data, acceleration). Runs on a normal
+// scheduler; the Elixir wrapper sends large payloads to the dirty variant.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_fast(ErlNifEnv *env, std::string_view input,
+                  uint64_t acceleration) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+  if (acceleration == 0 || acceleration > LZ4_ACCELERATION_MAX) {
+    return fine::Error(std::string("acceleration must be between 1 and ") +
+                       std::to_string(LZ4_ACCELERATION_MAX));
+  }
+  std::string output;
+  if (auto err = lz4_wrap(input, static_cast<int>(acceleration), output)) {
+    return fine::Error(std::move(*err));
+  }
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_fast, 0);
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_fast_dirty(ErlNifEnv *env, std::string_view input,
+                        uint64_t acceleration) {
+  return nif_compress_fast(env, input, acceleration);
+}
+
+FINE_NIF(nif_compress_fast_dirty, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_fast/1
+// Decode a small LZ4 envelope on a normal scheduler.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_decompress_fast(ErlNifEnv *env, std::string_view envelope) {
+  if (!is_lz4_envelope(envelope)) {
+    return fine::Error(std::string("not an LZ4 envelope"));
+  }
+  std::string output;
+  if (auto err = lz4_unwrap(envelope, output)) {
+    return fine::Error(std::move(*err));
+  }
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_decompress_fast, 0);
+
+// ===================================================================
+// Phase 17: Adaptive Codec
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Auto envelope
+//
+//   u8 codec, payload
+//
+// The payload is exactly what the codec produces: the input itself, an
+// "EZL4" LZ4 envelope, a zstd frame, or an OpenZL frame (serial, or numeric
+// when the caller gave an element width). compress_auto probes a small
+// sample of each payload with the candidate codecs and keeps the one with
+// the lowest
+//
+//   cost = compressed_ratio + weight * ns_per_input_byte
+//
+// where the weight comes from the objective: 0 for :ratio, so only size
+// matters, up to kAutoSpeedWeight for :speed. Only :speed measures the
+// probe's time; :balanced uses fixed nominal costs per codec, so the same
+// input always picks the same codec.
+// ---------------------------------------------------------------------------
+
+enum class AutoCodec : uint8_t {
+  Raw = 0,
+  Lz4 = 1,
+  Zstd = 2,
+  OpenZL = 3,
+  OpenZLNumeric = 4,
+};
+
+static constexpr size_t kAutoCodecCount = 5;
+static constexpr const char *kAutoCodecNames[kAutoCodecCount] = {
+    "raw", "lz4", "zstd", "openzl", "openzl_numeric"};
+
+enum class AutoObjective : uint64_t { Speed = 0, Balanced = 1, Ratio = 2 };
+
+static constexpr double kAutoSpeedWeight = 0.5;
+static constexpr double kAutoBalancedWeight = 0.05;
+static constexpr int kAutoZstdLevelBalanced = 3;
+static constexpr int kAutoZstdLevelRatio = 12;
+// Payloads up to this size are probed whole and the winning output is
+// returned directly; larger ones are probed on kAutoSampleSlices slices.
+static constexpr size_t kAutoSampleBytes = 16 * 1024;
+static constexpr size_t kAutoSampleSlices = 16;
+// Nominal encode cost per input byte for :balanced, ordered like AutoCodec
+// and roughly in line with bench/benchmark.exs on typical payloads.
+static constexpr double kAutoNominalNsPerByte[kAutoCodecCount] = {
+    0.0, 1.0, 4.0, 8.0, 6.0};
+// Below this size no codec beats the envelope overhead.
+static constexpr size_t kAutoMinBytes = 64;
+
+struct AutoStats {
+  std::atomic<uint64_t> selected[kAutoCodecCount] = {};
+  std::atomic<uint64_t> bytes_in{0};
+  std::atomic<uint64_t> bytes_out{0};
+};
+
+static AutoStats &auto_stats() {
+  static AutoStats stats;
+  return stats;
+}
+
+// Compress `input` with `codec` into out (payload only, no tag).
+static std::optional<std::string>
+auto_encode(AutoCodec codec, CCtx &cctx, std::string_view input,
+            AutoObjective objective, size_t element_width, std::string &out) {
+  switch (codec) {
+  case AutoCodec::Raw:
+    out.assign(input.data(), input.size());
+    return std::nullopt;
+  case AutoCodec::Lz4:
+    return lz4_wrap(input, 1, out);
+  case AutoCodec::Zstd: {
+    int level = objective == AutoObjective::Ratio ? kAutoZstdLevelRatio
+                                                  : kAutoZstdLevelBalanced;
+    out.resize(ZSTD_compressBound(input.size()));
+    size_t n = ZSTD_compress(out.data(), out.size(), input.data(),
+                             input.size(), level);
+    if (ZSTD_isError(n)) {
+      return std::string("zstd: ") + ZSTD_getErrorName(n);
+    }
+    out.resize(n);
+    return std::nullopt;
+  }
+  case AutoCodec::OpenZL:
+    return compress_serial(cctx.ctx, input, out);
+  case AutoCodec::OpenZLNumeric: {
+    TypedRefPtr tref(ZL_TypedRef_createNumeric(
+        input.data(), element_width, input.size() / element_width));
+    if (!tref) {
+      return std::string("failed to create numeric typed ref");
+    }
+    size_t bound = ZL_compressBound(input.size());
+    out.resize(bound);
+    ZL_Report result =
+        ZL_CCtx_compressTypedRef(cctx.ctx, out.data(), bound, tref.get());
+    if (ZL_isError(result)) {
+      const char *err = ZL_CCtx_getErrorContextString(cctx.ctx, result);
+      return err ? std::string(err) : "typed numeric compression failed";
+    }
+    out.resize(ZL_validResult(result));
+    return std::nullopt;
+  }
+  }
+  return std::string("unknown codec");
+}
+
+// Evenly spaced slices of `input`, each aligned to `align` bytes.
+static std::string auto_sample(std::string_view input, size_t align) {
+  size_t slice = kAutoSampleBytes / kAutoSampleSlices;
+  size_t stride = input.size() / kAutoSampleSlices;
+  std::string sample;
+  sample.reserve(kAutoSampleBytes);
+  for (size_t i = 0; i < kAutoSampleSlices; i++) {
+    size_t offset = (i * stride) / align * align;
+    sample.append(input.data() + offset, std::min(slice, input.size() - offset));
+  }
+  return sample;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: compress_auto/4
+// (cctx, data, objective, element_width) where element_width 0 means the
+// data is not a numeric column.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_auto(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                  std::string_view input, uint64_t objective_code,
+                  uint64_t element_width) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+  if (objective_code > static_cast<uint64_t>(AutoObjective::Ratio)) {
+    return fine::Error(std::string("unknown objective"));
+  }
+  if (element_width != 0 && element_width != 1 && element_width != 2 &&
+      element_width != 4 && element_width != 8) {
+    return fine::Error(std::string("element_width must be 1, 2, 4, or 8"));
+  }
+  auto objective = static_cast<AutoObjective>(objective_code);
+  double weight = objective == AutoObjective::Ratio      ? 0.0
+                  : objective == AutoObjective::Balanced ? kAutoBalancedWeight
+                                                         : kAutoSpeedWeight;
+
+  std::vector<AutoCodec> candidates = {AutoCodec::Raw};
+  if (input.size() >= kAutoMinBytes) {
+    candidates.push_back(AutoCodec::Lz4);
+    if (objective != AutoObjective::Speed) {
+      candidates.push_back(AutoCodec::Zstd);
+      candidates.push_back(AutoCodec::OpenZL);
+      if (element_width != 0 && input.size() % element_width == 0) {
+        candidates.push_back(AutoCodec::OpenZLNumeric);
+      }
+    }
+  }
+
+  bool whole = input.size() <= kAutoSampleBytes;
+  std::string sample;
+  if (!whole) {
+    sample = auto_sample(input, element_width ? element_width : 1);
+  }
+  std::string_view probe = whole ? input : std::string_view(sample);
+
+  AutoCodec best = AutoCodec::Raw;
+  double best_cost = std::numeric_limits<double>::infinity();
+  std::string best_out, out;
+  for (AutoCodec codec : candidates) {
+    auto start = std::chrono::steady_clock::now();
+    if (auto_encode(codec, *cctx, probe, objective, element_width, out)) {
+      continue; // A codec that rejects the input is simply not chosen
+    }
+    double ns_per_byte =
+        objective == AutoObjective::Speed
+            ? std::chrono::duration<double, std::nano>(
+                  std::chrono::steady_clock::now() - start)
+                      .count() /
+                  probe.size()
+            : kAutoNominalNsPerByte[static_cast<size_t>(codec)];
+    double cost = static_cast<double>(out.size()) / probe.size() +
+                  weight * ns_per_byte;
+    if (cost < best_cost) {
+      best_cost = cost;
+      best = codec;
+      best_out.swap(out);
+    }
+  }
+
+  std::string output(1, static_cast<char>(best));
+  if (whole) {
+    output += best_out;
+  } else {
+    if (auto err =
+            auto_encode(best, *cctx, input, objective, element_width, out)) {
+      return fine::Error(std::move(*err));
+    }
+    output += out;
+  }
+
+  AutoStats &stats = auto_stats();
+  stats.selected[static_cast<size_t>(best)].fetch_add(
+      1, std::memory_order_relaxed);
+  stats.bytes_in.fetch_add(input.size(), std::memory_order_relaxed);
+  stats.bytes_out.fetch_add(output.size(), std::memory_order_relaxed);
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_auto, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_auto/2
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_decompress_auto(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                    std::string_view envelope) {
+  if (envelope.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+  std::string_view payload = envelope.substr(1);
+  std::string output;
+
+  switch (static_cast<AutoCodec>(envelope[0])) {
+  case AutoCodec::Raw:
+    output.assign(payload.data(), payload.size());
+    break;
+  case AutoCodec::Lz4:
+    if (!is_lz4_envelope(payload)) {
+      return fine::Error(std::string("corrupt LZ4 envelope"));
+    }
+    if (auto err = lz4_unwrap(payload, output)) {
+      return fine::Error(std::move(*err));
+    }
+    break;
+  case AutoCodec::Zstd: {
+    // The header's content size is untrusted; start from a capped guess
+    // and grow, up to the expansion limit, as the stream produces output
+    ZstdStream zstd;
+    if (!zstd.valid()) {
+      return fine::Error(std::string("failed to create zstd context"));
+    }
+    output.resize(zstd_initial_capacity(payload));
+    size_t fill = 0;
+    if (auto err = zstd.feed(payload, output, fill, ZstdCappedGrow(payload))) {
+      return fine::Error(std::move(*err));
+    }
+    if (!zstd.complete()) {
+      return fine::Error(std::string("zstd: truncated input"));
+    }
+    output.resize(fill);
+    break;
+  }
+  case AutoCodec::OpenZL:
+    if (auto err = decompress_serial(dctx->ctx, payload, output)) {
+      return fine::Error(std::move(*err));
+    }
+    break;
+  case AutoCodec::OpenZLNumeric: {
+    FrameInfoPtr fi(ZL_FrameInfo_create(payload.data(), payload.size()));
+    if (!fi) {
+      return fine::Error(std::string("failed to create frame info"));
+    }
+    ZL_Report size_report = ZL_FrameInfo_getDecompressedSize(fi.get(), 0);
+    ZL_Report elts_report = ZL_FrameInfo_getNumElts(fi.get(), 0);
+    if (ZL_isError(size_report) || ZL_isError(elts_report) ||
+        ZL_validResult(elts_report) == 0) {
+      return fine::Error(std::string("failed to read frame info"));
+    }
+    size_t byte_size = ZL_validResult(size_report);
+    size_t num_elts = ZL_validResult(elts_report);
+    output.resize(byte_size);
+    TypedBufferPtr tbuf(ZL_TypedBuffer_createWrapNumeric(
+        output.data(), byte_size / num_elts, num_elts));
+    if (!tbuf) {
+      return fine::Error(std::string("failed to create typed buffer"));
+    }
+    ZL_Report result = ZL_DCtx_decompressTBuffer(
+        dctx->ctx, tbuf.get(), payload.data(), payload.size());
+    if (ZL_isError(result)) {
+      return fine::Error(std::string("decompression failed"));
+    }
+    break;
+  }
+  default:
+    return fine::Error(std::string("unknown codec tag"));
+  }
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_decompress_auto, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: auto_stats/0
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_auto_stats(ErlNifEnv *env) {
+  AutoStats &stats = auto_stats();
+  ERL_NIF_TERM codec_keys[kAutoCodecCount], codec_vals[kAutoCodecCount];
+  for (size_t i = 0; i < kAutoCodecCount; i++) {
+    codec_keys[i] = fine::__private__::make_atom(env, kAutoCodecNames[i]);
+    codec_vals[i] =
+        enif_make_uint64(env, stats.selected[i].load(std::memory_order_relaxed));
+  }
+  ERL_NIF_TERM selected;
+  enif_make_map_from_arrays(env, codec_keys, codec_vals, kAutoCodecCount,
+                            &selected);
+
+  ERL_NIF_TERM keys[3], vals[3];
+  keys[0] = fine::__private__::make_atom(env, "selected");
+  vals[0] = selected;
+  keys[1] = fine::__private__::make_atom(env, "bytes_in");
+  vals[1] = enif_make_uint64(env, stats.bytes_in.load(std::memory_order_relaxed));
+  keys[2] = fine::__private__::make_atom(env, "bytes_out");
+  vals[2] =
+      enif_make_uint64(env, stats.bytes_out.load(std::memory_order_relaxed));
+  ERL_NIF_TERM map;
+  enif_make_map_from_arrays(env, keys, vals, 3, &map);
+  return fine::Term(map);
+}
+
+FINE_NIF(nif_auto_stats, 0);
+
+// ===================================================================
+// Phase 18: Deadline-Bounded Compression
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Fallback contexts, one set per scheduler thread: a level-1 generic
+// context and one whose graph stores the input as-is. Both produce
+// ordinary frames that decompress/1,2 read.
+// ---------------------------------------------------------------------------
+
+static constexpr int kDeadlineFastLevel = 1;
+// Assumed costs before a thread has measured its fallback contexts
+static constexpr double kDeadlineFastNsPerByte = 4.0;
+// Inputs larger than this with no cost history are timed on a prefix first
+static constexpr size_t kDeadlineProbeBytes = 64 * 1024;
+
+struct FallbackContexts {
+  ZL_CCtx *fast = nullptr;
+  ZL_CCtx *store = nullptr;
+  ZL_Compressor *store_compressor = nullptr;
+  double fast_ns_per_byte = 0.0;
+
+  ~FallbackContexts() {
+    if (fast)
+      ZL_CCtx_free(fast);
+    if (store)
+      ZL_CCtx_free(store);
+    if (store_compressor)
+      ZL_Compressor_free(store_compressor);
+  }
+
+  std::optional<std::string> init() {
+    if (!fast) {
+      fast = ZL_CCtx_create();
+      if (auto err = init_cctx(fast, nullptr)) {
+        return err;
+      }
+      (void)ZL_CCtx_setParameter(fast, ZL_CParam_compressionLevel,
+                                 kDeadlineFastLevel);
+    }
+    if (!store) {
+      if (!store_compressor) {
+        store_compressor = ZL_Compressor_create();
+        if (!store_compressor ||
+            ZL_isError(ZL_Compressor_selectStartingGraphID(store_compressor,
+                                                           ZL_GRAPH_STORE))) {
+          return std::string("failed to create store compressor");
+        }
+      }
+      ZL_CCtx *ctx = ZL_CCtx_create();
+      if (auto err = init_cctx(ctx, store_compressor)) {
+        if (ctx)
+          ZL_CCtx_free(ctx);
+        return err;
+      }
+      store = ctx;
+    }
+    return std::nullopt;
+  }
+};
+
+static FallbackContexts &fallback_contexts() {
+  thread_local FallbackContexts contexts;
+  return contexts;
+}
+
+enum class DeadlinePath { Primary, Fast, Stored };
+
+static constexpr const char *kDeadlinePathNames[] = {"primary", "fast",
+                                                     "stored"};
+
+// ---------------------------------------------------------------------------
+// NIF: compress_deadline/3
+// (cctx, data, deadline_us). Picks the context's own settings when its
+// cost history projects the call to finish in time, else a level-1
+// context, else a stored frame. Without history, inputs over
+// kDeadlineProbeBytes are timed on a prefix first and the probe time
+// counts against the deadline. Returns {compressed, path}.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string, fine::Atom>, fine::Error<std::string>>
+nif_compress_deadline(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                      std::string_view input, uint64_t deadline_us) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = start + std::chrono::microseconds(deadline_us);
+  auto fits = [&](double ns_per_byte) {
+    auto projected = std::chrono::nanoseconds(
+        static_cast<int64_t>(ns_per_byte * input.size()));
+    return std::chrono::steady_clock::now() + projected <= deadline;
+  };
+
+  FallbackContexts &fallback = fallback_contexts();
+  if (auto err = fallback.init()) {
+    return fine::Error(std::move(*err));
+  }
+
+  std::string output;
+  if (cctx->ns_per_byte == 0.0 && input.size() > kDeadlineProbeBytes) {
+    auto probe_start = std::chrono::steady_clock::now();
+    if (auto err = compress_serial(cctx->ctx,
+                                   input.substr(0, kDeadlineProbeBytes),
+                                   output)) {
+      return fine::Error(std::move(*err));
+    }
+    record_compress_cost(cctx->ns_per_byte,
+                         std::chrono::steady_clock::now() - probe_start,
+                         kDeadlineProbeBytes);
+  }
+
+  DeadlinePath path;
+  ZL_CCtx *ctx;
+  double *cost;
+  // No history means a small input: assume it fits rather than give up
+  // ratio on a guess.
+  if (cctx->ns_per_byte == 0.0 || fits(cctx->ns_per_byte)) {
+    path = DeadlinePath::Primary;
+    ctx = cctx->ctx;
+    cost = &cctx->ns_per_byte;
+  } else if (fits(fallback.fast_ns_per_byte != 0.0 ? fallback.fast_ns_per_byte
+                                                   : kDeadlineFastNsPerByte)) {
+    path = DeadlinePath::Fast;
+    ctx = fallback.fast;
+    cost = &fallback.fast_ns_per_byte;
+  } else {
+    path = DeadlinePath::Stored;
+    ctx = fallback.store;
+    cost = nullptr;
+  }
+
+  auto compress_start = std::chrono::steady_clock::now();
+  if (auto err = compress_serial(ctx, input, output)) {
+    return fine::Error(std::move(*err));
+  }
+  if (cost) {
+    record_compress_cost(*cost, std::chrono::steady_clock::now() - compress_start,
+                         input.size());
+  }
+
+  return fine::Ok(std::move(output),
+                  fine::Atom(kDeadlinePathNames[static_cast<int>(path)]));
+}
+
+FINE_NIF(nif_compress_deadline, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 19: Recompaction
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: per-thread CPU clock for reporting work done on worker threads
+// ---------------------------------------------------------------------------
+
+static uint64_t thread_cpu_ns() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL +
+         static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// TypedRef over one column of the given type, or null on failure.
+static ZL_TypedRef *make_typed_ref(ZL_Type type, const void *data,
+                                   size_t byte_size, size_t elt_width,
+                                   size_t num_elts, const uint32_t *lens) {
+  switch (type) {
+  case ZL_Type_serial:
+    return ZL_TypedRef_createSerial(data, byte_size);
+  case ZL_Type_struct:
+    return ZL_TypedRef_createStruct(data, elt_width, num_elts);
+  case ZL_Type_numeric:
+    return ZL_TypedRef_createNumeric(data, elt_width, num_elts);
+  case ZL_Type_string:
+    return ZL_TypedRef_createString(data, byte_size, lens, num_elts);
+  default:
+    return nullptr;
+  }
+}
+
+// Compress one or more typed refs into a single frame. `total` is the
+// input size used to bound the output.
+static std::optional<std::string>
+compress_typed_refs(ZL_CCtx *ctx, std::vector<const ZL_TypedRef *> &refs,
+                    size_t total, std::string &out) {
+  std::optional<size_t> bound = multi_typed_compress_bound(total, refs.size());
+  if (!bound.has_value()) {
+    return std::string("compressed output size bound overflow");
+  }
+  out.resize(*bound);
+  ZL_Report result =
+      refs.size() == 1
+          ? ZL_CCtx_compressTypedRef(ctx, out.data(), out.size(), refs[0])
+          : ZL_CCtx_compressMultiTypedRef(ctx, out.data(), out.size(),
+                                          refs.data(), refs.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(ctx, result);
+    return err ? std::string(err) : "typed compression failed";
+  }
+  out.resize(ZL_validResult(result));
+  return std::nullopt;
+}
+
+// Re-encode every output of a decoded frame, keeping its types.
+static std::optional<std::string>
+compress_tbuffers(ZL_CCtx *ctx, const std::vector<TypedBufferPtr> &bufs,
+                  std::string &out) {
+  std::vector<TypedRefPtr> refs;
+  std::vector<const ZL_TypedRef *> ref_ptrs;
+  size_t total = 0;
+  for (const TypedBufferPtr &buf : bufs) {
+    ZL_Type type = ZL_TypedBuffer_type(buf.get());
+    size_t num_elts = ZL_TypedBuffer_numElts(buf.get());
+    size_t byte_size = ZL_TypedBuffer_byteSize(buf.get());
+    ZL_TypedRef *ref = make_typed_ref(
+        type, ZL_TypedBuffer_rPtr(buf.get()), byte_size,
+        ZL_TypedBuffer_eltWidth(buf.get()), num_elts,
+        type == ZL_Type_string ? ZL_TypedBuffer_rStringLens(buf.get())
+                               : nullptr);
+    if (!ref) {
+      return std::string("failed to create typed ref");
+    }
+    refs.emplace_back(ref);
+    ref_ptrs.push_back(ref);
+    total += byte_size +
+             (type == ZL_Type_string ? num_elts * sizeof(uint32_t) : 0);
+  }
+  return compress_typed_refs(ctx, ref_ptrs, total, out);
+}
+
+// ---------------------------------------------------------------------------
+// NIF: recompact/3
+// Decode each frame and re-encode it with the target context's compressor
+// and level: (frames, target_cctx, threads). Frames are spread over up to
+// `threads` native threads, each with its own contexts configured like the
+// target; the target itself is only read. A frame whose re-encoding is not
+// smaller is returned unchanged. Returns {frames, stats}.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::vector<std::string>, fine::Term>,
+                    fine::Error<std::string>>
+nif_recompact(ErlNifEnv *env, std::vector<std::string_view> frames,
+              fine::ResourcePtr<CCtx> target, uint64_t threads) {
+  if (frames.empty()) {
+    return fine::Error(std::string("frames must not be empty"));
+  }
+
+  // Compressors are immutable once built, so every worker context can
+  // reference the target's. The local resource keeps an attached one alive
+  // even if set_compressor replaces it on the target mid-call.
+  std::optional<fine::ResourcePtr<Compressor>> compressor_ref =
+      target->compressor_ref;
+  ZL_Compressor *compressor = compressor_ref.has_value()
+                                  ? (*compressor_ref)->compressor
+                                  : target->default_compressor;
+  int level = target->level;
+
+  size_t n = frames.size();
+  size_t workers = static_cast<size_t>(std::max<uint64_t>(threads, 1));
+  workers = std::min(workers, n);
+
+  std::vector<std::string> results(n);
+  std::vector<std::optional<std::string>> errors(n);
+  std::atomic<size_t> next{0};
+  std::atomic<uint64_t> cpu_ns{0};
+  std::atomic<uint64_t> kept{0};
+
+  auto work = [&]() {
+    uint64_t cpu_start = thread_cpu_ns();
+    CCtx cctx;
+    DCtx dctx;
+    std::optional<std::string> setup = init_cctx(cctx.ctx, compressor);
+    if (!setup && !dctx.ctx) {
+      setup = std::string("failed to create decompression context");
+    }
+    if (!setup && level != 0) {
+      (void)ZL_CCtx_setParameter(cctx.ctx, ZL_CParam_compressionLevel, level);
+    }
+
+    std::vector<TypedBufferPtr> bufs;
+    for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+      if (setup) {
+        errors[i] = setup;
+        continue;
+      }
+      // Workers are plain threads, so nothing may escape this loop
+      try {
+        std::string_view frame = frames[i];
+        std::optional<std::string> err =
+            decompress_to_tbuffers(dctx.ctx, frame, bufs);
+        if (!err) {
+          err = compress_tbuffers(cctx.ctx, bufs, results[i]);
+        }
+        if (err) {
+          errors[i] = std::move(err);
+          continue;
+        }
+        if (results[i].size() >= frame.size()) {
+          results[i].assign(frame.data(), frame.size());
+          kept.fetch_add(1, std::memory_order_relaxed);
+        }
+      } catch (const std::exception &e) {
+        bufs.clear();
+        results[i].clear();
+        errors[i] = std::string(e.what());
+      }
+    }
+    cpu_ns.fetch_add(thread_cpu_ns() - cpu_start, std::memory_order_relaxed);
+  };
+
+  auto wall_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < workers; t++) {
+    try {
+      pool.emplace_back(work);
+    } catch (const std::system_error &) {
+      // Out of threads: the ones already running pick up the rest
+      break;
+    }
+  }
+  work();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  auto wall = std::chrono::steady_clock::now() - wall_start;
+
+  uint64_t bytes_in = 0, bytes_out = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (errors[i]) {
+      return fine::Error("frame " + std::to_string(i) + ": " + *errors[i]);
+    }
+    bytes_in += frames[i].size();
+    bytes_out += results[i].size();
+  }
+
+  const std::pair<const char *, uint64_t> fields[] = {
+      {"frames", n},
+      {"kept", kept.load()},
+      {"bytes_in", bytes_in},
+      {"bytes_out", bytes_out},
+      {"bytes_saved", bytes_in - bytes_out},
+      {"cpu_us", cpu_ns.load() / 1000},
+      {"wall_us", static_cast<uint64_t>(
+                      std::chrono::duration_cast<std::chrono::microseconds>(
+                          wall)
+                          .count())},
+      {"threads", workers},
+  };
+  constexpr size_t nf = sizeof(fields) / sizeof(fields[0]);
+  ERL_NIF_TERM keys[nf], vals[nf];
+  for (size_t i = 0; i < nf; i++) {
+    keys[i] = fine::__private__::make_atom(env, fields[i].first);
+    vals[i] = enif_make_uint64(env, fields[i].second);
+  }
+  ERL_NIF_TERM stats;
+  enif_make_map_from_arrays(env, keys, vals, nf, &stats);
+
+  return fine::Ok(std::move(results), fine::Term(stats));
+}
+
+FINE_NIF(nif_recompact, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 20: Frame Merging
+// ===================================================================
+
+// One output column accumulated across merged frames.
+struct MergedColumn {
+  ZL_Type type = ZL_Type_serial;
+  size_t elt_width = 1;
+  size_t num_elts = 0;
+  std::string data;
+  std::vector<uint32_t> lens;
+};
+
+// ---------------------------------------------------------------------------
+// NIF: merge_multi_typed/3
+// Merge frames with identical output layouts into one frame: (dctx, cctx,
+// frames). Each frame is decoded natively and every output is appended to
+// the matching column; the columns are then re-encoded together through
+// cctx. Outputs must agree in count, type and element width.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_merge_multi_typed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                      fine::ResourcePtr<CCtx> cctx,
+                      std::vector<std::string_view> frames) {
+  if (frames.empty()) {
+    return fine::Error(std::string("frames must not be empty"));
+  }
+
+  std::vector<MergedColumn> columns;
+  std::vector<TypedBufferPtr> bufs;
+  for (size_t f = 0; f < frames.size(); f++) {
+    if (auto err = decompress_to_tbuffers(dctx->ctx, frames[f], bufs)) {
+      return fine::Error("frame " + std::to_string(f) + ": " + *err);
+    }
+    if (f == 0) {
+      columns.resize(bufs.size());
+      for (size_t c = 0; c < bufs.size(); c++) {
+        columns[c].type = ZL_TypedBuffer_type(bufs[c].get());
+        columns[c].elt_width = ZL_TypedBuffer_eltWidth(bufs[c].get());
+      }
+    } else if (bufs.size() != columns.size()) {
+      return fine::Error("frame " + std::to_string(f) + " has " +
+                         std::to_string(bufs.size()) + " outputs, expected " +
+                         std::to_string(columns.size()));
+    }
+
+    for (size_t c = 0; c < columns.size(); c++) {
+      MergedColumn &col = columns[c];
+      ZL_TypedBuffer *buf = bufs[c].get();
+      ZL_Type type = ZL_TypedBuffer_type(buf);
+      bool fixed = type == ZL_Type_numeric || type == ZL_Type_struct;
+      if (type != col.type ||
+          (fixed && ZL_TypedBuffer_eltWidth(buf) != col.elt_width)) {
+        return fine::Error("frame " + std::to_string(f) + " output " +
+                           std::to_string(c) +
+                           " does not match the first frame's layout");
+      }
+      size_t num_elts = ZL_TypedBuffer_numElts(buf);
+      col.data.append(static_cast<const char *>(ZL_TypedBuffer_rPtr(buf)),
+                      ZL_TypedBuffer_byteSize(buf));
+      if (type == ZL_Type_string) {
+        const uint32_t *lens = ZL_TypedBuffer_rStringLens(buf);
+        col.lens.insert(col.lens.end(), lens, lens + num_elts);
+      }
+      col.num_elts += num_elts;
+    }
+  }
+
+  std::vector<TypedRefPtr> refs;
+  std::vector<const ZL_TypedRef *> ref_ptrs;
+  size_t total = 0;
+  for (const MergedColumn &col : columns) {
+    ZL_TypedRef *ref =
+        make_typed_ref(col.type, col.data.data(), col.data.size(),
+                       col.elt_width, col.num_elts, col.lens.data());
+    if (!ref) {
+      return fine::Error(std::string("failed to create typed ref"));
+    }
+    refs.emplace_back(ref);
+    ref_ptrs.push_back(ref);
+    total += col.data.size() + col.lens.size() * sizeof(uint32_t);
+  }
+
+  std::string output;
+  if (auto err = compress_typed_refs(cctx->ctx, ref_ptrs, total, output)) {
+    return fine::Error(std::move(*err));
+  }
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_merge_multi_typed, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 21: Chunked Frames
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// NIF: compress_chunked/3 - Compress as independently decodable chunks
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string>, fine::Error<std::string>>
+nif_compress_chunked(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                     std::string_view input, uint64_t chunk_size) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+  if (chunk_size == 0 || chunk_size > UINT32_MAX) {
+    return fine::Error(std::string("chunk_size must be between 1 and 2^32-1"));
+  }
+
+  uint64_t count = input.size() / chunk_size + (input.size() % chunk_size != 0);
+  if (count > UINT32_MAX) {
+    return fine::Error(std::string("too many chunks"));
+  }
+
+  std::string output;
+  output.reserve(kChunkedHeaderSize + count * 4 +
+                 ZL_compressBound(input.size()));
+  output.append(kChunkedMagic, sizeof(kChunkedMagic));
+  put_le32(output, static_cast<uint32_t>(chunk_size));
+  put_le64(output, input.size());
+  put_le32(output, static_cast<uint32_t>(count));
+  output.resize(kChunkedHeaderSize + count * 4);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; i++) {
+    std::string_view chunk = input.substr(i * chunk_size, chunk_size);
+    size_t offset = output.size();
+    size_t bound = ZL_compressBound(chunk.size());
+    output.resize(offset + bound);
+    ZL_Report result = ZL_CCtx_compress(cctx->ctx, output.data() + offset,
+                                         bound, chunk.data(), chunk.size());
+    if (ZL_isError(result)) {
+      const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
+      return fine::Error(err ? std::string(err) : "compression failed");
+    }
+    size_t size = ZL_validResult(result);
+    output.resize(offset + size);
+
+    unsigned char *slot = reinterpret_cast<unsigned char *>(output.data()) +
+                          kChunkedHeaderSize + i * 4;
+    for (int b = 0; b < 4; b++) {
+      slot[b] = static_cast<unsigned char>(size >> (8 * b));
+    }
+  }
+  record_compress_cost(cctx->ns_per_byte,
+                       std::chrono::steady_clock::now() - start, input.size());
+
+  return fine::Ok(std::move(output));
+}
+
+FINE_NIF(nif_compress_chunked, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_prefix/4 - Decode at most max_bytes starting at from
+// ---------------------------------------------------------------------------
+//
+// Returns {:ok, bytes, next} where next is the raw offset to resume from, or
+// :eof once the end of the data is reached. Chunked containers decode only
+// the chunks overlapping [from, from + max_bytes); any other frame is
+// decoded whole and sliced, since OpenZL frames cannot stop early.
+
+static std::variant<fine::Ok<std::string, fine::Term>,
+                    fine::Error<std::string>>
+nif_decompress_prefix(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                      std::string_view compressed, uint64_t max_bytes,
+                      uint64_t from) {
+  if (max_bytes == 0) {
+    return fine::Error(std::string("max_bytes must be positive"));
+  }
+
+  std::string decoded;
+  uint64_t raw_size;
+  uint64_t base = 0;
+  if (is_chunked_container(compressed)) {
+    ChunkedIndex index;
+    if (auto err = parse_chunked(compressed, index)) {
+      return fine::Error(std::move(*err));
+    }
+    raw_size = index.raw_size;
+    if (from < raw_size) {
+      uint64_t end = raw_size - from > max_bytes ? from + max_bytes : raw_size;
+      size_t first = from / index.chunk_size;
+      size_t last = (end - 1) / index.chunk_size;
+      base = first * index.chunk_size;
+      decoded.reserve(end - base);
+      for (size_t i = first; i <= last; i++) {
+        if (auto err = decode_chunk(dctx->ctx, index, i, decoded)) {
+          return fine::Error(std::move(*err));
+        }
+      }
+    }
+  } else if (is_lz4_envelope(compressed)) {
+    if (auto err = lz4_unwrap(compressed, decoded)) {
+      return fine::Error(std::move(*err));
+    }
+    raw_size = decoded.size();
+  } else {
+    ZL_Report size =
+        ZL_getDecompressedSize(compressed.data(), compressed.size());
+    if (ZL_isError(size)) {
+      return fine::Error(
+          std::string("failed to read decompressed size from frame"));
+    }
+    decoded.resize(ZL_validResult(size));
+    ZL_Report result =
+        ZL_DCtx_decompress(dctx->ctx, decoded.data(), decoded.size(),
+                            compressed.data(), compressed.size());
+    if (ZL_isError(result)) {
+      return fine::Error(std::string("decompression failed"));
+    }
+    decoded.resize(ZL_validResult(result));
+    raw_size = decoded.size();
+  }
+
+  if (from > raw_size) {
+    return fine::Error(std::string("offset is past the end of the data"));
+  }
+  uint64_t take = std::min<uint64_t>(max_bytes, raw_size - from);
+  std::string prefix = take ? decoded.substr(from - base, take) : "";
+  fine::Term next =
+      from + take < raw_size
+          ? fine::Term(enif_make_uint64(env, from + take))
+          : fine::Term(fine::__private__::make_atom(env, "eof"));
+  return fine::Ok(std::move(prefix), next);
+}
+
+FINE_NIF(nif_decompress_prefix, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 22: Integrity Verification
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Helper: verifier
+// Per-thread decompression context with content and compressed checksum
+// checks enabled, plus scratch space that full decodes are written to and
+// thrown away. Verification never builds binaries; the scratch is reused
+// across calls on a thread, except past the staging retain cap.
+// ---------------------------------------------------------------------------
+
+struct Verifier {
+  ZL_DCtx *dctx = nullptr;
+  std::vector<unsigned char> scratch;
+  std::vector<uint32_t> lens;
+  std::string bytes;
+  std::vector<TypedBufferPtr> outputs;
+  uint64_t frames = 0;
+
+  ~Verifier() {
+    if (dctx)
+      ZL_DCtx_free(dctx);
+  }
+
+  // Drops scratch grown past the staging retain cap, once a call is done
+  void release() {
+    staging_release(scratch);
+    staging_release(lens);
+    staging_release(bytes);
+  }
+
+  std::optional<std::string> init() {
+    if (!dctx) {
+      ZL_DCtx *ctx = ZL_DCtx_create();
+      if (!ctx ||
+          ZL_isError(ZL_DCtx_setParameter(ctx,
+                                          ZL_DParam_checkCompressedChecksum,
+                                          ZL_TernaryParam_enable)) ||
+          ZL_isError(ZL_DCtx_setParameter(ctx, ZL_DParam_checkContentChecksum,
+                                          ZL_TernaryParam_enable))) {
+        if (ctx)
+          ZL_DCtx_free(ctx);
+        return std::string("failed to create decompression context");
+      }
+      dctx = ctx;
+    }
+    return std::nullopt;
+  }
+};
+
+static Verifier &thread_verifier() {
+  thread_local Verifier verifier;
+  return verifier;
+}
+
+// Decoded sizes come from headers that may be corrupt, so a full check
+// refuses frames claiming more than this expansion over their own size
+// (above a floor that covers small, highly repetitive frames).
+static constexpr uint64_t kVerifyMaxExpansion = 1024;
+static constexpr uint64_t kVerifyExpansionFloor = 64 * 1024 * 1024;
+
+// Checks an OpenZL frame's header and, with full, decodes every output into
+// the verifier's scratch, which also validates any checksums it carries.
+static std::optional<std::string> verify_frame(Verifier &v,
+                                               std::string_view frame,
+                                               bool full) {
+  FrameInfoPtr fi(ZL_FrameInfo_create(frame.data(), frame.size()));
+  if (!fi) {
+    return std::string("not an OpenZL frame");
+  }
+  ZL_Report num_report = ZL_FrameInfo_getNumOutputs(fi.get());
+  if (ZL_isError(num_report)) {
+    return std::string("corrupt frame header");
+  }
+  size_t n = ZL_validResult(num_report);
+
+  struct Output {
+    ZL_Type type;
+    size_t size;
+    size_t num_elts;
+    size_t offset;
+  };
+  std::vector<Output> layout(n);
+  size_t total = 0, total_elts = 0;
+  for (size_t i = 0; i < n; i++) {
+    ZL_Report type_report = ZL_FrameInfo_getOutputType(fi.get(), (int)i);
+    ZL_Report size_report = ZL_FrameInfo_getDecompressedSize(fi.get(), (int)i);
+    ZL_Report elts_report = ZL_FrameInfo_getNumElts(fi.get(), (int)i);
+    if (ZL_isError(type_report) || ZL_isError(size_report) ||
+        ZL_isError(elts_report)) {
+      return "corrupt header for output " + std::to_string(i);
+    }
+    Output &out = layout[i];
+    out.type = (ZL_Type)ZL_validResult(type_report);
+    out.size = ZL_validResult(size_report);
+    out.num_elts = ZL_validResult(elts_report);
+    out.offset = total;
+    if ((out.type == ZL_Type_numeric || out.type == ZL_Type_struct) &&
+        out.num_elts != 0 && out.size % out.num_elts != 0) {
+      return "inconsistent sizes for output " + std::to_string(i);
+    }
+    // Keep each output 8-byte aligned for numeric views
+    total += (out.size + 7) & ~size_t(7);
+    if (out.type == ZL_Type_string) {
+      total_elts += out.num_elts;
+    }
+  }
+  v.frames++;
+  if (!full) {
+    return std::nullopt;
+  }
+  if (total > std::max<uint64_t>(kVerifyExpansionFloor,
+                                 frame.size() * kVerifyMaxExpansion)) {
+    return std::string("decoded size implausible for frame size");
+  }
+
+  if (v.scratch.size() < total) {
+    v.scratch.resize(total);
+  }
+  if (v.lens.size() < total_elts) {
+    v.lens.resize(total_elts);
+  }
+  v.outputs.clear();
+  std::vector<ZL_TypedBuffer *> ptrs;
+  size_t lens_offset = 0;
+  for (const Output &out : layout) {
+    unsigned char *dst = v.scratch.data() + out.offset;
+    ZL_TypedBuffer *buf = nullptr;
+    switch (out.type) {
+    case ZL_Type_serial:
+      buf = ZL_TypedBuffer_createWrapSerial(dst, out.size);
+      break;
+    case ZL_Type_numeric:
+    case ZL_Type_struct: {
+      size_t width = out.num_elts ? out.size / out.num_elts : 1;
+      buf = out.type == ZL_Type_numeric
+                ? ZL_TypedBuffer_createWrapNumeric(dst, width, out.num_elts)
+                : ZL_TypedBuffer_createWrapStruct(dst, width, out.num_elts);
+      break;
+    }
+    case ZL_Type_string:
+      buf = ZL_TypedBuffer_createWrapString(
+          dst, out.size, v.lens.data() + lens_offset, out.num_elts);
+      lens_offset += out.num_elts;
+      break;
+    default:
+      return std::string("unsupported output type");
+    }
+    if (!buf) {
+      return std::string("failed to create typed buffer");
+    }
+    v.outputs.emplace_back(buf);
+    ptrs.push_back(buf);
+  }
+
+  ZL_Report result = ZL_DCtx_decompressMultiTBuffer(
+      v.dctx, ptrs.data(), ptrs.size(), frame.data(), frame.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_DCtx_getErrorContextString(v.dctx, result);
+    return err ? std::string(err) : "decompression failed";
+  }
+  return std::nullopt;
+}
+
+// Verifies anything decompress/2 accepts: OpenZL frames, LZ4 envelopes and
+// chunked containers.
+static std::optional<std::string> verify_payload(Verifier &v,
+                                                 std::string_view data,
+                                                 bool full) {
+  if (data.empty()) {
+    return std::string("input must not be empty");
+  }
+  if (is_lz4_envelope(data)) {
+    if (get_le32(data.data() + 4) > LZ4_MAX_INPUT_SIZE) {
+      return std::string("corrupt LZ4 envelope");
+    }
+    v.frames++;
+    return full ? lz4_unwrap(data, v.bytes) : std::nullopt;
+  }
+  if (is_chunked_container(data)) {
+    ChunkedIndex index;
+    if (auto err = parse_chunked(data, index)) {
+      return err;
+    }
+    for (size_t i = 0; i < index.frames.size(); i++) {
+      if (auto err = verify_frame(v, index.frames[i], false)) {
+        return "chunk " + std::to_string(i) + ": " + *err;
+      }
+      uint64_t expected;
+      if (auto err = check_chunk_size(index, i, expected)) {
+        return err;
+      }
+      if (full) {
+        v.bytes.clear();
+        if (auto err = decode_chunk(v.dctx, index, i, v.bytes)) {
+          return err;
+        }
+      }
+    }
+    return std::nullopt;
+  }
+  return verify_frame(v, data, full);
+}
+
+// ---------------------------------------------------------------------------
+// NIF: verify/2
+// Check one payload: (data, full). Without full only headers and chunk
+// indexes are checked.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_verify(ErlNifEnv *env, std::string_view data, bool full) {
+  Verifier &v = thread_verifier();
+  if (auto err = v.init()) {
+    return fine::Error(std::move(*err));
+  }
+  std::optional<std::string> err = verify_payload(v, data, full);
+  v.release();
+  if (err) {
+    return fine::Error(std::move(*err));
+  }
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_verify, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// Helper: scrub read throttle
+// Shared by all scrub workers. Byte k of the run may be read no earlier
+// than k / rate seconds after the start, which caps the aggregate rate
+// without any coordination beyond one counter.
+// ---------------------------------------------------------------------------
+
+static constexpr size_t kScrubReadSlice = 1 << 20;
+
+class ScrubThrottle {
+public:
+  explicit ScrubThrottle(uint64_t bytes_per_sec)
+      : rate(bytes_per_sec), start(std::chrono::steady_clock::now()) {}
+
+  void acquire(uint64_t bytes) {
+    if (rate == 0) {
+      return;
+    }
+    uint64_t granted = reserved.fetch_add(bytes) + bytes;
+    auto due = start + std::chrono::nanoseconds(static_cast<int64_t>(
+                           static_cast<double>(granted) * 1e9 / rate));
+    std::this_thread::sleep_until(due);
+  }
+
+private:
+  uint64_t rate;
+  std::chrono::steady_clock::time_point start;
+  std::atomic<uint64_t> reserved{0};
+};
+
+static bool scrub_read(int fd, std::string &buf, size_t size, uint64_t offset,
+                       ScrubThrottle &throttle) {
+  buf.resize(size);
+  for (size_t done = 0; done < size;) {
+    size_t slice = std::min(kScrubReadSlice, size - done);
+    throttle.acquire(slice);
+    if (!pread_all(fd, buf.data() + done, slice, offset + done)) {
+      return false;
+    }
+    done += slice;
+  }
+  return true;
+}
+
+// Files scrub_file must read whole (a single frame or LZ4 envelope) are
+// refused above this size rather than buffered
+static constexpr uint64_t kScrubMaxPayload = 1ULL << 30;
+
+// Verifies one archive file. Append logs, columnar files and chunked
+// containers are read and checked one frame at a time; any other file must
+// hold a single payload of at most kScrubMaxPayload bytes.
+static std::optional<std::string> scrub_file(Verifier &v, const char *path,
+                                             bool full,
+                                             ScrubThrottle &throttle,
+                                             uint64_t &bytes_read) {
+  int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::string("open failed: ") + std::strerror(errno);
+  }
+  struct Closer {
+    int fd;
+    ~Closer() { ::close(fd); }
+  } closer{fd};
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    return std::string("stat failed");
+  }
+  uint64_t file_size = static_cast<uint64_t>(st.st_size);
+  std::string frame;
+
+  char magic[4] = {0, 0, 0, 0};
+  if (file_size >= sizeof(magic) && !pread_all(fd, magic, sizeof(magic), 0)) {
+    return std::string("read failed");
+  }
+
+  if (std::memcmp(magic, kLogMagic, sizeof(magic)) == 0) {
+    std::vector<LogBlock> index;
+    uint64_t end_offset;
+    if (auto err = log_load_index(fd, index, end_offset)) {
+      return err;
+    }
+    for (size_t i = 0; i < index.size(); i++) {
+      if (!scrub_read(fd, frame, index[i].frame_size, index[i].frame_offset,
+                      throttle)) {
+        return "read failed in block " + std::to_string(i);
+      }
+      bytes_read += frame.size();
+      if (auto err = verify_frame(v, frame, full)) {
+        return "block " + std::to_string(i) + ": " + *err;
+      }
+    }
+    return std::nullopt;
+  }
+
+  if (std::memcmp(magic, kColumnarMagic, sizeof(magic)) == 0 &&
+      file_size >= kColumnarHeaderSize + kColumnarTrailerSize) {
+    char trailer[kColumnarTrailerSize];
+    if (!pread_all(fd, trailer, sizeof(trailer),
+                   file_size - kColumnarTrailerSize)) {
+      return std::string("read failed");
+    }
+    uint64_t footer_size = get_le64(trailer);
+    if (std::memcmp(trailer + 8, kColumnarMagic, sizeof(kColumnarMagic)) != 0 ||
+        footer_size >
+            file_size - kColumnarHeaderSize - kColumnarTrailerSize) {
+      return std::string("columnar footer is corrupt");
+    }
+    uint64_t data_end = file_size - kColumnarTrailerSize - footer_size;
+    std::string footer;
+    if (!scrub_read(fd, footer, footer_size, data_end, throttle)) {
+      return std::string("read failed");
+    }
+    bytes_read += footer.size();
+    std::vector<ColumnSpec> schema;
+    std::vector<RowGroupMeta> row_groups;
+    if (!columnar_parse_footer(
+            reinterpret_cast<const unsigned char *>(footer.data()),
+            footer_size, data_end, schema, row_groups)) {
+      return std::string("columnar footer is corrupt");
+    }
+    for (size_t g = 0; g < row_groups.size(); g++) {
+      for (size_t c = 0; c < row_groups[g].chunks.size(); c++) {
+        const ColumnChunk &chunk = row_groups[g].chunks[c];
+        if (!scrub_read(fd, frame, chunk.size, chunk.offset, throttle)) {
+          return std::string("read failed");
+        }
+        bytes_read += frame.size();
+        if (auto err = verify_frame(v, frame, full)) {
+          return "row group " + std::to_string(g) + " column " +
+                 schema[c].name + ": " + *err;
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  if (std::memcmp(magic, kChunkedMagic, sizeof(magic)) == 0 &&
+      file_size >= kChunkedHeaderSize) {
+    std::string header;
+    if (!scrub_read(fd, header, kChunkedHeaderSize, 0, throttle)) {
+      return std::string("read failed");
+    }
+    uint32_t chunk_size = get_le32(header.data() + 4);
+    uint64_t raw_size = get_le64(header.data() + 8);
+    uint32_t count = get_le32(header.data() + 16);
+    if (chunk_size == 0 ||
+        count != raw_size / chunk_size + (raw_size % chunk_size != 0) ||
+        count > (file_size - kChunkedHeaderSize) / 4) {
+      return std::string("corrupt chunked container header");
+    }
+    std::string sizes;
+    if (!scrub_read(fd, sizes, static_cast<size_t>(count) * 4,
+                    kChunkedHeaderSize, throttle)) {
+      return std::string("read failed");
+    }
+    bytes_read += header.size() + sizes.size();
+
+    uint64_t offset = kChunkedHeaderSize + static_cast<uint64_t>(count) * 4;
+    for (uint32_t i = 0; i < count; i++) {
+      uint32_t size = get_le32(sizes.data() + i * 4);
+      if (size > file_size - offset) {
+        return std::string("truncated chunked container");
+      }
+      if (!scrub_read(fd, frame, size, offset, throttle)) {
+        return "read failed in chunk " + std::to_string(i);
+      }
+      bytes_read += frame.size();
+      offset += size;
+
+      uint64_t expected =
+          i + 1 == count ? raw_size - uint64_t(i) * chunk_size : chunk_size;
+      ZL_Report declared = ZL_getDecompressedSize(frame.data(), frame.size());
+      if (ZL_isError(declared) || ZL_validResult(declared) != expected) {
+        return "chunk " + std::to_string(i) + " does not match the header";
+      }
+      if (auto err = verify_frame(v, frame, full)) {
+        return "chunk " + std::to_string(i) + ": " + *err;
+      }
+    }
+    if (offset != file_size) {
+      return std::string("trailing bytes after chunked container");
+    }
+    return std::nullopt;
+  }
+
+  if (file_size > kScrubMaxPayload) {
+    return "single payload larger than " + std::to_string(kScrubMaxPayload) +
+           " bytes; not verified";
+  }
+  if (!scrub_read(fd, frame, file_size, 0, throttle)) {
+    return std::string("read failed");
+  }
+  bytes_read += frame.size();
+  return verify_payload(v, frame, full);
+}
+
+// Collects regular files below dir, without following symlinks.
+static void scrub_collect(const std::string &dir,
+                          std::vector<std::string> &files) {
+  DIR *d = ::opendir(dir.c_str());
+  if (!d) {
+    return;
+  }
+  while (struct dirent *entry = ::readdir(d)) {
+    if (std::strcmp(entry->d_name, ".") == 0 ||
+        std::strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    std::string path = dir + "/" + entry->d_name;
+    struct stat st;
+    if (::lstat(path.c_str(), &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      scrub_collect(path, files);
+    } else if (S_ISREG(st.st_mode)) {
+      files.push_back(std::move(path));
+    }
+  }
+  ::closedir(d);
+}
+
+// ---------------------------------------------------------------------------
+// NIF: scrub_dir/4
+// Verify every file below a directory: (path, full, threads,
+// max_bytes_per_sec). Files are spread over native threads, each with its
+// own verifier; reads share one throttle (0 means unthrottled). Returns
+// {:ok, stats, [{path, reason}]} with one entry per failed file.
+// ---------------------------------------------------------------------------
+
+static std::variant<
+    fine::Ok<fine::Term, std::vector<std::tuple<std::string, std::string>>>,
+    fine::Error<std::string>>
+nif_scrub_dir(ErlNifEnv *env, std::string path, bool full, uint64_t threads,
+              uint64_t max_bytes_per_sec) {
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+    return fine::Error("not a directory: " + path);
+  }
+
+  std::vector<std::string> files;
+  scrub_collect(path, files);
+  std::sort(files.begin(), files.end());
+
+  size_t n = files.size();
+  size_t workers = static_cast<size_t>(std::max<uint64_t>(threads, 1));
+  workers = std::max<size_t>(std::min(workers, n), 1);
+
+  ScrubThrottle throttle(max_bytes_per_sec);
+  std::vector<std::optional<std::string>> errors(n);
+  std::atomic<size_t> next{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> frames{0};
+
+  auto work = [&]() {
+    Verifier &v = thread_verifier();
+    std::optional<std::string> setup = v.init();
+    uint64_t frames_start = v.frames;
+    uint64_t bytes_read = 0;
+    for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+      // Workers are plain threads, so nothing may escape this loop
+      try {
+        errors[i] = setup ? setup
+                          : scrub_file(v, files[i].c_str(), full, throttle,
+                                       bytes_read);
+      } catch (const std::exception &e) {
+        errors[i] = std::string(e.what());
+      }
+      v.release();
+    }
+    bytes.fetch_add(bytes_read, std::memory_order_relaxed);
+    frames.fetch_add(v.frames - frames_start, std::memory_order_relaxed);
+  };
+
+  auto wall_start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < workers; t++) {
+    try {
+      pool.emplace_back(work);
+    } catch (const std::system_error &) {
+      break;
+    }
+  }
+  work();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+  auto wall = std::chrono::steady_clock::now() - wall_start;
+
+  std::vector<std::tuple<std::string, std::string>> failures;
+  for (size_t i = 0; i < n; i++) {
+    if (errors[i]) {
+      failures.emplace_back(files[i], std::move(*errors[i]));
+    }
+  }
+
+  const std::pair<const char *, uint64_t> fields[] = {
+      {"files", n},
+      {"frames", frames.load()},
+      {"bytes", bytes.load()},
+      {"failed", failures.size()},
+      {"wall_us", static_cast<uint64_t>(
+                      std::chrono::duration_cast<std::chrono::microseconds>(
+                          wall)
+                          .count())},
+      {"threads", workers},
+  };
+  constexpr size_t nf = sizeof(fields) / sizeof(fields[0]);
+  ERL_NIF_TERM keys[nf], vals[nf];
+  for (size_t i = 0; i < nf; i++) {
+    keys[i] = fine::__private__::make_atom(env, fields[i].first);
+    vals[i] = enif_make_uint64(env, fields[i].second);
+  }
+  ERL_NIF_TERM stats;
+  enif_make_map_from_arrays(env, keys, vals, nf, &stats);
+
+  return fine::Ok(fine::Term(stats), std::move(failures));
+}
+
+FINE_NIF(nif_scrub_dir, ERL_NIF_DIRTY_JOB_IO_BOUND);
+
+// ===================================================================
+// Phase 23: Content Hashing
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// NIF: compress_hashed/2
+// Compress through a context and return the XXH64 (seed 0) of the input
+// alongside the frame. The hash is a separate native pass over the input,
+// made before compressing; it saves the caller a hashing round trip, not
+// the pass itself.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string, uint64_t>, fine::Error<std::string>>
+nif_compress_hashed(ErlNifEnv *env, fine::ResourcePtr<CCtx> cctx,
+                    std::string_view input) {
+  if (input.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  uint64_t hash = XXH64(input.data(), input.size(), 0);
+
+  size_t bound = ZL_compressBound(input.size());
+  std::string output(bound, '\0');
+  auto start = std::chrono::steady_clock::now();
+  ZL_Report result = ZL_CCtx_compress(cctx->ctx, output.data(), bound,
+                                       input.data(), input.size());
+  if (ZL_isError(result)) {
+    const char *err = ZL_CCtx_getErrorContextString(cctx->ctx, result);
+    return fine::Error(err ? std::string(err) : "compression failed");
+  }
+  record_compress_cost(cctx->ns_per_byte,
+                       std::chrono::steady_clock::now() - start, input.size());
+
+  output.resize(ZL_validResult(result));
+  return fine::Ok(std::move(output), hash);
+}
+
+FINE_NIF(nif_compress_hashed, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: decompress_hashed/2
+// Decompress anything decompress/2 accepts and return the XXH64 (seed 0) of
+// the output. Chunked containers are hashed chunk by chunk as each is
+// decoded, while the chunk is still in cache. OpenZL frames and LZ4
+// envelopes only decode in one shot, so they are hashed in a second pass
+// over the whole output once decoding finishes.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<std::string, uint64_t>, fine::Error<std::string>>
+nif_decompress_hashed(ErlNifEnv *env, fine::ResourcePtr<DCtx> dctx,
+                      std::string_view compressed) {
+  if (compressed.empty()) {
+    return fine::Error(std::string("input must not be empty"));
+  }
+
+  std::string output;
+  if (is_lz4_envelope(compressed)) {
+    if (auto err = lz4_unwrap(compressed, output)) {
+      return fine::Error(std::move(*err));
+    }
+  } else if (is_chunked_container(compressed)) {
+    ChunkedIndex index;
+    if (auto err = parse_chunked(compressed, index)) {
+      return fine::Error(std::move(*err));
+    }
+    XXH64_state_t state;
+    XXH64_reset(&state, 0);
+    output.reserve(index.raw_size);
+    for (size_t i = 0; i < index.frames.size(); i++) {
+      size_t start = output.size();
+      if (auto err = decode_chunk(dctx->ctx, index, i, output)) {
+        return fine::Error(std::move(*err));
+      }
+      XXH64_update(&state, output.data() + start, output.size() - start);
+    }
+    uint64_t hash = XXH64_digest(&state);
+    return fine::Ok(std::move(output), hash);
+  } else {
+    ZL_Report size =
+        ZL_getDecompressedSize(compressed.data(), compressed.size());
+    if (ZL_isError(size)) {
+      return fine::Error(
+          std::string("failed to read decompressed size from frame"));
+    }
+    output.resize(ZL_validResult(size));
+    ZL_Report result =
+        ZL_DCtx_decompress(dctx->ctx, output.data(), output.size(),
+                            compressed.data(), compressed.size());
+    if (ZL_isError(result)) {
+      return fine::Error(std::string("decompression failed"));
+    }
+    output.resize(ZL_validResult(result));
+  }
+
+  uint64_t hash = XXH64(output.data(), output.size(), 0);
+  return fine::Ok(std::move(output), hash);
+}
+
+FINE_NIF(nif_decompress_hashed, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ===================================================================
+// Phase 24: Compressed Key-Value Cache
+// ===================================================================
+
+// ---------------------------------------------------------------------------
+// Resource: Compressed key-value cache
+// Keys hash to one of a fixed set of shards. Each shard has its own mutex,
+// LRU list and an equal slice of the byte cap. The mutex only covers
+// bookkeeping: values are compressed before it is taken, and a get copies
+// out a reference to the stored value and decodes after releasing it, so
+// a large entry never holds up other callers on the shard. Codec work uses
+// contexts leased from a per-cache pool. Values that do not shrink are
+// stored as-is. The cap counts stored key and value bytes.
+// ---------------------------------------------------------------------------
+
+struct KvEntry {
+  std::string key;
+  // Shared so a get can decode it after releasing the shard lock
+  std::shared_ptr<const std::string> value;
+  uint64_t raw_size;
+  bool stored;
+};
+
+struct KvShard {
+  std::mutex mutex;
+  std::list<KvEntry> lru; // front is most recently used
+  std::unordered_map<std::string, std::list<KvEntry>::iterator> index;
+  uint64_t bytes = 0;
+  uint64_t raw_bytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+
+  void unlink(std::list<KvEntry>::iterator it) {
+    bytes -= it->key.size() + it->value->size();
+    raw_bytes -= it->raw_size;
+    index.erase(it->key);
+    lru.erase(it);
+  }
+};
+
+// A compression context and its output scratch, configured for one cache.
+struct KvCodec {
+  CCtx cctx;
+  std::string scratch;
+};
+
+class KvCache {
+public:
+  std::vector<std::unique_ptr<KvShard>> shards;
+  uint64_t shard_cap = 0;
+  uint64_t inline_limit = 0;
+  int level = 0;
+  // The template's compressor, held directly so a later set_compressor on
+  // the template cannot free it under pooled contexts. Without one the
+  // cache owns a generic compressor, as a fresh context would.
+  std::optional<fine::ResourcePtr<Compressor>> compressor_ref;
+  ZL_Compressor *generic = nullptr;
+  std::mutex pool_mutex;
+  std::vector<std::unique_ptr<KvCodec>> codecs;
+
+  ~KvCache() {
+    codecs.clear();
+    if (generic) {
+      ZL_Compressor_free(generic);
+    }
+  }
+
+  ZL_Compressor *compressor() const {
+    return compressor_ref ? (*compressor_ref)->compressor : generic;
+  }
+
+  KvShard &shard_for(std::string_view key) {
+    return *shards[std::hash<std::string_view>{}(key) % shards.size()];
+  }
+};
+
+FINE_RESOURCE(KvCache);
+
+// Leases a codec from the cache's pool for one call, creating one when
+// every pooled codec is in use. The pool grows to the peak number of
+// concurrent writers.
+class KvCodecLease {
+public:
+  explicit KvCodecLease(KvCache &cache) : cache_(cache) {
+    std::lock_guard<std::mutex> lock(cache_.pool_mutex);
+    if (!cache_.codecs.empty()) {
+      codec = std::move(cache_.codecs.back());
+      cache_.codecs.pop_back();
+    }
+  }
+
+  ~KvCodecLease() {
+    if (codec && ready) {
+      staging_release(codec->scratch);
+      std::lock_guard<std::mutex> lock(cache_.pool_mutex);
+      cache_.codecs.push_back(std::move(codec));
+    }
+  }
+
+  std::optional<std::string> init() {
+    if (codec) {
+      ready = true;
+      return std::nullopt;
+    }
+    codec = std::make_unique<KvCodec>();
+    if (auto err = init_cctx(codec->cctx.ctx, cache_.compressor())) {
+      return err;
+    }
+    if (cache_.level != 0) {
+      (void)ZL_CCtx_setParameter(codec->cctx.ctx, ZL_CParam_compressionLevel,
+                                 cache_.level);
+    }
+    ready = true;
+    return std::nullopt;
+  }
+
+  std::unique_ptr<KvCodec> codec;
+
+private:
+  KvCache &cache_;
+  bool ready = false;
+};
+
+// Decompression contexts carry no per-cache settings, so gets use one
+// per scheduler thread.
+static ZL_DCtx *kv_thread_dctx() {
+  thread_local DCtx dctx;
+  return dctx.ctx;
+}
+
+// ---------------------------------------------------------------------------
+// NIF: kv_new/4
+// Create a cache: (shards, max_bytes, template_cctx, inline_limit). The
+// template's level and attached compressor are copied. Entries whose raw
+// size exceeds inline_limit are only decoded on a dirty scheduler.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::ResourcePtr<KvCache>>,
+                    fine::Error<std::string>>
+nif_kv_new(ErlNifEnv *env, uint64_t shards, uint64_t max_bytes,
+           fine::ResourcePtr<CCtx> tmpl, uint64_t inline_limit) {
+  if (shards == 0 || shards > 1024) {
+    return fine::Error(std::string("shards must be between 1 and 1024"));
+  }
+  if (max_bytes < shards) {
+    return fine::Error(std::string("max_bytes must be at least shards"));
+  }
+
+  auto cache = fine::make_resource<KvCache>();
+  cache->shard_cap = max_bytes / shards;
+  cache->inline_limit = inline_limit;
+  cache->level = tmpl->level;
+  cache->compressor_ref = tmpl->compressor_ref;
+  if (!cache->compressor_ref) {
+    cache->generic = ZL_Compressor_create();
+    if (!cache->generic ||
+        ZL_isError(ZL_Compressor_selectStartingGraphID(
+            cache->generic, ZL_GRAPH_COMPRESS_GENERIC))) {
+      return fine::Error(std::string("failed to create compressor"));
+    }
+  }
+  for (uint64_t i = 0; i < shards; i++) {
+    cache->shards.push_back(std::make_unique<KvShard>());
+  }
+
+  // Validate the configuration now rather than on the first put
+  KvCodecLease lease(*cache);
+  if (auto err = lease.init()) {
+    return fine::Error(std::move(*err));
+  }
+  return fine::Ok(cache);
+}
+
+FINE_NIF(nif_kv_new, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: kv_put/3 (and kv_put_dirty/3)
+// Store a value, replacing any previous one and evicting least recently
+// used entries of the shard until it fits under its cap.
+// ---------------------------------------------------------------------------
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_kv_put(ErlNifEnv *env, fine::ResourcePtr<KvCache> cache,
+           std::string_view key, std::string_view value) {
+  KvEntry entry{std::string(key), nullptr, value.size(), false};
+  if (!value.empty()) {
+    KvCodecLease lease(*cache);
+    if (auto err = lease.init()) {
+      return fine::Error(std::move(*err));
+    }
+    std::string &scratch = lease.codec->scratch;
+    if (auto err = compress_serial(lease.codec->cctx.ctx, value, scratch)) {
+      return fine::Error(std::move(*err));
+    }
+    if (scratch.size() < value.size()) {
+      entry.value = std::make_shared<const std::string>(scratch);
+    }
+  }
+  if (!entry.value) {
+    entry.value = std::make_shared<const std::string>(value);
+    entry.stored = true;
+  }
+  uint64_t size = entry.key.size() + entry.value->size();
+  if (size > cache->shard_cap) {
+    return fine::Error(std::string("entry is larger than a cache shard"));
+  }
+
+  KvShard &shard = cache->shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto existing = shard.index.find(entry.key);
+  if (existing != shard.index.end()) {
+    shard.unlink(existing->second);
+  }
+  while (!shard.lru.empty() && shard.bytes + size > cache->shard_cap) {
+    shard.unlink(std::prev(shard.lru.end()));
+    shard.evictions++;
+  }
+
+  shard.lru.push_front(std::move(entry));
+  shard.index.emplace(shard.lru.front().key, shard.lru.begin());
+  shard.bytes += size;
+  shard.raw_bytes += value.size();
+  return fine::Ok(fine::Atom("ok"));
+}
+
+FINE_NIF(nif_kv_put, 0);
+
+static std::variant<fine::Ok<fine::Atom>, fine::Error<std::string>>
+nif_kv_put_dirty(ErlNifEnv *env, fine::ResourcePtr<KvCache> cache,
+                 std::string_view key, std::string_view value) {
+  return nif_kv_put(env, cache, key, value);
+}
+
+FINE_NIF(nif_kv_put_dirty, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: kv_get/2 (and kv_get_dirty/2)
+// Returns {:ok, value}, :miss, or, on a normal scheduler, :large for an
+// entry above the inline limit so the caller retries on a dirty one. The
+// value is decompressed straight into a fresh binary, outside the shard
+// lock.
+// ---------------------------------------------------------------------------
+
+static fine::Term kv_get(ErlNifEnv *env, KvCache &cache, std::string_view key,
+                         bool dirty) {
+  std::shared_ptr<const std::string> value;
+  uint64_t raw_size;
+  bool stored;
+  {
+    KvShard &shard = cache.shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto found = shard.index.find(std::string(key));
+    if (found == shard.index.end()) {
+      shard.misses++;
+      return fine::Term(fine::__private__::make_atom(env, "miss"));
+    }
+    const KvEntry &entry = *found->second;
+    if (!dirty && entry.raw_size > cache.inline_limit) {
+      return fine::Term(fine::__private__::make_atom(env, "large"));
+    }
+    value = entry.value;
+    raw_size = entry.raw_size;
+    stored = entry.stored;
+    shard.hits++;
+    shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+  }
+
+  ERL_NIF_TERM bin;
+  unsigned char *out = enif_make_new_binary(env, raw_size, &bin);
+  if (stored) {
+    std::memcpy(out, value->data(), value->size());
+  } else {
+    ZL_DCtx *dctx = kv_thread_dctx();
+    bool ok = false;
+    if (dctx) {
+      ZL_Report result = ZL_DCtx_decompress(dctx, out, raw_size, value->data(),
+                                            value->size());
+      ok = !ZL_isError(result) && ZL_validResult(result) == raw_size;
+    }
+    if (!ok) {
+      return fine::Term(enif_make_tuple2(
+          env, fine::__private__::make_atom(env, "error"),
+          fine::encode(env, std::string("decompression failed"))));
+    }
+  }
+  return fine::Term(
+      enif_make_tuple2(env, fine::__private__::make_atom(env, "ok"), bin));
+}
+
+static fine::Term nif_kv_get(ErlNifEnv *env, fine::ResourcePtr<KvCache> cache,
+                             std::string_view key) {
+  return kv_get(env, *cache, key, false);
+}
+
+FINE_NIF(nif_kv_get, 0);
+
+static fine::Term nif_kv_get_dirty(ErlNifEnv *env,
+                                   fine::ResourcePtr<KvCache> cache,
+                                   std::string_view key) {
+  return kv_get(env, *cache, key, true);
+}
+
+FINE_NIF(nif_kv_get_dirty, ERL_NIF_DIRTY_JOB_CPU_BOUND);
+
+// ---------------------------------------------------------------------------
+// NIF: kv_delete/2
+// ---------------------------------------------------------------------------
+
+static fine::Atom nif_kv_delete(ErlNifEnv *env,
+                                fine::ResourcePtr<KvCache> cache,
+                                std::string_view key) {
+  KvShard &shard = cache->shard_for(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.index.find(std::string(key));
+  if (found != shard.index.end()) {
+    shard.unlink(found->second);
+  }
+  return fine::Atom("ok");
+}
+
+FINE_NIF(nif_kv_delete, 0);
+
+// ---------------------------------------------------------------------------
+// NIF: kv_stats/1
+// Totals across shards, each read under its own lock.
+// ---------------------------------------------------------------------------
+
+static fine::Term nif_kv_stats(ErlNifEnv *env,
+                               fine::ResourcePtr<KvCache> cache) {
+  uint64_t entries = 0, bytes = 0, raw_bytes = 0;
+  uint64_t hits = 0, misses = 0, evictions = 0;
+  for (const auto &shard : cache->shards) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    entries += shard->index.size();
+    bytes += shard->bytes;
+    raw_bytes += shard->raw_bytes;
+    hits += shard->hits;
+    misses += shard->misses;
+    evictions += shard->evictions;
+  }
+
+  const std::pair<const char *, uint64_t> fields[] = {
+      {"entries", entries},
+      {"bytes", bytes},
+      {"raw_bytes", raw_bytes},
+      {"max_bytes", cache->shard_cap * cache->shards.size()},
+      {"hits", hits},
+      {"misses", misses},
+      {"evictions", evictions},
+      {"shards", cache->shards.size()},
+  };
+  constexpr size_t nf = sizeof(fields) / sizeof(fields[0]);
+  ERL_NIF_TERM keys[nf + 1], vals[nf + 1];
+  for (size_t i = 0; i < nf; i++) {
+    keys[i] = fine::__private__::make_atom(env, fields[i].first);
+    vals[i] = enif_make_uint64(env, fields[i].second);
+  }
+  // Raw bytes per stored byte; 0.0 while empty
+  keys[nf] = fine::__private__::make_atom(env, "ratio");
+  vals[nf] = enif_make_double(
+      env, bytes ? static_cast<double>(raw_bytes) / bytes : 0.0);
+
+  ERL_NIF_TERM stats;
+  enif_make_map_from_arrays(env, keys, vals, nf + 1, &stats);
+  return fine::Term(stats);
+}
+
+FINE_NIF(nif_kv_stats, 0);
+
 // ---------------------------------------------------------------------------
 // Module init
 // ---------------------------------------------------------------------------
@@ -22,6 +22,26 @@ defmodule ExOpenzl do
   @spec version() :: String.t()
   def version, do: NIF.nif_version()
 
+  @doc """
+  Returns build and runtime details of the loaded NIF.
+
+  `:kernel_isa` is the ISA the NIF's own data-shuffling kernels are built
+  for; they have a single `:baseline` build, compiled for the platform's
+  baseline ISA. `:cpu_features` lists the relevant features of the running
+  CPU (`:sse4_2`, `:popcnt`, `:avx2`, `:bmi2`, `:avx512f`, ...).
+  """
+  @spec build_info() :: %{
+          openzl_version: String.t(),
+          kernel_isa: :baseline,
+          cpu_features: [atom()],
+          compiler: String.t()
+        }
+  def build_info, do: NIF.nif_build_info()
+
+  # LZ4 payloads up to this raw size are coded on a normal scheduler; for
+  # decoding that is the size recorded in the envelope header
+  @fast_scheduler_limit 262_144
+
   @doc """
   Compresses the given binary using OpenZL.
 
@@ -41,22 +61,89 @@ defmodule ExOpenzl do
     NIF.nif_compress_with_context(ctx, data)
   end
 
+  @doc """
+  Compresses with a time budget, falling back to cheaper encodings when the
+  context's usual settings would miss it.
+
+  Options:
+  - `:deadline` (required) — budget in microseconds
+
+  The context keeps a moving average of its cost per byte, fed by every
+  `compress/2` and `compress/3` call. If that projects the call to finish
+  in time it runs as usual (`:primary`). Otherwise it uses a level-1
+  context (`:fast`), or stores the data uncompressed (`:stored`) when even
+  that would be late. A context with no history times a 64 KiB prefix
+  first on large inputs. All three paths produce ordinary frames for
+  `decompress/1,2`.
+
+      {:ok, frame, :primary | :fast | :stored} =
+        ExOpenzl.compress(ctx, payload, deadline: 5_000)
+  """
+  @spec compress(reference(), binary(), keyword()) ::
+          {:ok, binary(), :primary | :fast | :stored} | {:error, String.t()}
+  def compress(ctx, data, opts) when is_reference(ctx) and is_binary(data) and is_list(opts) do
+    deadline = Keyword.fetch!(opts, :deadline)
+
+    unless is_integer(deadline) and deadline >= 0 do
+      raise ArgumentError, ":deadline must be a non-negative integer (microseconds)"
+    end
+
+    NIF.nif_compress_deadline(ctx, data, deadline)
+  end
+
   @doc """
   Decompresses an OpenZL-compressed binary.
 
+  Also accepts the LZ4 envelopes written by `compress_fast/2` and the
+  containers written by `compress_chunked/3`.
+
   Returns `{:ok, decompressed}` on success or `{:error, reason}` on failure.
   """
   @spec decompress(binary()) :: {:ok, binary()} | {:error, String.t()}
+  def decompress(<<"EZL4", size::little-32, _::binary>> = data)
+      when size <= @fast_scheduler_limit,
+      do: NIF.nif_decompress_fast(data)
+
   def decompress(data) when is_binary(data), do: NIF.nif_decompress(data)
 
   @doc """
   Decompresses using a reusable decompression context.
+
+  Like `decompress/1`, also accepts `compress_fast/2` envelopes and
+  `compress_chunked/3` containers.
   """
   @spec decompress(reference(), binary()) :: {:ok, binary()} | {:error, String.t()}
+  def decompress(ctx, <<"EZL4", size::little-32, _::binary>> = data)
+      when is_reference(ctx) and size <= @fast_scheduler_limit,
+      do: NIF.nif_decompress_fast(data)
+
   def decompress(ctx, data) when is_reference(ctx) and is_binary(data) do
     NIF.nif_decompress_with_context(ctx, data)
   end
 
+  @doc """
+  Compresses with LZ4 for latency rather than ratio.
+
+  The result is a small envelope around an LZ4 block that `decompress/1` and
+  `decompress/2` recognise, so readers need no changes. Payloads up to
+  #{div(@fast_scheduler_limit, 1024)} KiB are handled on the calling
+  scheduler, skipping the dirty-scheduler hop the OpenZL paths take.
+
+  Options:
+  - `:acceleration` — LZ4 acceleration factor, 1 (default) to 65537.
+    Higher is faster with a lower ratio.
+  """
+  @spec compress_fast(binary(), keyword()) :: {:ok, binary()} | {:error, String.t()}
+  def compress_fast(data, opts \\ []) when is_binary(data) do
+    acceleration = Keyword.get(opts, :acceleration, 1)
+
+    if byte_size(data) <= @fast_scheduler_limit do
+      NIF.nif_compress_fast(data, acceleration)
+    else
+      NIF.nif_compress_fast_dirty(data, acceleration)
+    end
+  end
+
   @doc """
   Creates a reusable compression context.
 
@@ -118,21 +205,44 @@ defmodule ExOpenzl do
   - `{:numeric, data, element_width}` — width must be 1, 2, 4, or 8
   - `{:struct, data, struct_width}` — fixed-width records
   - `{:string, data, lengths_bin}` — variable-length strings with packed uint32 lengths
+
+  Options:
+  - `:endianness` (numeric input) — byte order of `data`: `:native`
+    (default), `:little` or `:big`. Non-native data is byte-swapped inside
+    the NIF; pass the same option to `decompress_typed/3` to get it back in
+    that order.
+  - `:lengths_format` (string input) — encoding of `lengths_bin`:
+    - `:u32` (default) — one native-endian u32 per string
+    - `:u64` — one native-endian u64 per string
+    - `:varint` — one unsigned LEB128 value per string
+    - `:offsets32` / `:offsets64` — Arrow-style offsets, one more than the
+      number of strings; a non-zero first offset selects a slice of `data`
+
+    Fixed-width values are read in native byte order, the order of the
+    `:string_lengths` that `decompress_typed/3` returns, so lengths built
+    with `<<n::native-32>>` round-trip on any host. Little-endian data
+    from another source (such as an Arrow file) must be swapped first on
+    big-endian hosts. Values need not be aligned. Each string must be
+    under 4 GB.
   """
-  @spec compress_typed(reference(), tuple()) :: {:ok, binary()} | {:error, String.t()}
-  def compress_typed(ctx, {:numeric, data, element_width})
+  @spec compress_typed(reference(), tuple(), keyword()) ::
+          {:ok, binary()} | {:error, String.t()}
+  def compress_typed(ctx, input, opts \\ [])
+
+  def compress_typed(ctx, {:numeric, data, element_width}, opts)
       when is_reference(ctx) and is_binary(data) and is_integer(element_width) do
-    NIF.nif_compress_typed_numeric(ctx, data, element_width)
+    NIF.nif_compress_typed_numeric(ctx, data, element_width, byte_swap?(opts))
   end
 
-  def compress_typed(ctx, {:struct, data, struct_width})
+  def compress_typed(ctx, {:struct, data, struct_width}, _opts)
       when is_reference(ctx) and is_binary(data) and is_integer(struct_width) do
     NIF.nif_compress_typed_struct(ctx, data, struct_width)
   end
 
-  def compress_typed(ctx, {:string, data, lengths_bin})
+  def compress_typed(ctx, {:string, data, lengths_bin}, opts)
       when is_reference(ctx) and is_binary(data) and is_binary(lengths_bin) do
-    NIF.nif_compress_typed_string(ctx, data, lengths_bin)
+    format = Keyword.get(opts, :lengths_format, :u32)
+    NIF.nif_compress_typed_string(ctx, data, lengths_bin, lengths_format_code(format))
   end
 
   @doc """
@@ -140,32 +250,69 @@ defmodule ExOpenzl do
 
   Each input is a tagged tuple: `{:numeric, data, width}`,
   `{:struct, data, struct_width}`, or `{:string, data, lengths_bin}`.
+  String lengths in another encoding are given as
+  `{:string, data, {lengths_format, lengths_bin}}`, with the formats of
+  `compress_typed/3`.
   """
   @spec compress_multi_typed(reference(), [tuple()]) ::
           {:ok, binary()} | {:error, String.t()}
   def compress_multi_typed(ctx, inputs) when is_reference(ctx) and is_list(inputs) do
+    inputs =
+      Enum.map(inputs, fn
+        {:string, data, {format, lengths_bin}} ->
+          {:string, data, {lengths_format_code(format), lengths_bin}}
+
+        input ->
+          input
+      end)
+
     NIF.nif_compress_multi_typed(ctx, inputs)
   end
 
+  @lengths_formats %{u32: 0, u64: 1, varint: 2, offsets32: 3, offsets64: 4}
+
+  defp lengths_format_code(format) do
+    case Map.fetch(@lengths_formats, format) do
+      {:ok, code} -> code
+      :error -> raise ArgumentError, "invalid :lengths_format #{inspect(format)}"
+    end
+  end
+
   @doc """
   Decompresses a single typed output from a compressed frame.
 
   Returns `{:ok, info_map}` where `info_map` contains `:type`, `:data`,
   `:element_width`, `:num_elements`, and optionally `:string_lengths`.
+
+  Options:
+  - `:endianness` — byte order for numeric `:data`: `:native` (default),
+    `:little` or `:big`
   """
-  @spec decompress_typed(reference(), binary()) :: {:ok, map()} | {:error, String.t()}
-  def decompress_typed(ctx, compressed) when is_reference(ctx) and is_binary(compressed) do
-    NIF.nif_decompress_typed(ctx, compressed)
+  @spec decompress_typed(reference(), binary(), keyword()) :: {:ok, map()} | {:error, String.t()}
+  def decompress_typed(ctx, compressed, opts \\ [])
+      when is_reference(ctx) and is_binary(compressed) do
+    NIF.nif_decompress_typed(ctx, compressed, byte_swap?(opts))
   end
 
   @doc """
   Decompresses a multi-output frame into a list of typed result maps.
+
+  Accepts the same `:endianness` option as `decompress_typed/3`, applied to
+  every numeric output.
   """
-  @spec decompress_multi_typed(reference(), binary()) ::
+  @spec decompress_multi_typed(reference(), binary(), keyword()) ::
           {:ok, [map()]} | {:error, String.t()}
-  def decompress_multi_typed(ctx, compressed)
+  def decompress_multi_typed(ctx, compressed, opts \\ [])
       when is_reference(ctx) and is_binary(compressed) do
-    NIF.nif_decompress_multi_typed(ctx, compressed)
+    NIF.nif_decompress_multi_typed(ctx, compressed, byte_swap?(opts))
+  end
+
+  defp byte_swap?(opts) do
+    case Keyword.get(opts, :endianness, :native) do
+      :native -> false
+      endianness when endianness in [:little, :big] -> endianness != System.endianness()
+      other -> raise ArgumentError, "invalid :endianness #{inspect(other)}"
+    end
   end
 
   @doc """
@@ -185,12 +332,29 @@ defmodule ExOpenzl do
 
   @doc """
   Compiles SDDL source text to a binary description.
+
+  Compilation runs on a dirty scheduler, and compiled output is cached by
+  source text, so repeated calls with the same description are cheap. See
+  `sddl_cache_stats/0`.
   """
   @spec sddl_compile(String.t()) :: {:ok, binary()} | {:error, String.t()}
   def sddl_compile(source) when is_binary(source) do
     NIF.nif_sddl_compile(source)
   end
 
+  @doc """
+  Returns counters for the compiled SDDL cache: `:entries`, `:hits`,
+  `:misses`, `:compiles` and the total `:compile_time_us` spent compiling.
+  """
+  @spec sddl_cache_stats() :: %{atom() => non_neg_integer()}
+  def sddl_cache_stats, do: NIF.nif_sddl_cache_stats()
+
+  @doc """
+  Empties the compiled SDDL cache and resets its counters.
+  """
+  @spec sddl_cache_clear() :: :ok
+  def sddl_cache_clear, do: NIF.nif_sddl_cache_clear()
+
   @doc """
   Creates a compressor from compiled SDDL binary.
   """
@@ -212,4 +376,1102 @@ defmodule ExOpenzl do
       {:error, _} = err -> err
     end
   end
+
+  # ===========================================================================
+  # Phase 4: Append Log
+  # ===========================================================================
+
+  @default_log_block_size 1_048_576
+
+  @doc """
+  Opens an append-only log file, creating it if it does not exist.
+
+  Appended records are buffered and compressed a block at a time as a single
+  string-typed frame through `ctx`, so records share one frame instead of
+  paying per-record overhead. Attach a compressor or set a level on `ctx`
+  beforehand to change how blocks are encoded. The log holds a reference to
+  `ctx`; do not use the context elsewhere while the log is open.
+
+  Opening an existing log continues after its last complete block. A log left
+  without a footer (for example after a crash) is recovered by scanning block
+  headers, dropping any partially written block.
+
+  Options:
+  - `:block_size` — uncompressed bytes buffered before a block is written
+    (default `#{@default_log_block_size}`)
+  """
+  @spec log_open(String.t(), reference(), keyword()) :: {:ok, reference()} | {:error, String.t()}
+  def log_open(path, ctx, opts \\ []) when is_binary(path) and is_reference(ctx) do
+    block_size = Keyword.get(opts, :block_size, @default_log_block_size)
+    NIF.nif_log_open(path, ctx, block_size)
+  end
+
+  @doc """
+  Appends one record or a list of records to a log.
+
+  Returns `{:ok, record_number}` with the record number of the first appended
+  record, usable with `log_read_record/3`.
+  """
+  @spec log_append(reference(), binary() | [binary()]) ::
+          {:ok, non_neg_integer()} | {:error, String.t()}
+  def log_append(log, record) when is_reference(log) and is_binary(record) do
+    NIF.nif_log_append(log, [record])
+  end
+
+  def log_append(log, records) when is_reference(log) and is_list(records) do
+    NIF.nif_log_append(log, records)
+  end
+
+  @doc """
+  Writes buffered records as a (possibly short) block and syncs the file.
+  """
+  @spec log_flush(reference()) :: :ok | {:error, String.t()}
+  def log_flush(log) when is_reference(log) do
+    case NIF.nif_log_flush(log) do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Flushes buffered records, writes the block index footer and closes the log.
+
+  A log that is garbage collected without being closed drops its buffered
+  records; blocks already written stay readable.
+  """
+  @spec log_close(reference()) :: :ok | {:error, String.t()}
+  def log_close(log) when is_reference(log) do
+    case NIF.nif_log_close(log) do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Returns writer statistics: `:block_count`, `:record_count` (records in
+  written blocks), `:pending_records`, `:pending_bytes` and `:file_size`.
+  """
+  @spec log_info(reference()) :: map()
+  def log_info(log) when is_reference(log), do: NIF.nif_log_info(log)
+
+  @doc """
+  Opens a log for reading.
+
+  Returns `{:ok, reader}`. Use `log_reader_info/1` for block and record counts.
+  """
+  @spec log_reader_open(String.t()) :: {:ok, reference()} | {:error, String.t()}
+  def log_reader_open(path) when is_binary(path), do: NIF.nif_log_reader_open(path)
+
+  @doc """
+  Returns `%{block_count: n, record_count: n}` for a log reader.
+  """
+  @spec log_reader_info(reference()) :: map()
+  def log_reader_info(reader) when is_reference(reader), do: NIF.nif_log_reader_info(reader)
+
+  @doc """
+  Decompresses one block of a log and returns its records in append order.
+  """
+  @spec log_read_block(reference(), reference(), non_neg_integer()) ::
+          {:ok, [binary()]} | {:error, String.t()}
+  def log_read_block(reader, dctx, index)
+      when is_reference(reader) and is_reference(dctx) and is_integer(index) and index >= 0 do
+    NIF.nif_log_read_block(reader, dctx, index)
+  end
+
+  @doc """
+  Reads a single record by record number, decompressing only its block.
+  """
+  @spec log_read_record(reference(), reference(), non_neg_integer()) ::
+          {:ok, binary()} | {:error, String.t()}
+  def log_read_record(reader, dctx, n)
+      when is_reference(reader) and is_reference(dctx) and is_integer(n) and n >= 0 do
+    NIF.nif_log_read_record(reader, dctx, n)
+  end
+
+  @doc """
+  Returns a lazy stream of every record in a log, one block at a time.
+
+  Raises if a block fails to decompress.
+  """
+  @spec log_stream(reference(), reference()) :: Enumerable.t()
+  def log_stream(reader, dctx) when is_reference(reader) and is_reference(dctx) do
+    %{block_count: block_count} = log_reader_info(reader)
+
+    Stream.flat_map(0..(block_count - 1)//1, fn index ->
+      case log_read_block(reader, dctx, index) do
+        {:ok, records} -> records
+        {:error, reason} -> raise "failed to read log block #{index}: #{reason}"
+      end
+    end)
+  end
+
+  # ===========================================================================
+  # Phase 5: Multi-Series Packing
+  # ===========================================================================
+
+  @doc """
+  Packs many short time series into a single multi-typed frame.
+
+  Each series is `{id, timestamps, values}` where `timestamps` is packed
+  little-endian u64 and `values` holds one `value_width`-byte element per
+  timestamp. Ids, point counts, timestamps and values are laid out as four
+  concatenated numeric columns, so the frame overhead is paid once per batch
+  instead of once per series.
+  """
+  @spec pack_series(reference(), [{non_neg_integer(), binary(), binary()}], 1 | 2 | 4 | 8) ::
+          {:ok, binary()} | {:error, String.t()}
+  def pack_series(ctx, series, value_width \\ 8)
+      when is_reference(ctx) and is_list(series) and is_integer(value_width) do
+    NIF.nif_pack_series(ctx, series, value_width)
+  end
+
+  @doc """
+  Extracts one series by id from a frame produced by `pack_series/3`.
+
+  Returns `{:ok, {id, timestamps, values}}` or `{:error, "series not found"}`.
+  Columns are decoded natively; only the requested series is copied into
+  Elixir binaries.
+  """
+  @spec unpack_series(reference(), binary(), non_neg_integer()) ::
+          {:ok, {non_neg_integer(), binary(), binary()}} | {:error, String.t()}
+  def unpack_series(dctx, compressed, id)
+      when is_reference(dctx) and is_binary(compressed) and is_integer(id) and id >= 0 do
+    NIF.nif_unpack_series(dctx, compressed, id)
+  end
+
+  @doc """
+  Extracts every series from a frame produced by `pack_series/3`, in packing
+  order.
+  """
+  @spec unpack_all_series(reference(), binary()) ::
+          {:ok, [{non_neg_integer(), binary(), binary()}]} | {:error, String.t()}
+  def unpack_all_series(dctx, compressed) when is_reference(dctx) and is_binary(compressed) do
+    NIF.nif_unpack_all_series(dctx, compressed)
+  end
+
+  # ===========================================================================
+  # Phase 6: Tensor Compression
+  # ===========================================================================
+
+  # Nx is not a dependency of this library; these functions call it at
+  # runtime and are only usable when the application depends on it.
+  @compile {:no_warn_undefined, Nx}
+
+  @tensor_kinds %{u: 0, s: 1, f: 2, bf: 3, c: 4}
+  @tensor_kind_atoms Map.new(@tensor_kinds, fn {kind, code} -> {code, kind} end)
+
+  @doc """
+  Compresses an `Nx` tensor.
+
+  The numeric element width comes from the tensor type (complex tensors are
+  stored as their real/imaginary components) and the type and shape are
+  recorded in the frame, so `decompress_tensor/2` needs no side information.
+  For `Nx.BinaryBackend` tensors the backing binary is passed to the NIF
+  without copying.
+
+  Requires `:nx` (0.9 or later) in the application's dependencies.
+  """
+  @spec compress_tensor(reference(), struct()) :: {:ok, binary()} | {:error, String.t()}
+  def compress_tensor(ctx, tensor) when is_reference(ctx) and is_struct(tensor) do
+    {kind, bits} = Nx.type(tensor)
+
+    case Map.fetch(@tensor_kinds, kind) do
+      {:ok, code} ->
+        shape = tensor |> Nx.shape() |> Tuple.to_list()
+        NIF.nif_compress_tensor(ctx, Nx.to_binary(tensor), code, bits, shape)
+
+      :error ->
+        {:error, "unsupported tensor type #{inspect({kind, bits})}"}
+    end
+  end
+
+  @doc """
+  Decompresses a frame produced by `compress_tensor/2` back into an `Nx`
+  tensor with its original type and shape.
+
+  Element data is decoded straight into the binary that backs the returned
+  `Nx.BinaryBackend` tensor, with no intermediate copy.
+
+  Requires `:nx` (0.9 or later) in the application's dependencies.
+  """
+  @spec decompress_tensor(reference(), binary()) :: {:ok, struct()} | {:error, String.t()}
+  def decompress_tensor(dctx, compressed) when is_reference(dctx) and is_binary(compressed) do
+    with {:ok, {data, code, bits, shape}} <- NIF.nif_decompress_tensor(dctx, compressed),
+         {:ok, kind} <- Map.fetch(@tensor_kind_atoms, code) do
+      tensor =
+        data
+        |> Nx.from_binary({kind, bits})
+        |> Nx.reshape(List.to_tuple(shape))
+
+      {:ok, tensor}
+    else
+      :error -> {:error, "unsupported tensor type in frame"}
+      {:error, _} = err -> err
+    end
+  end
+
+  # ===========================================================================
+  # Phase 7: Arrow Record Batches
+  # ===========================================================================
+
+  @typedoc """
+  A column in Arrow C Data Interface layout.
+
+  - `:name` — column name
+  - `:format` — ArrowSchema format string, e.g. `"l"` (int64), `"g"` (float64),
+    `"u"` (utf8), `"U"` (large utf8), `"z"` (binary), `"w:16"`, `"tsu:"`
+  - `:length` — number of elements
+  - `:validity` — optional validity bitmap (`nil` when the column has no nulls)
+  - `:buffers` — the remaining ArrowArray buffers: `[values]` for fixed-width
+    and boolean columns, `[offsets, data]` for variable-width columns
+  """
+  @type arrow_column :: %{
+          required(:name) => String.t(),
+          required(:format) => String.t(),
+          required(:length) => non_neg_integer(),
+          optional(:validity) => binary() | nil,
+          optional(:null_count) => non_neg_integer(),
+          required(:buffers) => [binary()]
+        }
+
+  @doc """
+  Compresses a record batch of Arrow-layout columns into one multi-typed frame.
+
+  Fixed-width columns map to numeric outputs, fixed-size binary and decimal
+  columns to struct outputs, and Utf8/Binary columns to string outputs whose
+  lengths are derived from the Arrow offsets. Validity bitmaps are stored as
+  an extra output next to their column. Column buffers are handed to OpenZL
+  in place; only variable-width offsets are converted.
+
+  Column names and formats are recorded in the frame, so
+  `decompress_record_batch/2` returns the same layout.
+  """
+  @spec compress_record_batch(reference(), [arrow_column()]) ::
+          {:ok, binary()} | {:error, String.t()}
+  def compress_record_batch(ctx, columns) when is_reference(ctx) and is_list(columns) do
+    columns =
+      Enum.map(columns, fn column ->
+        {column.name, column.format, column.length, Map.get(column, :validity), column.buffers}
+      end)
+
+    NIF.nif_compress_record_batch(ctx, columns)
+  end
+
+  @doc """
+  Decompresses a frame produced by `compress_record_batch/2` into Arrow-layout
+  columns, rebuilding offsets buffers for variable-width columns.
+
+  Each column map also carries `:null_count`.
+  """
+  @spec decompress_record_batch(reference(), binary()) ::
+          {:ok, [arrow_column()]} | {:error, String.t()}
+  def decompress_record_batch(dctx, compressed)
+      when is_reference(dctx) and is_binary(compressed) do
+    with {:ok, columns} <- NIF.nif_decompress_record_batch(dctx, compressed) do
+      {:ok,
+       Enum.map(columns, fn {name, format, length, null_count, validity, buffers} ->
+         %{
+           name: name,
+           format: format,
+           length: length,
+           null_count: null_count,
+           validity: validity,
+           buffers: buffers
+         }
+       end)}
+    end
+  end
+
+  # ===========================================================================
+  # Phase 8: Columnar Files
+  # ===========================================================================
+
+  @column_kinds %{uint: 0, int: 1, float: 2, struct: 3, string: 4}
+
+  @typedoc """
+  Column type for columnar files: `{:uint | :int, 1 | 2 | 4 | 8}`,
+  `{:float, 4 | 8}`, `{:struct, width}` or `:string`.
+  """
+  @type column_type ::
+          {:uint | :int, 1 | 2 | 4 | 8} | {:float, 4 | 8} | {:struct, pos_integer()} | :string
+
+  @doc """
+  Creates a columnar file with the given schema.
+
+  The schema is a list of `{name, column_type}`. Rows are written in row
+  groups with `columnar_write_row_group/2`; each column chunk is compressed
+  as its own typed frame through `ctx`, and numeric chunks record min/max
+  zone maps in the footer written by `columnar_close/1`.
+  """
+  @spec columnar_open(String.t(), reference(), [{String.t(), column_type()}]) ::
+          {:ok, reference()} | {:error, String.t()}
+  def columnar_open(path, ctx, schema)
+      when is_binary(path) and is_reference(ctx) and is_list(schema) do
+    NIF.nif_columnar_open(path, ctx, Enum.map(schema, &encode_column_spec/1))
+  end
+
+  defp encode_column_spec({name, :string}), do: {name, @column_kinds.string, 0}
+
+  defp encode_column_spec({name, {kind, width}}) when is_map_key(@column_kinds, kind) do
+    {name, Map.fetch!(@column_kinds, kind), width}
+  end
+
+  @doc """
+  Writes one row group. `columns` follows schema order: packed binaries for
+  fixed-width columns and `{data, lengths_bin}` (packed u32 lengths) for
+  string columns. Every column must have the same number of rows.
+  """
+  @spec columnar_write_row_group(reference(), [binary() | {binary(), binary()}]) ::
+          :ok | {:error, String.t()}
+  def columnar_write_row_group(writer, columns)
+      when is_reference(writer) and is_list(columns) do
+    case NIF.nif_columnar_write_row_group(writer, columns) do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Writes the footer (schema, chunk offsets and zone maps) and closes the file.
+  """
+  @spec columnar_close(reference()) :: :ok | {:error, String.t()}
+  def columnar_close(writer) when is_reference(writer) do
+    case NIF.nif_columnar_close(writer) do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Memory-maps a columnar file for reading.
+  """
+  @spec columnar_open_reader(String.t()) :: {:ok, reference()} | {:error, String.t()}
+  def columnar_open_reader(path) when is_binary(path), do: NIF.nif_columnar_open_reader(path)
+
+  @doc """
+  Returns the file metadata: `:num_rows`, `:schema` (name, type and width per
+  column) and `:row_groups`, each with `:num_rows` and per-column
+  `:offset`, `:compressed_size`, `:min` and `:max` (`nil` for non-numeric
+  columns).
+  """
+  @spec columnar_metadata(reference()) :: map()
+  def columnar_metadata(reader) when is_reference(reader), do: NIF.nif_columnar_metadata(reader)
+
+  @doc """
+  Reads projected columns from selected row groups.
+
+  Only the requested column chunks are decompressed, directly from the
+  mapped file. Returns one map per row group, keyed by column name.
+
+  Options:
+  - `:columns` — column names to read (default: all)
+  - `:row_groups` — row group indices to read (default: all)
+  """
+  @spec columnar_read(reference(), reference(), keyword()) ::
+          {:ok, [%{String.t() => binary() | {binary(), binary()}}]} | {:error, String.t()}
+  def columnar_read(reader, dctx, opts \\ []) when is_reference(reader) and is_reference(dctx) do
+    %{schema: schema, row_groups: groups} = columnar_metadata(reader)
+    names = Enum.map(schema, & &1.name)
+    columns = Keyword.get(opts, :columns, names)
+    row_groups = Keyword.get(opts, :row_groups, Enum.to_list(0..(length(groups) - 1)//1))
+
+    with {:ok, indices} <- column_indices(names, columns),
+         {:ok, groups} <- NIF.nif_columnar_read(reader, dctx, indices, row_groups) do
+      {:ok, Enum.map(groups, &Map.new(Enum.zip(columns, &1)))}
+    end
+  end
+
+  defp column_indices(names, columns) do
+    Enum.reduce_while(columns, {:ok, []}, fn column, {:ok, acc} ->
+      case Enum.find_index(names, &(&1 == column)) do
+        nil -> {:halt, {:error, "unknown column #{inspect(column)}"}}
+        index -> {:cont, {:ok, acc ++ [index]}}
+      end
+    end)
+  end
+
+  @doc """
+  Returns the indices of row groups whose zone map for `column` overlaps
+  `min..max`, so reads can skip row groups that cannot match a range filter.
+
+  Row groups without statistics for the column are always included.
+  """
+  @spec columnar_row_groups(reference(), String.t(), number(), number()) :: [non_neg_integer()]
+  def columnar_row_groups(reader, column, min, max) when is_reference(reader) do
+    %{schema: schema, row_groups: groups} = columnar_metadata(reader)
+    index =
+      Enum.find_index(schema, &(&1.name == column)) ||
+        raise ArgumentError, "unknown column #{inspect(column)}"
+
+    for {group, i} <- Enum.with_index(groups),
+        chunk = Enum.at(group.columns, index),
+        is_nil(chunk.min) or (chunk.max >= min and chunk.min <= max),
+        do: i
+  end
+
+  # ===========================================================================
+  # Phase 9: SDDL Columns
+  # ===========================================================================
+
+  @doc """
+  Decompresses a frame into one column per SDDL field.
+
+  `sddl_source` describes the records. Each field of the root record becomes
+  one column of elements in native byte order (big-endian fields are
+  swapped).
+
+  A frame holding one numeric output per field, such as the columns stored
+  with `compress_multi_typed/2`, is mapped straight onto the field names
+  without touching records. A frame from the SDDL graph holds a single
+  serial output: the graph's per-field streams are internal to the frame
+  and are not available to the caller, so the records are decoded in native
+  memory and each field is gathered out of them; only the columns become
+  BEAM binaries.
+
+  The supported SDDL is the fixed-layout subset: records of builtin
+  integer/float types, fixed-size arrays, nested records, and a root of
+  `Record`, `Record[N]` or `Record[_rem / width]`. Nested fields are named
+  `outer.inner`; unnamed fields are named `field_<n>`.
+
+  Returns a list of maps with `:name`, `:kind` (`:uint`, `:int`, `:float`),
+  `:element_width`, `:elements_per_record`, `:num_elements` and `:data`.
+  """
+  @spec decompress_sddl_columns(reference(), binary(), String.t()) ::
+          {:ok, [map()]} | {:error, String.t()}
+  def decompress_sddl_columns(dctx, compressed, sddl_source)
+      when is_reference(dctx) and is_binary(compressed) and is_binary(sddl_source) do
+    NIF.nif_decompress_sddl_columns(dctx, compressed, sddl_source)
+  end
+
+  # ===========================================================================
+  # Phase 10: SDDL Introspection
+  # ===========================================================================
+
+  @doc """
+  Describes the record layout of an SDDL description and measures what each
+  field costs on `sample`.
+
+  `sample` must be a whole number of records. The whole sample is compressed
+  with the SDDL profile for the totals (`:compressed_size`,
+  `:encode_time_ns`). Each field's `:compressed_size` and `:encode_time_ns`
+  are measured under the same profile as its marginal cost: the total minus
+  the size and encode time of the sample with that field zeroed in every
+  record. Marginal times are single runs and as noisy as any one timing.
+  Each marginal costs a full compression of the sample, so only the 64
+  widest fields are measured; the costs of any others are `nil`. Field maps
+  also carry `:name`, `:kind`, `:offset`, `:element_width`,
+  `:elements_per_record` and `:raw_size`.
+
+  Supports the same fixed-layout SDDL subset as `decompress_sddl_columns/3`.
+  """
+  @spec sddl_describe(String.t(), binary()) :: {:ok, map()} | {:error, String.t()}
+  def sddl_describe(sddl_source, sample) when is_binary(sddl_source) and is_binary(sample) do
+    NIF.nif_sddl_describe(sddl_source, sample)
+  end
+
+  # ===========================================================================
+  # Phase 11: SDDL Record-Type Dispatch
+  # ===========================================================================
+
+  @doc """
+  Creates a compressor for streams that interleave several record types.
+
+  Each record in the input is a tag byte followed by a fixed-layout body
+  described by that tag's SDDL source (the body only, without the tag):
+
+      {:ok, dispatcher} =
+        ExOpenzl.create_dispatch_compressor([
+          {1, "Tick = { UInt64LE\\n Float64LE }\\n: Tick[_rem / 16]"},
+          {2, "Event = { UInt64LE\\n UInt32LE }\\n: Event[_rem / 12]"}
+        ])
+
+  Supports the same fixed-layout SDDL subset as `decompress_sddl_columns/3`.
+  """
+  @spec create_dispatch_compressor([{0..255, String.t()}]) ::
+          {:ok, reference()} | {:error, String.t()}
+  def create_dispatch_compressor(types) when is_list(types) do
+    NIF.nif_create_dispatch_compressor(types)
+  end
+
+  @doc """
+  Compresses tagged records with a dispatcher from
+  `create_dispatch_compressor/1`.
+
+  Records are split by tag; each type's bodies are compressed with its own
+  SDDL graph and the tag sequence separately. The result is a
+  self-describing envelope holding one OpenZL frame per stream, not a
+  single frame, because an SDDL graph takes one description and cannot
+  route records between several. Fails on unknown tags or a truncated
+  trailing record.
+  """
+  @spec compress_dispatch(reference(), binary()) :: {:ok, binary()} | {:error, String.t()}
+  def compress_dispatch(dispatcher, data) when is_reference(dispatcher) and is_binary(data) do
+    NIF.nif_compress_dispatch(dispatcher, data)
+  end
+
+  @doc """
+  Decompresses an envelope from `compress_dispatch/2` back into the
+  original interleaved records.
+  """
+  @spec decompress_dispatch(reference(), binary()) :: {:ok, binary()} | {:error, String.t()}
+  def decompress_dispatch(dctx, compressed) when is_reference(dctx) and is_binary(compressed) do
+    NIF.nif_decompress_dispatch(dctx, compressed)
+  end
+
+  # ===========================================================================
+  # Phase 13: Column Filtering
+  # ===========================================================================
+
+  @element_kinds %{uint: 0, int: 1, float: 2}
+
+  @doc """
+  Selects the elements of a native-endian numeric column that fall within
+  `min..max` (inclusive).
+
+  `type` is `{:uint | :int, 1 | 2 | 4 | 8}` or `{:float, 4 | 8}`. Returns a
+  selection bitmap in Arrow validity order (bit `i` of byte `div(i, 8)`,
+  least significant first) and the number of matches. NaN never matches.
+
+      {:ok, bitmap, count} = ExOpenzl.filter_range(timestamps, {:uint, 8}, t0, t1)
+  """
+  @spec filter_range(binary(), {atom(), pos_integer()}, number(), number()) ::
+          {:ok, binary(), non_neg_integer()} | {:error, String.t()}
+  def filter_range(data, {kind, width}, min, max)
+      when is_binary(data) and is_map_key(@element_kinds, kind) and is_integer(width) and
+             width > 0 and is_number(min) and is_number(max) do
+    {lo, hi} = filter_bounds(kind, width, min, max)
+    NIF.nif_filter_range(data, Map.fetch!(@element_kinds, kind), width, lo, hi)
+  end
+
+  defp filter_bounds(:float, _width, low, high), do: {low * 1.0, high * 1.0}
+
+  defp filter_bounds(kind, width, low, high) do
+    bits = 8 * width
+
+    {type_min, type_max} =
+      if kind == :uint, do: {0, 2 ** bits - 1}, else: {-(2 ** (bits - 1)), 2 ** (bits - 1) - 1}
+
+    low = if is_float(low), do: trunc(Float.ceil(low)), else: low
+    high = if is_float(high), do: trunc(Float.floor(high)), else: high
+
+    if low > type_max or high < type_min or low > high do
+      # An inverted range selects nothing
+      {type_max, type_min}
+    else
+      {max(low, type_min), min(high, type_max)}
+    end
+  end
+
+  # ===========================================================================
+  # Phase 14: Native Buffers
+  # ===========================================================================
+
+  @doc """
+  Allocates a native output buffer of `capacity` bytes for `decompress_into/3`.
+
+  The capacity is fixed for the buffer's lifetime, so decoding many frames
+  into the same buffer performs no allocation on the decode path, as long
+  as no view of earlier contents is still alive (see `buffer_view/3`).
+  """
+  @spec buffer_new(pos_integer()) :: {:ok, reference()} | {:error, String.t()}
+  def buffer_new(capacity) when is_integer(capacity) and capacity > 0 do
+    NIF.nif_buffer_new(capacity)
+  end
+
+  @doc """
+  Returns the buffer's capacity and a description of its current contents:
+  `:length` in bytes, `:type`, `:element_width` and `:num_elements`.
+  """
+  @spec buffer_info(reference()) :: map()
+  def buffer_info(buffer) when is_reference(buffer), do: NIF.nif_buffer_info(buffer)
+
+  @doc """
+  Marks the buffer empty. The memory is kept for reuse.
+  """
+  @spec buffer_reset(reference()) :: :ok
+  def buffer_reset(buffer) when is_reference(buffer), do: NIF.nif_buffer_reset(buffer)
+
+  @doc """
+  Decompresses a single-output frame directly into `buffer`, replacing its
+  contents.
+
+  Serial frames decode as raw bytes; typed frames keep their type, which is
+  reported in the returned info map (see `buffer_info/1`). Fails with
+  `"buffer too small ..."` instead of growing when the output does not fit.
+
+      {:ok, buf} = ExOpenzl.buffer_new(1_048_576)
+      {:ok, %{length: n}} = ExOpenzl.decompress_into(dctx, frame, buf)
+  """
+  @spec decompress_into(reference(), binary(), reference()) ::
+          {:ok, map()} | {:error, String.t()}
+  def decompress_into(dctx, compressed, buffer)
+      when is_reference(dctx) and is_binary(compressed) and is_reference(buffer) do
+    NIF.nif_decompress_into(dctx, compressed, buffer)
+  end
+
+  @doc """
+  Returns a zero-copy binary over the buffer contents, or over
+  `offset..offset + size - 1` when a range is given.
+
+  The view reads the buffer's memory directly but, like any binary, never
+  changes: a `decompress_into/3` on the same buffer while a view is still
+  referenced decodes into newly allocated memory and leaves the viewed
+  memory to the view until it is garbage collected. Drop views before the
+  next decode to keep the decode loop allocation-free, or use
+  `buffer_copy/3` for data that must be kept.
+  """
+  @spec buffer_view(reference(), non_neg_integer() | nil, non_neg_integer() | nil) ::
+          {:ok, binary()} | {:error, String.t()}
+  def buffer_view(buffer, offset \\ nil, size \\ nil) when is_reference(buffer) do
+    with {:ok, offset, size} <- buffer_range(buffer, offset, size) do
+      NIF.nif_buffer_view(buffer, offset, size)
+    end
+  end
+
+  @doc """
+  Like `buffer_view/3` but copies the bytes into an independent binary.
+  """
+  @spec buffer_copy(reference(), non_neg_integer() | nil, non_neg_integer() | nil) ::
+          {:ok, binary()} | {:error, String.t()}
+  def buffer_copy(buffer, offset \\ nil, size \\ nil) when is_reference(buffer) do
+    with {:ok, offset, size} <- buffer_range(buffer, offset, size) do
+      NIF.nif_buffer_copy(buffer, offset, size)
+    end
+  end
+
+  @doc """
+  For a buffer holding string output, returns a zero-copy view of the
+  native-endian u32 string lengths. Pins the buffer memory like
+  `buffer_view/3`.
+  """
+  @spec buffer_string_lengths(reference()) :: {:ok, binary()} | {:error, String.t()}
+  def buffer_string_lengths(buffer) when is_reference(buffer) do
+    NIF.nif_buffer_string_lengths(buffer)
+  end
+
+  defp buffer_range(_buffer, offset, size)
+       when is_integer(offset) and offset >= 0 and is_integer(size) and size >= 0,
+       do: {:ok, offset, size}
+
+  defp buffer_range(buffer, offset, nil) when is_integer(offset) and offset >= 0 do
+    %{length: length} = buffer_info(buffer)
+    {:ok, offset, max(length - offset, 0)}
+  end
+
+  defp buffer_range(buffer, nil, nil) do
+    %{length: length} = buffer_info(buffer)
+    {:ok, 0, length}
+  end
+
+  defp buffer_range(_buffer, _offset, _size), do: {:error, "invalid buffer range"}
+
+  # ===========================================================================
+  # Phase 15: zstd Transcoding
+  # ===========================================================================
+
+  @doc """
+  Recompresses zstd data as a single OpenZL frame through `ctx`.
+
+  `zstd_data` may hold several concatenated zstd frames. Decoding and
+  recompression happen in native memory, so the decompressed data never
+  becomes a BEAM binary. The result decompresses with `decompress/2`.
+
+  As with `decompress_auto/2`, the data may decode to at most 1024 times
+  its size (64 MiB for small inputs).
+  """
+  @spec transcode_zstd(reference(), binary()) :: {:ok, binary()} | {:error, String.t()}
+  def transcode_zstd(ctx, zstd_data) when is_reference(ctx) and is_binary(zstd_data) do
+    NIF.nif_transcode_zstd(ctx, zstd_data)
+  end
+
+  @doc """
+  Streams a `.zst` file into a new append log at `dst_path`.
+
+  Every `:chunk_size` bytes of decoded data (default
+  `#{@default_log_block_size}`) are compressed through `ctx` as one record
+  in its own log block, so memory use is bounded by one chunk whatever the
+  file size. Read the data back with `log_stream/2`; concatenating the
+  records gives the original content. `dst_path` is overwritten, and
+  removed again if the transcode fails.
+
+  Returns `{:ok, %{raw_bytes: n, log_bytes: n}}`. Runs on a dirty CPU
+  scheduler; `transcode_stats/0` reports progress while it runs.
+  """
+  @spec transcode_zstd_file(String.t(), String.t(), reference(), keyword()) ::
+          {:ok, map()} | {:error, String.t()}
+  def transcode_zstd_file(src_path, dst_path, ctx, opts \\ [])
+      when is_binary(src_path) and is_binary(dst_path) and is_reference(ctx) do
+    chunk_size = Keyword.get(opts, :chunk_size, @default_log_block_size)
+
+    with {:ok, raw_bytes, log_bytes} <-
+           NIF.nif_transcode_zstd_file(src_path, dst_path, ctx, chunk_size) do
+      {:ok, %{raw_bytes: raw_bytes, log_bytes: log_bytes}}
+    end
+  end
+
+  @doc """
+  Returns node-wide transcode counters since load.
+
+  `:jobs`, `:active` and `:failed` count transcode calls. `:zstd_bytes`,
+  `:raw_bytes` and `:openzl_bytes` are bytes read, decoded and written;
+  file transcodes update them per chunk, so polling shows progress.
+  `:time_us` is the total wall time of finished calls, and
+  `:throughput_mb_s` is decoded bytes per second of that time.
+  """
+  @spec transcode_stats() :: map()
+  def transcode_stats do
+    stats = NIF.nif_transcode_stats()
+
+    throughput =
+      if stats.time_us > 0, do: stats.raw_bytes / stats.time_us, else: 0.0
+
+    Map.put(stats, :throughput_mb_s, Float.round(throughput, 1))
+  end
+
+  # ===========================================================================
+  # Phase 17: Adaptive Codec
+  # ===========================================================================
+
+  @auto_objectives %{speed: 0, balanced: 1, ratio: 2}
+  @auto_codecs {:raw, :lz4, :zstd, :openzl, :openzl_numeric}
+
+  @doc """
+  Compresses `data` with whichever codec suits it best for `objective`.
+
+  A small sample of the payload (the whole payload up to 16 KiB) is
+  compressed with each candidate codec, and the one with the best mix of
+  ratio and speed wins:
+
+  - `:speed` — raw store or LZ4, weighing the measured probe time
+  - `:balanced` (default) — raw, LZ4, zstd or OpenZL through `ctx`,
+    weighing fixed nominal costs per codec
+  - `:ratio` — as `:balanced`, judged on size alone
+
+  `:balanced` and `:ratio` do not depend on timing, so the same input
+  always gets the same codec.
+
+  The choice is recorded in a one-byte header that `decompress_auto/2` reads,
+  and `auto_codec/1` reports. Pass `element_width: w` when `data` is a
+  native-endian numeric column to also try typed OpenZL compression.
+  """
+  @spec compress_auto(reference(), binary(), :speed | :balanced | :ratio, keyword()) ::
+          {:ok, binary()} | {:error, String.t()}
+  def compress_auto(ctx, data, objective \\ :balanced, opts \\ [])
+      when is_reference(ctx) and is_binary(data) and is_map_key(@auto_objectives, objective) do
+    element_width = Keyword.get(opts, :element_width, 0)
+    NIF.nif_compress_auto(ctx, data, Map.fetch!(@auto_objectives, objective), element_width)
+  end
+
+  @doc """
+  Decompresses the output of `compress_auto/4`.
+
+  A zstd payload may decode to at most 1024 times its size (64 MiB for
+  small payloads); anything larger is refused as a likely bomb.
+  """
+  @spec decompress_auto(reference(), binary()) :: {:ok, binary()} | {:error, String.t()}
+  def decompress_auto(dctx, data) when is_reference(dctx) and is_binary(data) do
+    NIF.nif_decompress_auto(dctx, data)
+  end
+
+  @doc """
+  Returns the codec recorded in a `compress_auto/4` result:
+  `:raw`, `:lz4`, `:zstd`, `:openzl` or `:openzl_numeric`.
+  """
+  @spec auto_codec(binary()) :: {:ok, atom()} | {:error, String.t()}
+  def auto_codec(<<tag, _::binary>>) when tag < tuple_size(@auto_codecs),
+    do: {:ok, elem(@auto_codecs, tag)}
+
+  def auto_codec(_data), do: {:error, "not a compress_auto envelope"}
+
+  @doc """
+  Returns node-wide `compress_auto/4` counters: `:selected`, a map from
+  codec to how often it won, plus `:bytes_in` and `:bytes_out`.
+  """
+  @spec auto_stats() :: map()
+  def auto_stats, do: NIF.nif_auto_stats()
+
+  # ===========================================================================
+  # Phase 19: Recompaction
+  # ===========================================================================
+
+  @doc """
+  Recompresses frames with `target_ctx`'s compressor and level, without
+  moving the decoded data through BEAM binaries.
+
+  Each frame is decoded natively and re-encoded with its output types kept,
+  so typed and multi-typed frames stay typed. A frame that would not get
+  smaller is returned unchanged. The work is spread over native threads,
+  each with its own contexts configured like `target_ctx`.
+
+  Options:
+  - `:threads` — worker threads (default `System.schedulers_online/0`)
+
+  Returns `{:ok, frames, stats}`, with frames in input order. `stats` holds
+  `:frames`, `:kept` (frames returned unchanged), `:bytes_in`, `:bytes_out`,
+  `:bytes_saved`, `:cpu_us` (CPU time summed over threads), `:wall_us` and
+  `:threads`.
+
+      {:ok, archive} = ExOpenzl.create_compression_context()
+      :ok = ExOpenzl.set_compression_level(archive, 19)
+      {:ok, frames, %{bytes_saved: saved}} = ExOpenzl.recompact(frames, archive)
+  """
+  @spec recompact([binary()], reference(), keyword()) ::
+          {:ok, [binary()], map()} | {:error, String.t()}
+  def recompact(frames, target_ctx, opts \\ [])
+      when is_list(frames) and is_reference(target_ctx) do
+    threads = Keyword.get(opts, :threads, System.schedulers_online())
+    NIF.nif_recompact(frames, target_ctx, threads)
+  end
+
+  # ===========================================================================
+  # Phase 20: Frame Merging
+  # ===========================================================================
+
+  @doc """
+  Merges frames that share an output layout into one frame.
+
+  Every frame must have the same number of outputs, with matching types and
+  element widths, as produced by repeated `compress_multi_typed/2` calls
+  with the same schema. Each output column is concatenated across frames in
+  order (string lengths included) in native memory and re-encoded once
+  through `cctx`, so many small frames compress like one large one.
+
+      {:ok, hourly} = ExOpenzl.merge_multi_typed(dctx, cctx, minute_frames)
+      {:ok, columns} = ExOpenzl.decompress_multi_typed(dctx, hourly)
+  """
+  @spec merge_multi_typed(reference(), reference(), [binary()]) ::
+          {:ok, binary()} | {:error, String.t()}
+  def merge_multi_typed(dctx, cctx, frames)
+      when is_reference(dctx) and is_reference(cctx) and is_list(frames) do
+    NIF.nif_merge_multi_typed(dctx, cctx, frames)
+  end
+
+  # ===========================================================================
+  # Phase 21: Chunked Frames
+  # ===========================================================================
+
+  @default_chunk_size 65_536
+
+  @doc """
+  Compresses `data` as a container of independently decodable chunks.
+
+  Each `:chunk_size` bytes of input (default #{div(@default_chunk_size, 1024)} KiB)
+  becomes its own frame, listed in a small index, so `decompress_prefix/4`
+  can decode just the chunks it needs. Smaller chunks make prefix reads
+  cheaper at some cost in ratio. `decompress/1,2` decode the whole container.
+  """
+  @spec compress_chunked(reference(), binary(), keyword()) ::
+          {:ok, binary()} | {:error, String.t()}
+  def compress_chunked(ctx, data, opts \\ []) when is_reference(ctx) and is_binary(data) do
+    chunk_size = Keyword.get(opts, :chunk_size, @default_chunk_size)
+    NIF.nif_compress_chunked(ctx, data, chunk_size)
+  end
+
+  @doc """
+  Decompresses at most `max_bytes` of `data`, starting at decoded offset
+  `from`.
+
+  Returns `{:ok, bytes, next}`, where `next` is the offset to pass back for
+  the following page, or `:eof` once the end is reached:
+
+      {:ok, page, next} = ExOpenzl.decompress_prefix(dctx, segment, 16_384)
+      {:ok, page2, _} = ExOpenzl.decompress_prefix(dctx, segment, 16_384, next)
+
+  For `compress_chunked/3` containers only the chunks overlapping the
+  requested range are decoded. Other frames cannot stop early, so they are
+  decoded in full and sliced.
+  """
+  @spec decompress_prefix(reference(), binary(), pos_integer(), non_neg_integer()) ::
+          {:ok, binary(), non_neg_integer() | :eof} | {:error, String.t()}
+  def decompress_prefix(dctx, data, max_bytes, from \\ 0)
+      when is_reference(dctx) and is_binary(data) and is_integer(max_bytes) and max_bytes > 0 and
+             is_integer(from) and from >= 0 do
+    NIF.nif_decompress_prefix(dctx, data, max_bytes, from)
+  end
+
+  # ===========================================================================
+  # Phase 22: Integrity Verification
+  # ===========================================================================
+
+  @doc """
+  Checks that `data` is intact without returning its contents.
+
+  Accepts anything `decompress/2` does. By default only frame headers and
+  container indexes are checked. With `full: true` every output is decoded
+  into per-thread native scratch space and discarded, which also checks any
+  content and compressed checksums the frame carries, without building a
+  decompressed binary.
+
+  Returns `:ok` or `{:error, reason}`.
+  """
+  @spec verify(binary(), keyword()) :: :ok | {:error, String.t()}
+  def verify(data, opts \\ []) when is_binary(data) do
+    case NIF.nif_verify(data, Keyword.get(opts, :full, false)) do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Verifies every file below `path` on native threads.
+
+  Append logs, columnar files and `compress_chunked/3` containers are read
+  and checked one frame at a time, so their size is not limited by memory.
+  Any other file must hold a single payload as accepted by `verify/2`; it
+  is read whole, and one larger than 1 GiB is reported as a failure rather
+  than buffered. Symlinks are not followed.
+
+  Options:
+  - `:full` — decode everything as in `verify/2` (default `true`); `false`
+    checks headers only
+  - `:threads` — worker threads (default `System.schedulers_online()`)
+  - `:max_bytes_per_sec` — cap on the combined read rate, to leave I/O for
+    live traffic (default unthrottled)
+
+  Returns `{:ok, stats}`, where `stats` has `:files`, `:frames`, `:bytes`,
+  `:failed`, `:wall_us`, `:threads`, and `:failures`, a list of
+  `{path, reason}` for each file that failed.
+  """
+  @spec scrub_dir(String.t(), keyword()) :: {:ok, map()} | {:error, String.t()}
+  def scrub_dir(path, opts \\ []) when is_binary(path) do
+    full = Keyword.get(opts, :full, true)
+    threads = Keyword.get(opts, :threads, System.schedulers_online())
+    rate = Keyword.get(opts, :max_bytes_per_sec) || 0
+
+    case NIF.nif_scrub_dir(path, full, threads, rate) do
+      {:ok, stats, failures} -> {:ok, Map.put(stats, :failures, failures)}
+      {:error, _} = err -> err
+    end
+  end
+
+  # ===========================================================================
+  # Phase 23: Content Hashing
+  # ===========================================================================
+
+  @doc """
+  Like `compress/2`, but also returns the XXH64 hash (seed 0) of `data`.
+
+  This is a convenience wrapper, not a fused hash: OpenZL compresses in one
+  shot, so the hash is a second native pass over `data` within the same
+  call. It saves dedup keys and ETags a hashing step from Elixir, not the
+  pass itself.
+
+      {:ok, frame, hash} = ExOpenzl.compress_hashed(ctx, body)
+      etag = Integer.to_string(hash, 16)
+  """
+  @spec compress_hashed(reference(), binary()) ::
+          {:ok, binary(), non_neg_integer()} | {:error, String.t()}
+  def compress_hashed(ctx, data) when is_reference(ctx) and is_binary(data) do
+    NIF.nif_compress_hashed(ctx, data)
+  end
+
+  @doc """
+  Like `decompress/2`, but also returns the XXH64 hash (seed 0) of the
+  decompressed data, matching `compress_hashed/2`.
+
+  `compress_chunked/3` containers are hashed chunk by chunk while each
+  decoded chunk is still in cache. OpenZL frames and LZ4 envelopes have no
+  chunked decode, so for them this is a convenience wrapper: the hash is a
+  second native pass over the whole output once it is decoded.
+  """
+  @spec decompress_hashed(reference(), binary()) ::
+          {:ok, binary(), non_neg_integer()} | {:error, String.t()}
+  def decompress_hashed(dctx, data) when is_reference(dctx) and is_binary(data) do
+    NIF.nif_decompress_hashed(dctx, data)
+  end
+
+  # ===========================================================================
+  # Phase 24: Compressed Key-Value Cache
+  # ===========================================================================
+
+  # Cache values up to this raw size are coded on the calling scheduler
+  @kv_inline_limit 32_768
+
+  @doc """
+  Creates a native key-value cache that holds values compressed.
+
+  Keys are spread over shards, each with its own lock and LRU order. The
+  lock only covers bookkeeping: values are compressed before it is taken
+  and decompressed after it is released, so one large entry does not hold
+  up other callers on the same shard. Once a shard's share of
+  `:max_bytes` is used, its least recently used entries are evicted. Values
+  that do not shrink are kept uncompressed.
+
+  Options:
+  - `:max_bytes` (required) — cap on stored key and value bytes
+  - `:shards` — number of shards (default 16)
+  - `:ctx` — compression context whose level and attached compressor the
+    cache copies when created; later changes to `:ctx` do not affect it
+    (default: a fresh context)
+
+  Values up to #{div(@kv_inline_limit, 1024)} KiB are compressed and
+  decompressed on the calling scheduler; larger ones use a dirty scheduler.
+  """
+  @spec kv_new(keyword()) :: {:ok, reference()} | {:error, String.t()}
+  def kv_new(opts) when is_list(opts) do
+    max_bytes = Keyword.fetch!(opts, :max_bytes)
+    shards = Keyword.get(opts, :shards, 16)
+
+    with {:ok, ctx} <- kv_template(opts) do
+      NIF.nif_kv_new(shards, max_bytes, ctx, @kv_inline_limit)
+    end
+  end
+
+  defp kv_template(opts) do
+    case Keyword.fetch(opts, :ctx) do
+      {:ok, ctx} when is_reference(ctx) -> {:ok, ctx}
+      :error -> create_compression_context()
+    end
+  end
+
+  @doc """
+  Stores `value` under `key`, replacing any previous value.
+  """
+  @spec kv_put(reference(), binary(), binary()) :: :ok | {:error, String.t()}
+  def kv_put(cache, key, value)
+      when is_reference(cache) and is_binary(key) and is_binary(value) do
+    result =
+      if byte_size(value) <= @kv_inline_limit do
+        NIF.nif_kv_put(cache, key, value)
+      else
+        NIF.nif_kv_put_dirty(cache, key, value)
+      end
+
+    case result do
+      {:ok, :ok} -> :ok
+      {:error, _} = err -> err
+    end
+  end
+
+  @doc """
+  Fetches and decompresses the value stored under `key`.
+
+  Returns `{:ok, value}` or `:error` when the key is absent or was evicted.
+  """
+  @spec kv_get(reference(), binary()) :: {:ok, binary()} | :error | {:error, String.t()}
+  def kv_get(cache, key) when is_reference(cache) and is_binary(key) do
+    case NIF.nif_kv_get(cache, key) do
+      :large -> NIF.nif_kv_get_dirty(cache, key) |> kv_result()
+      result -> kv_result(result)
+    end
+  end
+
+  defp kv_result(:miss), do: :error
+  defp kv_result(result), do: result
+
+  @doc """
+  Removes `key` from the cache. Returns `:ok` whether or not it was present.
+  """
+  @spec kv_delete(reference(), binary()) :: :ok
+  def kv_delete(cache, key) when is_reference(cache) and is_binary(key) do
+    NIF.nif_kv_delete(cache, key)
+  end
+
+  @doc """
+  Returns cache counters summed over shards: `:entries`, `:bytes` (stored),
+  `:raw_bytes`, `:max_bytes`, `:hits`, `:misses`, `:evictions`, `:shards`
+  and `:ratio` (raw bytes per stored byte).
+  """
+  @spec kv_stats(reference()) :: map()
+  def kv_stats(cache) when is_reference(cache), do: NIF.nif_kv_stats(cache)
 end
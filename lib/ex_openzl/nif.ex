@@ -21,16 +21,139 @@ defmodule ExOpenzl.NIF do
   def nif_set_compression_level(_ctx, _level), do: :erlang.nif_error(:not_loaded)
 
   # Phase 2: Typed Compression
-  def nif_compress_typed_numeric(_ctx, _data, _element_width), do: :erlang.nif_error(:not_loaded)
+  def nif_compress_typed_numeric(_ctx, _data, _element_width, _byte_swap),
+    do: :erlang.nif_error(:not_loaded)
+
   def nif_compress_typed_struct(_ctx, _data, _struct_width), do: :erlang.nif_error(:not_loaded)
-  def nif_compress_typed_string(_ctx, _data, _lengths_bin), do: :erlang.nif_error(:not_loaded)
+  def nif_compress_typed_string(_ctx, _data, _lengths_bin, _lengths_format),
+    do: :erlang.nif_error(:not_loaded)
   def nif_compress_multi_typed(_ctx, _inputs), do: :erlang.nif_error(:not_loaded)
-  def nif_decompress_typed(_ctx, _compressed), do: :erlang.nif_error(:not_loaded)
-  def nif_decompress_multi_typed(_ctx, _compressed), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_typed(_ctx, _compressed, _byte_swap), do: :erlang.nif_error(:not_loaded)
+
+  def nif_decompress_multi_typed(_ctx, _compressed, _byte_swap),
+    do: :erlang.nif_error(:not_loaded)
+
   def nif_frame_info(_compressed), do: :erlang.nif_error(:not_loaded)
 
   # Phase 3: SDDL Compressor
   def nif_sddl_compile(_source), do: :erlang.nif_error(:not_loaded)
+  def nif_sddl_cache_stats, do: :erlang.nif_error(:not_loaded)
+  def nif_sddl_cache_clear, do: :erlang.nif_error(:not_loaded)
   def nif_create_sddl_compressor(_compiled), do: :erlang.nif_error(:not_loaded)
   def nif_set_compressor(_ctx, _compressor), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 4: Append Log
+  def nif_log_open(_path, _ctx, _block_size), do: :erlang.nif_error(:not_loaded)
+  def nif_log_append(_log, _records), do: :erlang.nif_error(:not_loaded)
+  def nif_log_flush(_log), do: :erlang.nif_error(:not_loaded)
+  def nif_log_close(_log), do: :erlang.nif_error(:not_loaded)
+  def nif_log_info(_log), do: :erlang.nif_error(:not_loaded)
+  def nif_log_reader_open(_path), do: :erlang.nif_error(:not_loaded)
+  def nif_log_reader_info(_reader), do: :erlang.nif_error(:not_loaded)
+  def nif_log_read_block(_reader, _dctx, _index), do: :erlang.nif_error(:not_loaded)
+  def nif_log_read_record(_reader, _dctx, _n), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 5: Multi-Series Packing
+  def nif_pack_series(_ctx, _series, _value_width), do: :erlang.nif_error(:not_loaded)
+  def nif_unpack_series(_dctx, _compressed, _id), do: :erlang.nif_error(:not_loaded)
+  def nif_unpack_all_series(_dctx, _compressed), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 6: Tensor Compression
+  def nif_compress_tensor(_ctx, _data, _kind, _bits, _shape), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_tensor(_dctx, _compressed), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 7: Arrow Record Batches
+  def nif_compress_record_batch(_ctx, _columns), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_record_batch(_dctx, _compressed), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 8: Columnar Files
+  def nif_columnar_open(_path, _ctx, _schema), do: :erlang.nif_error(:not_loaded)
+  def nif_columnar_write_row_group(_writer, _columns), do: :erlang.nif_error(:not_loaded)
+  def nif_columnar_close(_writer), do: :erlang.nif_error(:not_loaded)
+  def nif_columnar_open_reader(_path), do: :erlang.nif_error(:not_loaded)
+  def nif_columnar_metadata(_reader), do: :erlang.nif_error(:not_loaded)
+
+  def nif_columnar_read(_reader, _dctx, _columns, _row_groups),
+    do: :erlang.nif_error(:not_loaded)
+
+  # Phase 9: SDDL Columns
+  def nif_decompress_sddl_columns(_dctx, _compressed, _source),
+    do: :erlang.nif_error(:not_loaded)
+
+  # Phase 10: SDDL Introspection
+  def nif_sddl_describe(_source, _sample), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 11: SDDL Record-Type Dispatch
+  def nif_create_dispatch_compressor(_types), do: :erlang.nif_error(:not_loaded)
+  def nif_compress_dispatch(_dispatcher, _data), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_dispatch(_dctx, _compressed), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 12: Build Info
+  def nif_build_info, do: :erlang.nif_error(:not_loaded)
+
+  # Phase 13: Column Filtering
+  def nif_filter_range(_data, _kind, _width, _min, _max), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 14: Native Buffers
+  def nif_buffer_new(_capacity), do: :erlang.nif_error(:not_loaded)
+  def nif_buffer_info(_buffer), do: :erlang.nif_error(:not_loaded)
+  def nif_buffer_reset(_buffer), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_into(_dctx, _compressed, _buffer), do: :erlang.nif_error(:not_loaded)
+  def nif_buffer_view(_buffer, _offset, _size), do: :erlang.nif_error(:not_loaded)
+  def nif_buffer_copy(_buffer, _offset, _size), do: :erlang.nif_error(:not_loaded)
+  def nif_buffer_string_lengths(_buffer), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 15: zstd Transcoding
+  def nif_transcode_zstd(_ctx, _zstd_data), do: :erlang.nif_error(:not_loaded)
+
+  def nif_transcode_zstd_file(_src_path, _dst_path, _ctx, _chunk_size),
+    do: :erlang.nif_error(:not_loaded)
+
+  def nif_transcode_stats, do: :erlang.nif_error(:not_loaded)
+
+  # Phase 16: LZ4 Fast Mode
+  def nif_compress_fast(_data, _acceleration), do: :erlang.nif_error(:not_loaded)
+  def nif_compress_fast_dirty(_data, _acceleration), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_fast(_envelope), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 17: Adaptive Codec
+  def nif_compress_auto(_ctx, _data, _objective, _element_width),
+    do: :erlang.nif_error(:not_loaded)
+
+  def nif_decompress_auto(_dctx, _data), do: :erlang.nif_error(:not_loaded)
+  def nif_auto_stats, do: :erlang.nif_error(:not_loaded)
+
+  # Phase 18: Deadline-Bounded Compression
+  def nif_compress_deadline(_ctx, _data, _deadline_us), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 19: Recompaction
+  def nif_recompact(_frames, _target_ctx, _threads), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 20: Frame Merging
+  def nif_merge_multi_typed(_dctx, _cctx, _frames), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 21: Chunked Frames
+  def nif_compress_chunked(_ctx, _data, _chunk_size), do: :erlang.nif_error(:not_loaded)
+
+  def nif_decompress_prefix(_dctx, _data, _max_bytes, _from),
+    do: :erlang.nif_error(:not_loaded)
+
+  # Phase 22: Integrity Verification
+  def nif_verify(_data, _full), do: :erlang.nif_error(:not_loaded)
+
+  def nif_scrub_dir(_path, _full, _threads, _max_bytes_per_sec),
+    do: :erlang.nif_error(:not_loaded)
+
+  # Phase 23: Content Hashing
+  def nif_compress_hashed(_ctx, _data), do: :erlang.nif_error(:not_loaded)
+  def nif_decompress_hashed(_dctx, _data), do: :erlang.nif_error(:not_loaded)
+
+  # Phase 24: Compressed Key-Value Cache
+  def nif_kv_new(_shards, _max_bytes, _ctx, _inline_limit), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_put(_cache, _key, _value), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_put_dirty(_cache, _key, _value), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_get(_cache, _key), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_get_dirty(_cache, _key), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_delete(_cache, _key), do: :erlang.nif_error(:not_loaded)
+  def nif_kv_stats(_cache), do: :erlang.nif_error(:not_loaded)
 end
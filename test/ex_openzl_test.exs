@@ -8,6 +8,17 @@ defmodule ExOpenzlTest do
     end
   end
 
+  describe "build_info/0" do
+    test "reports the kernel ISA and CPU features" do
+      info = ExOpenzl.build_info()
+      assert info.openzl_version == ExOpenzl.version()
+      assert info.kernel_isa == :baseline
+      assert is_list(info.cpu_features)
+      assert Enum.all?(info.cpu_features, &is_atom/1)
+      assert is_binary(info.compiler)
+    end
+  end
+
   describe "compress/1 and decompress/1" do
     test "roundtrips binary data" do
       original = "Hello, OpenZL! This is a test of format-aware compression."
@@ -228,6 +239,51 @@ defmodule ExOpenzlTest do
     end
   end
 
+  describe "compress_typed/3 - endianness" do
+    test "big-endian input compresses like native and round-trips" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      native = for i <- 1..1_000, into: <<>>, do: <<1_700_000_000 + i::native-unsigned-64>>
+      big = for i <- 1..1_000, into: <<>>, do: <<1_700_000_000 + i::big-unsigned-64>>
+
+      assert {:ok, from_big} = ExOpenzl.compress_typed(cctx, {:numeric, big, 8}, endianness: :big)
+      assert {:ok, from_native} = ExOpenzl.compress_typed(cctx, {:numeric, native, 8})
+      assert from_big == from_native
+
+      assert {:ok, %{data: ^native}} = ExOpenzl.decompress_typed(dctx, from_big)
+      assert {:ok, %{data: ^big}} = ExOpenzl.decompress_typed(dctx, from_big, endianness: :big)
+    end
+
+    test "applies to each numeric output of a multi-typed frame" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      u16 = for i <- 1..100, into: <<>>, do: <<i::native-16>>
+      u32 = for i <- 1..100, into: <<>>, do: <<i * 7::native-32>>
+      {:ok, frame} = ExOpenzl.compress_multi_typed(cctx, [{:numeric, u16, 2}, {:numeric, u32, 4}])
+
+      assert {:ok, [a, b]} = ExOpenzl.decompress_multi_typed(dctx, frame, endianness: :big)
+      assert a.data == for(i <- 1..100, into: <<>>, do: <<i::big-16>>)
+      assert b.data == for(i <- 1..100, into: <<>>, do: <<i * 7::big-32>>)
+    end
+
+    test "native and same-order endianness leave data untouched" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      data = for i <- 1..10, into: <<>>, do: <<i::native-32>>
+
+      {:ok, c} =
+        ExOpenzl.compress_typed(cctx, {:numeric, data, 4}, endianness: System.endianness())
+
+      assert {:ok, %{data: ^data}} = ExOpenzl.decompress_typed(dctx, c, endianness: :native)
+
+      assert_raise ArgumentError, fn ->
+        ExOpenzl.compress_typed(cctx, {:numeric, data, 4}, endianness: :middle)
+      end
+    end
+  end
+
   describe "compress_typed/2 - struct" do
     test "roundtrips fixed-width struct data" do
       {:ok, cctx} = ExOpenzl.create_compression_context()
@@ -350,6 +406,118 @@ defmodule ExOpenzlTest do
     end
   end
 
+  describe "compress_typed/3 - string lengths formats" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      strings = for i <- 1..300, do: String.duplicate("s", rem(i * 37, 200))
+      %{cctx: cctx, dctx: dctx, strings: strings, concat: Enum.join(strings)}
+    end
+
+    test "accepts every format and decodes identically", ctx do
+      %{cctx: cctx, dctx: dctx, strings: strings, concat: concat} = ctx
+      sizes = Enum.map(strings, &byte_size/1)
+      offsets = Enum.scan([0 | sizes], &(&1 + &2))
+
+      u32 = for n <- sizes, into: <<>>, do: <<n::native-32>>
+      {:ok, expected} = ExOpenzl.compress_typed(cctx, {:string, concat, u32})
+
+      for {format, lengths} <- [
+            u64: for(n <- sizes, into: <<>>, do: <<n::native-64>>),
+            varint: for(n <- sizes, into: <<>>, do: leb128(n)),
+            offsets32: for(o <- offsets, into: <<>>, do: <<o::native-32>>),
+            offsets64: for(o <- offsets, into: <<>>, do: <<o::native-64>>)
+          ] do
+        assert {:ok, ^expected} =
+                 ExOpenzl.compress_typed(cctx, {:string, concat, lengths},
+                   lengths_format: format
+                 )
+      end
+
+      assert {:ok, %{data: ^concat}} = ExOpenzl.decompress_typed(dctx, expected)
+    end
+
+    test "reads fixed-width lengths and offsets in native byte order", %{cctx: cctx} do
+      # The same values in the other byte order are a different length
+      # (3 <-> 0x03000000), so they no longer add up to the data size
+      foreign =
+        if <<1::native-16>> == <<1::little-16>>,
+          do: fn n, bits -> <<n::big-size(bits)>> end,
+          else: fn n, bits -> <<n::little-size(bits)>> end
+
+      for {format, bits, lengths} <- [
+            {:u32, 32, [3, 2]},
+            {:u64, 64, [3, 2]},
+            {:offsets32, 32, [0, 3, 5]},
+            {:offsets64, 64, [0, 3, 5]}
+          ] do
+        native = for n <- lengths, into: <<>>, do: <<n::native-size(bits)>>
+        swapped = for n <- lengths, into: <<>>, do: foreign.(n, bits)
+
+        assert {:ok, _} =
+                 ExOpenzl.compress_typed(cctx, {:string, "abcde", native}, lengths_format: format)
+
+        assert {:error, _} =
+                 ExOpenzl.compress_typed(cctx, {:string, "abcde", swapped},
+                   lengths_format: format
+                 )
+      end
+    end
+
+    test "accepts unaligned u32 lengths", %{cctx: cctx, dctx: dctx} do
+      <<_, lengths::binary>> = <<0, 3::native-32, 2::native-32>>
+      {:ok, frame} = ExOpenzl.compress_typed(cctx, {:string, "abcde", lengths})
+      assert {:ok, %{string_lengths: <<3::native-32, 2::native-32>>}} =
+               ExOpenzl.decompress_typed(dctx, frame)
+    end
+
+    test "sliced offsets select part of the data", %{cctx: cctx, dctx: dctx} do
+      offsets = <<3::native-32, 5::native-32, 9::native-32>>
+
+      {:ok, frame} =
+        ExOpenzl.compress_typed(cctx, {:string, "xxxabcdefyy", offsets},
+          lengths_format: :offsets32
+        )
+
+      assert {:ok, %{data: "abcdef", string_lengths: <<2::native-32, 4::native-32>>}} =
+               ExOpenzl.decompress_typed(dctx, frame)
+    end
+
+    test "works in multi-typed frames", %{cctx: cctx, dctx: dctx} do
+      inputs = [{:numeric, <<1::native-32>>, 4}, {:string, "abcd", {:varint, <<1, 3>>}}]
+      {:ok, frame} = ExOpenzl.compress_multi_typed(cctx, inputs)
+
+      assert {:ok, [_, %{data: "abcd", string_lengths: <<1::native-32, 3::native-32>>}]} =
+               ExOpenzl.decompress_multi_typed(dctx, frame)
+    end
+
+    test "rejects inconsistent or oversized lengths", %{cctx: cctx} do
+      assert {:error, _} = ExOpenzl.compress_typed(cctx, {:string, "abc", <<5::native-32>>})
+
+      assert {:error, _} =
+               ExOpenzl.compress_typed(cctx, {:string, "abc", <<8_589_934_592::native-64>>},
+                 lengths_format: :u64
+               )
+
+      assert {:error, _} =
+               ExOpenzl.compress_typed(cctx, {:string, "abc", <<0x80>>}, lengths_format: :varint)
+
+      assert {:error, _} =
+               ExOpenzl.compress_typed(
+                 cctx,
+                 {:string, "abc", <<2::native-32, 1::native-32>>},
+                 lengths_format: :offsets32
+               )
+
+      assert_raise ArgumentError, fn ->
+        ExOpenzl.compress_typed(cctx, {:string, "abc", <<3::native-32>>}, lengths_format: :u16)
+      end
+    end
+  end
+
+  defp leb128(n) when n < 128, do: <<n>>
+  defp leb128(n), do: <<1::1, rem(n, 128)::7, leb128(div(n, 128))::binary>>
+
   describe "compress_multi_typed/2 and decompress_multi_typed/2" do
     test "roundtrips multiple typed inputs in one frame" do
       {:ok, cctx} = ExOpenzl.create_compression_context()
@@ -669,6 +837,23 @@ defmodule ExOpenzlTest do
       assert {:ok, compiled} = ExOpenzl.sddl_compile(source)
       assert is_binary(compiled)
     end
+
+    test "caches compiled output by source" do
+      source = "Row = {\nUInt32LE\nUInt16LE\n}\n: Row[_rem / 6]\n"
+      :ok = ExOpenzl.sddl_cache_clear()
+
+      assert {:ok, compiled} = ExOpenzl.sddl_compile(source)
+      assert %{misses: 1, hits: 0, compiles: 1, entries: 1} = ExOpenzl.sddl_cache_stats()
+
+      assert {:ok, ^compiled} = ExOpenzl.sddl_compile(source)
+      assert %{misses: 1, hits: 1, compiles: 1} = ExOpenzl.sddl_cache_stats()
+
+      assert {:error, _} = ExOpenzl.sddl_compile("invalid !@#$ syntax {{{")
+      assert %{misses: 2, compiles: 1, entries: 1} = ExOpenzl.sddl_cache_stats()
+
+      :ok = ExOpenzl.sddl_cache_clear()
+      assert %{entries: 0, hits: 0, misses: 0, compile_time_us: 0} = ExOpenzl.sddl_cache_stats()
+    end
   end
 
   describe "create_sddl_compressor/1" do
@@ -797,4 +982,1343 @@ defmodule ExOpenzlTest do
       assert {:ok, ^records} = ExOpenzl.decompress(dctx, compressed)
     end
   end
+
+  # ===========================================================================
+  # Phase 4: Append Log
+  # ===========================================================================
+
+  describe "append log" do
+    @describetag :tmp_dir
+
+    test "roundtrips records through blocks", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "roundtrip.log")
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      records = for i <- 1..1_000, do: "event #{i} user=#{rem(i, 17)} status=ok"
+
+      assert {:ok, log} = ExOpenzl.log_open(path, cctx, block_size: 4_096)
+      assert {:ok, 0} = ExOpenzl.log_append(log, Enum.take(records, 500))
+      assert {:ok, 500} = ExOpenzl.log_append(log, Enum.drop(records, 500))
+      assert ExOpenzl.log_info(log).block_count > 1
+      assert :ok = ExOpenzl.log_close(log)
+
+      assert {:ok, reader} = ExOpenzl.log_reader_open(path)
+      assert %{record_count: 1_000, block_count: blocks} = ExOpenzl.log_reader_info(reader)
+      assert blocks > 1
+      assert Enum.to_list(ExOpenzl.log_stream(reader, dctx)) == records
+
+      assert {:ok, first_block} = ExOpenzl.log_read_block(reader, dctx, 0)
+      assert first_block == Enum.take(records, length(first_block))
+    end
+
+    test "indexed reads return the requested record", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "indexed.log")
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, log} = ExOpenzl.log_open(path, cctx, block_size: 256)
+      for i <- 0..199, do: {:ok, ^i} = ExOpenzl.log_append(log, "record-#{i}")
+      :ok = ExOpenzl.log_close(log)
+
+      {:ok, reader} = ExOpenzl.log_reader_open(path)
+
+      for n <- [0, 1, 57, 128, 199] do
+        expected = "record-#{n}"
+        assert {:ok, ^expected} = ExOpenzl.log_read_record(reader, dctx, n)
+      end
+
+      assert {:error, _} = ExOpenzl.log_read_record(reader, dctx, 200)
+      assert {:error, _} = ExOpenzl.log_read_block(reader, dctx, 10_000)
+    end
+
+    test "reopening appends after existing blocks", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "reopen.log")
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, log} = ExOpenzl.log_open(path, cctx)
+      {:ok, 0} = ExOpenzl.log_append(log, ["a", "b"])
+      :ok = ExOpenzl.log_close(log)
+
+      {:ok, log} = ExOpenzl.log_open(path, cctx)
+      assert {:ok, 2} = ExOpenzl.log_append(log, ["c"])
+      :ok = ExOpenzl.log_close(log)
+
+      {:ok, reader} = ExOpenzl.log_reader_open(path)
+      assert Enum.to_list(ExOpenzl.log_stream(reader, dctx)) == ["a", "b", "c"]
+    end
+
+    test "flushed blocks are readable without a footer", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "unclosed.log")
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, log} = ExOpenzl.log_open(path, cctx)
+      {:ok, 0} = ExOpenzl.log_append(log, ["x", "", "z"])
+      assert :ok = ExOpenzl.log_flush(log)
+
+      {:ok, reader} = ExOpenzl.log_reader_open(path)
+      assert Enum.to_list(ExOpenzl.log_stream(reader, dctx)) == ["x", "", "z"]
+      :ok = ExOpenzl.log_close(log)
+    end
+
+    test "rescans blocks when footer entries point outside the log", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "bad_footer.log")
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, log} = ExOpenzl.log_open(path, cctx)
+      {:ok, 0} = ExOpenzl.log_append(log, ["a", "b"])
+      :ok = ExOpenzl.log_close(log)
+
+      # Point the only index entry far past the end of the file
+      data = File.read!(path)
+      entry_at = byte_size(data) - 8 - 16
+      <<head::binary-size(entry_at), _offset::64, rest::binary>> = data
+      File.write!(path, <<head::binary, 0x100_0000_0000::little-64, rest::binary>>)
+
+      {:ok, reader} = ExOpenzl.log_reader_open(path)
+      assert Enum.to_list(ExOpenzl.log_stream(reader, dctx)) == ["a", "b"]
+    end
+
+    test "rejects operations on a closed log", %{tmp_dir: tmp_dir} do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, log} = ExOpenzl.log_open(Path.join(tmp_dir, "closed.log"), cctx)
+      :ok = ExOpenzl.log_close(log)
+      assert {:error, _} = ExOpenzl.log_append(log, "late")
+    end
+
+    test "returns error for a file that is not a log", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "not_a.log")
+      File.write!(path, "plain text")
+      assert {:error, _} = ExOpenzl.log_reader_open(path)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 5: Multi-Series Packing
+  # ===========================================================================
+
+  defp make_series(id, points) do
+    timestamps =
+      for i <- 1..points, into: <<>>, do: <<1_700_000_000 + i * 60::little-unsigned-64>>
+
+    values = for i <- 1..points, into: <<>>, do: <<id * 1_000 + rem(i, 7)::little-float-64>>
+    {id, timestamps, values}
+  end
+
+  describe "pack_series/3 and unpack_series/3" do
+    test "roundtrips many short series" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      series = for id <- 1..200, do: make_series(id, 60 + rem(id, 61))
+
+      assert {:ok, compressed} = ExOpenzl.pack_series(cctx, series)
+      assert {:ok, ^series} = ExOpenzl.unpack_all_series(dctx, compressed)
+    end
+
+    test "extracts a single series by id" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      series = for id <- [42, 7, 1_000_000, 3], do: make_series(id, 90)
+      {:ok, compressed} = ExOpenzl.pack_series(cctx, series)
+
+      expected = Enum.find(series, fn {id, _, _} -> id == 1_000_000 end)
+      assert {:ok, ^expected} = ExOpenzl.unpack_series(dctx, compressed, 1_000_000)
+      assert {:error, "series not found"} = ExOpenzl.unpack_series(dctx, compressed, 99)
+    end
+
+    test "one packed frame is smaller than per-series frames" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      series = for id <- 1..100, do: make_series(id, 60)
+
+      {:ok, packed} = ExOpenzl.pack_series(cctx, series)
+
+      separate =
+        Enum.reduce(series, 0, fn {_id, ts, vals}, acc ->
+          {:ok, c1} = ExOpenzl.compress_typed(cctx, {:numeric, ts, 8})
+          {:ok, c2} = ExOpenzl.compress_typed(cctx, {:numeric, vals, 8})
+          acc + byte_size(c1) + byte_size(c2)
+        end)
+
+      assert byte_size(packed) < separate
+    end
+
+    test "supports narrower value widths" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      ts = for i <- 1..10, into: <<>>, do: <<i::little-unsigned-64>>
+      vals = for i <- 1..10, into: <<>>, do: <<i::little-unsigned-16>>
+
+      {:ok, compressed} = ExOpenzl.pack_series(cctx, [{5, ts, vals}], 2)
+      assert {:ok, {5, ^ts, ^vals}} = ExOpenzl.unpack_series(dctx, compressed, 5)
+    end
+
+    test "returns errors for malformed input" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      assert {:error, _} = ExOpenzl.pack_series(cctx, [])
+      assert {:error, _} = ExOpenzl.pack_series(cctx, [{1, <<1::little-64>>, <<1, 2>>}])
+      assert {:error, _} = ExOpenzl.pack_series(cctx, [{1, <<1, 2, 3>>, <<>>}])
+      assert {:error, _} = ExOpenzl.pack_series(cctx, [{1, <<>>, <<>>}], 3)
+
+      {:ok, other} = ExOpenzl.compress_typed(cctx, {:numeric, <<1::little-64>>, 8})
+      assert {:error, _} = ExOpenzl.unpack_series(dctx, other, 1)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 6: Tensor Compression
+  # ===========================================================================
+
+  describe "compress_tensor/2 and decompress_tensor/2" do
+    # Nx is optional; these run only when it is available
+    @describetag :nx
+
+    test "roundtrips tensors of several types and shapes" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      tensors = [
+        Nx.iota({100, 8}, type: :f32),
+        Nx.iota({4, 5, 6}, type: :s64),
+        Nx.iota({256}, type: :u8),
+        Nx.iota({10, 10}, type: :bf16),
+        Nx.iota({3}, type: :f64),
+        Nx.complex(Nx.iota({6}, type: :f32), Nx.iota({6}, type: :f32))
+      ]
+
+      for tensor <- tensors do
+        assert {:ok, compressed} = ExOpenzl.compress_tensor(cctx, tensor)
+        assert {:ok, decoded} = ExOpenzl.decompress_tensor(dctx, compressed)
+        assert Nx.type(decoded) == Nx.type(tensor)
+        assert Nx.shape(decoded) == Nx.shape(tensor)
+        assert Nx.to_binary(decoded) == Nx.to_binary(tensor)
+      end
+    end
+
+    test "records the shape of scalars" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      tensor = Nx.tensor(42, type: :u32)
+      assert {:ok, compressed} = ExOpenzl.compress_tensor(cctx, tensor)
+      assert {:ok, decoded} = ExOpenzl.decompress_tensor(dctx, compressed)
+      assert Nx.shape(decoded) == {}
+      assert Nx.to_number(decoded) == 42
+    end
+
+    test "roundtrips tensors with no elements" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      tensor = Nx.broadcast(Nx.tensor(0.0, type: :f32), {0, 3})
+      assert {:ok, compressed} = ExOpenzl.compress_tensor(cctx, tensor)
+      assert {:ok, decoded} = ExOpenzl.decompress_tensor(dctx, compressed)
+      assert Nx.shape(decoded) == {0, 3}
+      assert Nx.type(decoded) == {:f, 32}
+    end
+
+    test "returns error for frames that are not tensors" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, plain} = ExOpenzl.compress_typed(cctx, {:numeric, <<1::little-64>>, 8})
+      assert {:error, _} = ExOpenzl.decompress_tensor(dctx, plain)
+      assert {:error, _} = ExOpenzl.decompress_tensor(dctx, <<>>)
+
+      # A header claiming f64 over 1-byte elements is rejected
+      header = for v <- [0x524F534E4554, 2, 64, 1, 4], into: <<>>, do: <<v::native-64>>
+
+      {:ok, mismatched} =
+        ExOpenzl.compress_multi_typed(cctx, [{:numeric, <<1, 2, 3, 4>>, 1}, {:numeric, header, 8}])
+
+      assert {:error, _} = ExOpenzl.decompress_tensor(dctx, mismatched)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 7: Arrow Record Batches
+  # ===========================================================================
+
+  describe "compress_record_batch/2 and decompress_record_batch/2" do
+    test "roundtrips fixed-width, utf8 and nullable columns" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      n = 100
+      ids = for i <- 1..n, into: <<>>, do: <<i::little-signed-64>>
+      prices = for i <- 1..n, into: <<>>, do: <<i * 0.25::little-float-64>>
+      names = for i <- 1..n, do: "name-#{i}"
+
+      {offsets, _} =
+        Enum.reduce(names, {<<0::little-signed-32>>, 0}, fn name, {acc, pos} ->
+          pos = pos + byte_size(name)
+          {<<acc::binary, pos::little-signed-32>>, pos}
+        end)
+
+      # Every fourth element is null
+      validity =
+        for chunk <- Enum.chunk_every(1..n, 8), into: <<>> do
+          byte =
+            chunk
+            |> Enum.with_index()
+            |> Enum.reduce(0, fn {i, bit}, acc ->
+              if rem(i, 4) == 0, do: acc, else: Bitwise.bor(acc, Bitwise.bsl(1, bit))
+            end)
+
+          <<byte>>
+        end
+
+      batch = [
+        %{name: "id", format: "l", length: n, buffers: [ids]},
+        %{name: "price", format: "g", length: n, validity: validity, buffers: [prices]},
+        %{name: "name", format: "u", length: n, buffers: [offsets, Enum.join(names)]}
+      ]
+
+      assert {:ok, compressed} = ExOpenzl.compress_record_batch(cctx, batch)
+      assert {:ok, [id_col, price_col, name_col]} =
+               ExOpenzl.decompress_record_batch(dctx, compressed)
+
+      assert %{name: "id", format: "l", length: ^n, validity: nil, buffers: [^ids]} = id_col
+      assert %{name: "price", validity: ^validity, null_count: 25, buffers: [^prices]} = price_col
+      assert name_col.buffers == [offsets, Enum.join(names)]
+    end
+
+    test "roundtrips large utf8 and fixed-size binary columns" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      offsets = <<0::little-64, 3::little-64, 3::little-64, 8::little-64>>
+      uuids = :binary.copy(<<1, 2, 3, 4>>, 12)
+
+      batch = [
+        %{name: "s", format: "U", length: 3, buffers: [offsets, "foohello"]},
+        %{name: "uuid", format: "w:16", length: 3, buffers: [uuids]}
+      ]
+
+      assert {:ok, compressed} = ExOpenzl.compress_record_batch(cctx, batch)
+      assert {:ok, [s, uuid]} = ExOpenzl.decompress_record_batch(dctx, compressed)
+      assert s.buffers == [offsets, "foohello"]
+      assert uuid.buffers == [uuids]
+    end
+
+    test "returns errors for unsupported or malformed columns" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      assert {:error, _} = ExOpenzl.compress_record_batch(cctx, [])
+
+      assert {:error, _} =
+               ExOpenzl.compress_record_batch(cctx, [
+                 %{name: "x", format: "+s", length: 1, buffers: []}
+               ])
+
+      assert {:error, _} =
+               ExOpenzl.compress_record_batch(cctx, [
+                 %{name: "x", format: "i", length: 4, buffers: [<<1, 2, 3, 4>>]}
+               ])
+
+      # Lengths whose byte sizes would wrap around 64 bits
+      huge = 0x4000_0000_0000_0000
+
+      for column <- [
+            %{name: "x", format: "u", length: huge, buffers: [<<0::32>>, ""]},
+            %{name: "x", format: "U", length: huge, buffers: [<<0::64>>, ""]},
+            %{name: "x", format: "l", length: huge, buffers: [<<0::64>>]},
+            %{name: "x", format: "w:16", length: huge, buffers: [<<0::128>>]},
+            %{name: "x", format: "b", length: 0xFFFF_FFFF_FFFF_FFFF, buffers: [<<0>>]},
+            %{name: "x", format: "c", length: huge, validity: <<0>>, buffers: [<<0::64>>]}
+          ] do
+        assert {:error, _} = ExOpenzl.compress_record_batch(cctx, [column])
+      end
+
+      {:ok, other} = ExOpenzl.compress_typed(cctx, {:numeric, <<1::little-64>>, 8})
+      assert {:error, _} = ExOpenzl.decompress_record_batch(dctx, other)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 8: Columnar Files
+  # ===========================================================================
+
+  defp write_columnar(path, groups) do
+    {:ok, cctx} = ExOpenzl.create_compression_context()
+
+    {:ok, writer} =
+      ExOpenzl.columnar_open(path, cctx, [
+        {"ts", {:uint, 8}},
+        {"temp", {:float, 8}},
+        {"delta", {:int, 4}},
+        {"host", :string}
+      ])
+
+    for group <- groups, do: :ok = ExOpenzl.columnar_write_row_group(writer, group)
+    :ok = ExOpenzl.columnar_close(writer)
+  end
+
+  defp row_group(first, count) do
+    range = first..(first + count - 1)
+    hosts = for i <- range, do: "host-#{rem(i, 3)}"
+
+    [
+      for(i <- range, into: <<>>, do: <<i::little-unsigned-64>>),
+      for(i <- range, into: <<>>, do: <<i / 10::little-float-64>>),
+      for(i <- range, into: <<>>, do: <<-i::little-signed-32>>),
+      {Enum.join(hosts), for(h <- hosts, into: <<>>, do: <<byte_size(h)::little-32>>)}
+    ]
+  end
+
+  describe "columnar files" do
+    @describetag :tmp_dir
+
+    test "roundtrips row groups and projects columns", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "metrics.ezlc")
+      groups = [row_group(0, 100), row_group(100, 100), row_group(200, 50)]
+      write_columnar(path, groups)
+
+      {:ok, reader} = ExOpenzl.columnar_open_reader(path)
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      meta = ExOpenzl.columnar_metadata(reader)
+      assert meta.num_rows == 250
+      assert length(meta.row_groups) == 3
+      assert Enum.map(meta.schema, & &1.name) == ["ts", "temp", "delta", "host"]
+
+      assert {:ok, all} = ExOpenzl.columnar_read(reader, dctx)
+      assert Enum.map(all, &[&1["ts"], &1["temp"], &1["delta"], &1["host"]]) == groups
+
+      assert {:ok, [projected]} =
+               ExOpenzl.columnar_read(reader, dctx, columns: ["host", "ts"], row_groups: [1])
+
+      [ts, _temp, _delta, host] = Enum.at(groups, 1)
+      assert projected == %{"host" => host, "ts" => ts}
+    end
+
+    test "records zone maps for numeric columns", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "zones.ezlc")
+      write_columnar(path, [row_group(0, 100), row_group(100, 100)])
+
+      {:ok, reader} = ExOpenzl.columnar_open_reader(path)
+      [g0, g1] = ExOpenzl.columnar_metadata(reader).row_groups
+
+      assert [%{min: 0, max: 99}, %{min: +0.0, max: 9.9}, %{min: -99, max: 0}, %{min: nil}] =
+               g0.columns
+
+      assert %{min: 100, max: 199} = hd(g1.columns)
+
+      assert ExOpenzl.columnar_row_groups(reader, "ts", 150, 160) == [1]
+      assert ExOpenzl.columnar_row_groups(reader, "delta", -10, -5) == [0]
+      assert ExOpenzl.columnar_row_groups(reader, "host", 0, 0) == [0, 1]
+    end
+
+    test "rejects malformed row groups", %{tmp_dir: tmp_dir} do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+
+      {:ok, writer} =
+        ExOpenzl.columnar_open(Path.join(tmp_dir, "bad.ezlc"), cctx, [
+          {"a", {:uint, 4}},
+          {"b", {:uint, 8}}
+        ])
+
+      assert {:error, _} = ExOpenzl.columnar_write_row_group(writer, [<<1::32>>])
+      assert {:error, _} =
+               ExOpenzl.columnar_write_row_group(writer, [<<1::32>>, <<1::64, 2::64>>])
+      assert {:error, _} = ExOpenzl.columnar_write_row_group(writer, [<<1, 2, 3>>, <<1::64>>])
+      assert :ok = ExOpenzl.columnar_write_row_group(writer, [<<1::32>>, <<1::64>>])
+      :ok = ExOpenzl.columnar_close(writer)
+    end
+
+    test "returns error for files that are not columnar", %{tmp_dir: tmp_dir} do
+      path = Path.join(tmp_dir, "plain.bin")
+      File.write!(path, :binary.copy("x", 100))
+      assert {:error, _} = ExOpenzl.columnar_open_reader(path)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 9: SDDL Columns
+  # ===========================================================================
+
+  describe "decompress_sddl_columns/3" do
+    test "returns one column per SDDL field" do
+      source = "Row = {\nUInt64LE\nUInt8\n}\n: Row[_rem / 9]\n"
+      {:ok, compiled} = ExOpenzl.sddl_compile(source)
+      {:ok, compressor} = ExOpenzl.create_sddl_compressor(compiled)
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      :ok = ExOpenzl.set_compressor(cctx, compressor)
+
+      records =
+        for i <- 1..100, into: <<>> do
+          <<1_700_000_000 + i::little-unsigned-64, rem(i, 5)::unsigned-8>>
+        end
+
+      {:ok, compressed} = ExOpenzl.compress(cctx, records)
+      assert {:ok, [ts, level]} = ExOpenzl.decompress_sddl_columns(dctx, compressed, source)
+
+      assert %{name: "field_0", kind: :uint, element_width: 8, num_elements: 100} = ts
+      assert %{name: "field_1", kind: :uint, element_width: 1, num_elements: 100} = level
+
+      assert ts.data ==
+               for(i <- 1..100, into: <<>>, do: <<1_700_000_000 + i::little-unsigned-64>>)
+
+      assert level.data == for(i <- 1..100, into: <<>>, do: <<rem(i, 5)>>)
+    end
+
+    test "names nested and array fields and swaps big-endian values" do
+      source = """
+      Point = {
+        x : Int16BE
+        y : Int16BE
+      }
+      Row = {
+        id : UInt32LE
+        pos : Point
+        tags : Byte[3]
+        Float64LE
+      }
+      : Row[_rem / 19]
+      """
+
+      records =
+        for i <- 1..10, into: <<>> do
+          <<i::little-32, -i::big-signed-16, i * 2::big-16, "abc", i * 0.5::little-float-64>>
+        end
+
+      {:ok, compiled} = ExOpenzl.sddl_compile(source)
+      {:ok, compressor} = ExOpenzl.create_sddl_compressor(compiled)
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      :ok = ExOpenzl.set_compressor(cctx, compressor)
+      {:ok, compressed} = ExOpenzl.compress(cctx, records)
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      assert {:ok, columns} = ExOpenzl.decompress_sddl_columns(dctx, compressed, source)
+
+      assert Enum.map(columns, & &1.name) == ["id", "pos.x", "pos.y", "tags", "field_3"]
+      [id, x, y, tags, value] = columns
+
+      assert id.data == for(i <- 1..10, into: <<>>, do: <<i::little-32>>)
+      assert %{kind: :int, element_width: 2} = x
+      assert x.data == for(i <- 1..10, into: <<>>, do: <<-i::native-signed-16>>)
+      assert y.data == for(i <- 1..10, into: <<>>, do: <<i * 2::native-16>>)
+      assert %{elements_per_record: 3, num_elements: 30} = tags
+      assert tags.data == :binary.copy("abc", 10)
+      assert %{kind: :float, element_width: 8} = value
+    end
+
+    test "maps one typed output per field onto the field names" do
+      source = "Row = {\nts : UInt64LE\nlevel : UInt8\n}\n: Row[_rem / 9]\n"
+      ts = for i <- 1..50, into: <<>>, do: <<i::native-64>>
+      level = for i <- 1..50, into: <<>>, do: <<rem(i, 3)>>
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      {:ok, compressed} =
+        ExOpenzl.compress_multi_typed(cctx, [{:numeric, ts, 8}, {:numeric, level, 1}])
+
+      assert {:ok, [ts_col, level_col]} =
+               ExOpenzl.decompress_sddl_columns(dctx, compressed, source)
+
+      assert %{name: "ts", num_elements: 50, data: ^ts} = ts_col
+      assert %{name: "level", num_elements: 50, data: ^level} = level_col
+
+      # Output widths and record counts must match the layout
+      {:ok, bad} =
+        ExOpenzl.compress_multi_typed(cctx, [{:numeric, ts, 8}, {:numeric, ts, 8}])
+
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, bad, source)
+
+      {:ok, short} =
+        ExOpenzl.compress_multi_typed(cctx, [{:numeric, ts, 8}, {:numeric, "ab", 1}])
+
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, short, source)
+    end
+
+    test "returns error for unsupported or mismatched descriptions" do
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      {:ok, compressed} = ExOpenzl.compress(:binary.copy(<<1, 2, 3, 4, 5>>, 20))
+
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, compressed, "")
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, compressed, ": Nope[_rem / 4]")
+      assert {:error, _} =
+               ExOpenzl.decompress_sddl_columns(dctx, compressed, ": UInt32LE[_rem / 8]")
+      # 100 bytes is not a whole number of 8-byte records
+      assert {:error, _} =
+               ExOpenzl.decompress_sddl_columns(dctx, compressed, ": UInt64LE[_rem / 8]")
+
+      assert {:ok, [%{num_elements: 25}]} =
+               ExOpenzl.decompress_sddl_columns(dctx, compressed, ": UInt32LE[_rem / 4]")
+
+      # Layouts that would expand to huge records or field lists are refused
+      huge = "A = { x : Byte y : Byte }\nB = A[4000000000]\n: B[_rem]\n"
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, compressed, huge)
+      wide = "A = UInt64LE[1000000]\nB = A[1000000]\n: B[_rem]\n"
+      assert {:error, _} = ExOpenzl.decompress_sddl_columns(dctx, compressed, wide)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 10: SDDL Introspection
+  # ===========================================================================
+
+  describe "sddl_describe/2" do
+    test "reports layout and per-field cost" do
+      source = """
+      Row = {
+        ts : UInt64LE
+        level : UInt8
+        samples : UInt16LE[4]
+        flag : UInt8
+      }
+      : Row[_rem / 18]
+      """
+
+      sample =
+        for i <- 1..500, into: <<>> do
+          <<1_700_000_000 + i::little-64, rem(i, 5), i::little-16, 0::little-16, 7::little-16,
+            :rand.uniform(65_535)::little-16, 0>>
+        end
+
+      assert {:ok, desc} = ExOpenzl.sddl_describe(source, sample)
+      assert %{record_width: 18, num_records: 500, raw_size: 9000} = desc
+      assert desc.compressed_size > 0 and desc.compressed_size < 9000
+      assert desc.encode_time_ns > 0
+
+      assert [ts, level, samples, flag] = desc.fields
+      assert %{name: "ts", offset: 0, element_width: 8, raw_size: 4000} = ts
+      assert %{name: "level", offset: 8, element_width: 1, raw_size: 500} = level
+
+      assert %{name: "samples", offset: 9, element_width: 2, elements_per_record: 4} =
+               samples
+
+      # Random samples cost real bytes under the profile, more than a
+      # monotonic timestamp; a field that is already all zeroes costs nothing
+      assert samples.compressed_size > 500
+      assert samples.compressed_size > ts.compressed_size
+      assert flag.compressed_size == 0
+      assert Enum.all?(desc.fields, &(&1.compressed_size <= desc.compressed_size))
+      assert Enum.all?(desc.fields, &(&1.encode_time_ns <= desc.encode_time_ns))
+    end
+
+    test "measures only the widest fields of a wide layout" do
+      fields = for i <- 0..69, do: "f#{i} : #{if i == 69, do: "UInt32LE", else: "UInt8"}\n"
+      source = "Row = {\n#{fields}}\n: Row[_rem / 73]\n"
+      sample = :crypto.strong_rand_bytes(73 * 20)
+
+      assert {:ok, %{fields: fields}} = ExOpenzl.sddl_describe(source, sample)
+      assert length(fields) == 70
+      {measured, skipped} = Enum.split_with(fields, &is_integer(&1.compressed_size))
+      assert length(measured) == 64
+      assert Enum.all?(skipped, &(&1.compressed_size == nil and &1.encode_time_ns == nil))
+      assert %{name: "f69", element_width: 4} = Enum.find(measured, &(&1.name == "f69"))
+    end
+
+    test "returns error for partial records or unsupported source" do
+      assert {:error, _} = ExOpenzl.sddl_describe(": UInt32LE[_rem / 4]", <<1, 2, 3>>)
+      assert {:error, _} = ExOpenzl.sddl_describe(": UInt32LE[_rem / 4]", <<>>)
+      assert {:error, _} = ExOpenzl.sddl_describe("Row = { Nope }\n: Row", <<1>>)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 11: SDDL Record-Type Dispatch
+  # ===========================================================================
+
+  describe "dispatch compressor" do
+    setup do
+      {:ok, dispatcher} =
+        ExOpenzl.create_dispatch_compressor([
+          {1, "Tick = {\nUInt64LE\nUInt32LE\n}\n: Tick[_rem / 12]\n"},
+          {2, "Event = {\nUInt64LE\nUInt8\n}\n: Event[_rem / 9]\n"}
+        ])
+
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      %{dispatcher: dispatcher, dctx: dctx}
+    end
+
+    test "round-trips interleaved record types", %{dispatcher: dispatcher, dctx: dctx} do
+      data =
+        for i <- 1..2_000, into: <<>> do
+          if rem(i, 3) == 0 do
+            <<2, 1_700_000_000 + i::little-64, rem(i, 4)>>
+          else
+            <<1, 1_700_000_000 + i::little-64, i * 10::little-32>>
+          end
+        end
+
+      assert {:ok, compressed} = ExOpenzl.compress_dispatch(dispatcher, data)
+      assert {:ok, ^data} = ExOpenzl.decompress_dispatch(dctx, compressed)
+
+      {:ok, plain} = ExOpenzl.compress(data)
+      assert byte_size(compressed) < byte_size(plain)
+    end
+
+    test "handles inputs with only some types present", %{dispatcher: dispatcher, dctx: dctx} do
+      data = for i <- 1..50, into: <<>>, do: <<2, i::little-64, 1>>
+      assert {:ok, compressed} = ExOpenzl.compress_dispatch(dispatcher, data)
+      assert {:ok, ^data} = ExOpenzl.decompress_dispatch(dctx, compressed)
+    end
+
+    test "returns error for unknown tags and truncated records", %{dispatcher: dispatcher} do
+      assert {:error, _} = ExOpenzl.compress_dispatch(dispatcher, <<3, 0::64, 0::32>>)
+      assert {:error, _} = ExOpenzl.compress_dispatch(dispatcher, <<1, 0::64>>)
+      assert {:error, _} = ExOpenzl.compress_dispatch(dispatcher, <<>>)
+    end
+
+    test "rejects invalid type lists and frames", %{dctx: dctx} do
+      source = ": UInt32LE[_rem / 4]"
+      assert {:error, _} = ExOpenzl.create_dispatch_compressor([])
+      assert {:error, _} = ExOpenzl.create_dispatch_compressor([{1, source}, {1, source}])
+      assert {:error, _} = ExOpenzl.create_dispatch_compressor([{256, source}])
+
+      {:ok, plain} = ExOpenzl.compress("not a dispatch frame")
+      assert {:error, _} = ExOpenzl.decompress_dispatch(dctx, plain)
+    end
+  end
+
+  # ===========================================================================
+  # Phase 13: Column Filtering
+  # ===========================================================================
+
+  describe "filter_range/4" do
+    test "selects unsigned elements in range" do
+      data = for i <- 0..19, into: <<>>, do: <<i::native-unsigned-32>>
+      assert {:ok, bitmap, 6} = ExOpenzl.filter_range(data, {:uint, 4}, 5, 10)
+      assert bitmap == <<0b11100000, 0b00000111, 0>>
+    end
+
+    test "handles signed, float and mixed bounds" do
+      ints = for i <- -5..5, into: <<>>, do: <<i::native-signed-16>>
+      assert {:ok, <<0b01110000, 0>>, 3} = ExOpenzl.filter_range(ints, {:int, 2}, -1.5, 1)
+
+      nan = <<0x7FF8000000000000::native-64>>
+      floats = <<1.0::native-float-64>> <> nan <> <<3.5::native-float-64>>
+      assert {:ok, <<0b101>>, 2} = ExOpenzl.filter_range(floats, {:float, 8}, 0, 10)
+    end
+
+    test "clamps bounds to the element type" do
+      bytes = <<0, 100, 255>>
+      assert {:ok, <<0b111>>, 3} = ExOpenzl.filter_range(bytes, {:uint, 1}, -10, 1000)
+      assert {:ok, <<0>>, 0} = ExOpenzl.filter_range(bytes, {:uint, 1}, 300, 400)
+      assert {:ok, <<0>>, 0} = ExOpenzl.filter_range(bytes, {:uint, 1}, 50, 10)
+
+      signed = <<-128::signed-8, -1::signed-8, 127::signed-8>>
+      assert {:ok, <<0b011>>, 2} = ExOpenzl.filter_range(signed, {:int, 1}, -1000, 0)
+      assert {:ok, <<0>>, 0} = ExOpenzl.filter_range(signed, {:int, 1}, 128, 1000)
+
+      # Float32 bounds round inward: the f32 nearest 0.1 lies just above it
+      # and matches, and bounds beyond the f32 range match nothing finite
+      f32 = <<0.1::native-float-32, 1.0::native-float-32, 0.0::native-float-32>>
+      assert {:ok, <<0b011>>, 2} = ExOpenzl.filter_range(f32, {:float, 4}, 0.1, 1.0)
+      assert {:ok, <<0>>, 0} = ExOpenzl.filter_range(f32, {:float, 4}, 1.0e300, 1.0e308)
+    end
+
+    test "returns error for bad widths" do
+      assert {:error, _} = ExOpenzl.filter_range(<<1, 2, 3>>, {:uint, 2}, 0, 1)
+      assert {:error, _} = ExOpenzl.filter_range(<<1, 2>>, {:float, 2}, 0, 1)
+    end
+  end
+
+  describe "native buffers" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      %{cctx: cctx, dctx: dctx}
+    end
+
+    test "reuses one buffer for serial and typed frames", %{cctx: cctx, dctx: dctx} do
+      {:ok, buf} = ExOpenzl.buffer_new(64 * 1024)
+
+      text = String.duplicate("native buffer ", 500)
+      {:ok, frame} = ExOpenzl.compress(cctx, text)
+      assert {:ok, %{type: :serial, length: len}} = ExOpenzl.decompress_into(dctx, frame, buf)
+      assert len == byte_size(text)
+      assert {:ok, ^text} = ExOpenzl.buffer_copy(buf)
+
+      nums = for i <- 1..1_000, into: <<>>, do: <<i * 3::native-32>>
+      {:ok, frame} = ExOpenzl.compress_typed(cctx, {:numeric, nums, 4})
+
+      assert {:ok, %{type: :numeric, element_width: 4, num_elements: 1_000}} =
+               ExOpenzl.decompress_into(dctx, frame, buf)
+
+      assert {:ok, ^nums} = ExOpenzl.buffer_view(buf)
+      assert {:ok, <<12::native-32>>} = ExOpenzl.buffer_view(buf, 12, 4)
+      assert %{capacity: 65_536, length: 4_000} = ExOpenzl.buffer_info(buf)
+    end
+
+    test "exposes string lengths", %{cctx: cctx, dctx: dctx} do
+      strings = ["alpha", "", "gamma", "delta"]
+      lengths = for s <- strings, into: <<>>, do: <<byte_size(s)::native-32>>
+      {:ok, frame} = ExOpenzl.compress_typed(cctx, {:string, Enum.join(strings), lengths})
+
+      {:ok, buf} = ExOpenzl.buffer_new(1024)
+      assert {:ok, %{type: :string, num_elements: 4}} = ExOpenzl.decompress_into(dctx, frame, buf)
+      assert {:ok, "alphagammadelta"} = ExOpenzl.buffer_copy(buf)
+      assert {:ok, ^lengths} = ExOpenzl.buffer_string_lengths(buf)
+    end
+
+    test "views are unaffected by later decodes", %{cctx: cctx, dctx: dctx} do
+      {:ok, buf} = ExOpenzl.buffer_new(64 * 1024)
+      a = String.duplicate("a", 1_000)
+      b = String.duplicate("b", 1_000)
+      {:ok, frame_a} = ExOpenzl.compress(cctx, a)
+      {:ok, frame_b} = ExOpenzl.compress(cctx, b)
+
+      {:ok, _} = ExOpenzl.decompress_into(dctx, frame_a, buf)
+      {:ok, view} = ExOpenzl.buffer_view(buf)
+      {:ok, _} = ExOpenzl.decompress_into(dctx, frame_b, buf)
+      assert view == a
+      assert {:ok, ^b} = ExOpenzl.buffer_copy(buf)
+
+      few = for s <- ["x", "yy"], into: <<>>, do: <<byte_size(s)::native-32>>
+      {:ok, frame} = ExOpenzl.compress_typed(cctx, {:string, "xyy", few})
+      {:ok, _} = ExOpenzl.decompress_into(dctx, frame, buf)
+      {:ok, lens_view} = ExOpenzl.buffer_string_lengths(buf)
+
+      many = :binary.copy(<<1::native-32>>, 5_000)
+      {:ok, frame} = ExOpenzl.compress_typed(cctx, {:string, String.duplicate("z", 5_000), many})
+      {:ok, %{num_elements: 5_000}} = ExOpenzl.decompress_into(dctx, frame, buf)
+      assert lens_view == few
+      assert {:ok, ^many} = ExOpenzl.buffer_string_lengths(buf)
+    end
+
+    test "fails instead of growing when the buffer is too small", %{cctx: cctx, dctx: dctx} do
+      {:ok, frame} = ExOpenzl.compress(cctx, :binary.copy(<<1, 2, 3, 4>>, 1_000))
+      {:ok, buf} = ExOpenzl.buffer_new(100)
+
+      assert {:error, "buffer too small" <> _} = ExOpenzl.decompress_into(dctx, frame, buf)
+      assert %{capacity: 100, length: 0} = ExOpenzl.buffer_info(buf)
+    end
+
+    test "rejects ranges outside the contents" do
+      {:ok, buf} = ExOpenzl.buffer_new(16)
+      assert {:ok, ""} = ExOpenzl.buffer_view(buf)
+      assert {:error, _} = ExOpenzl.buffer_view(buf, 0, 1)
+      assert :ok = ExOpenzl.buffer_reset(buf)
+      assert {:error, _} = ExOpenzl.buffer_string_lengths(buf)
+    end
+  end
+
+  describe "zstd transcoding" do
+    @describetag :tmp_dir
+
+    test "transcodes concatenated zstd frames in memory" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      data = for i <- 1..20_000, into: <<>>, do: "row #{i}\n"
+
+      <<first::binary-size(50_000), rest::binary>> = data
+      zstd = zstd_frame(first) <> zstd_frame(rest)
+
+      assert {:ok, frame} = ExOpenzl.transcode_zstd(cctx, zstd)
+      assert {:ok, ^data} = ExOpenzl.decompress(dctx, frame)
+    end
+
+    test "rejects truncated or invalid zstd input" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      frame = zstd_frame("hello world")
+
+      assert {:error, "zstd: truncated input"} =
+               ExOpenzl.transcode_zstd(cctx, binary_part(frame, 0, byte_size(frame) - 2))
+
+      assert {:error, "zstd: " <> _} = ExOpenzl.transcode_zstd(cctx, "not zstd data")
+
+      assert {:error, "zstd: decoded size exceeds " <> _} =
+               ExOpenzl.transcode_zstd(cctx, zstd_rle_bomb(600))
+    end
+
+    test "streams a .zst file into a readable log", %{tmp_dir: tmp_dir} do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      data = for i <- 1..50_000, into: <<>>, do: <<i::native-32>>
+      src = Path.join(tmp_dir, "in.zst")
+      dst = Path.join(tmp_dir, "out.log")
+      File.write!(src, zstd_frame(data))
+
+      before = ExOpenzl.transcode_stats()
+
+      assert {:ok, %{raw_bytes: 200_000, log_bytes: log_bytes}} =
+               ExOpenzl.transcode_zstd_file(src, dst, cctx, chunk_size: 65_536)
+
+      assert log_bytes == File.stat!(dst).size
+
+      {:ok, reader} = ExOpenzl.log_reader_open(dst)
+      assert %{block_count: 4} = ExOpenzl.log_reader_info(reader)
+      assert IO.iodata_to_binary(Enum.to_list(ExOpenzl.log_stream(reader, dctx))) == data
+
+      stats = ExOpenzl.transcode_stats()
+      assert stats.jobs > before.jobs
+      assert stats.raw_bytes >= before.raw_bytes + 200_000
+    end
+
+    test "removes the destination when the source is corrupt", %{tmp_dir: tmp_dir} do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      src = Path.join(tmp_dir, "bad.zst")
+      dst = Path.join(tmp_dir, "bad.log")
+      File.write!(src, "definitely not zstd")
+
+      assert {:error, _} = ExOpenzl.transcode_zstd_file(src, dst, cctx)
+      refute File.exists?(dst)
+    end
+  end
+
+  describe "compress_fast/2" do
+    test "round-trips through both decompress entry points" do
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      big = :rand.bytes(300_000)
+
+      for data <- ["x", String.duplicate("cached response body ", 200), big] do
+        assert {:ok, <<"EZL4", _::binary>> = packed} = ExOpenzl.compress_fast(data)
+        assert {:ok, ^data} = ExOpenzl.decompress(packed)
+        assert {:ok, ^data} = ExOpenzl.decompress(dctx, packed)
+      end
+    end
+
+    test "honours acceleration" do
+      data = for i <- 1..20_000, into: <<>>, do: "#{rem(i * 7919, 1000)},"
+      {:ok, default} = ExOpenzl.compress_fast(data)
+      {:ok, fast} = ExOpenzl.compress_fast(data, acceleration: 64)
+      assert byte_size(fast) >= byte_size(default)
+      assert {:ok, ^data} = ExOpenzl.decompress(fast)
+
+      assert {:error, _} = ExOpenzl.compress_fast(data, acceleration: 0)
+    end
+
+    test "rejects empty input and corrupt envelopes" do
+      assert {:error, _} = ExOpenzl.compress_fast("")
+
+      {:ok, <<header::binary-size(8), block::binary>>} =
+        ExOpenzl.compress_fast(String.duplicate("abc", 100))
+
+      assert {:error, _} = ExOpenzl.decompress(header <> binary_part(block, 0, 3))
+
+      # A size claim beyond LZ4's 255:1 expansion is refused before allocating
+      assert {:error, _} = ExOpenzl.decompress(<<"EZL4", 0x7E000000::little-32, 0>>)
+    end
+  end
+
+  describe "compress_auto/4" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      %{cctx: cctx, dctx: dctx}
+    end
+
+    test "round-trips across objectives and payload shapes", %{cctx: cctx, dctx: dctx} do
+      payloads = [
+        "tiny",
+        String.duplicate("repetitive text ", 1_000),
+        :rand.bytes(10_000),
+        for(i <- 1..100_000, into: <<>>, do: "#{i},")
+      ]
+
+      for data <- payloads, objective <- [:speed, :balanced, :ratio] do
+        assert {:ok, packed} = ExOpenzl.compress_auto(cctx, data, objective)
+        assert {:ok, ^data} = ExOpenzl.decompress_auto(dctx, packed)
+      end
+    end
+
+    test "stores tiny and incompressible payloads raw", %{cctx: cctx} do
+      {:ok, packed} = ExOpenzl.compress_auto(cctx, "tiny")
+      assert {:ok, :raw} = ExOpenzl.auto_codec(packed)
+
+      {:ok, packed} = ExOpenzl.compress_auto(cctx, :rand.bytes(4_096), :ratio)
+      assert {:ok, :raw} = ExOpenzl.auto_codec(packed)
+    end
+
+    test "speed objective only considers raw and lz4", %{cctx: cctx} do
+      {:ok, packed} = ExOpenzl.compress_auto(cctx, String.duplicate("a", 10_000), :speed)
+      assert {:ok, :lz4} = ExOpenzl.auto_codec(packed)
+    end
+
+    test "numeric columns can use typed compression", %{cctx: cctx, dctx: dctx} do
+      data = for i <- 1..50_000, into: <<>>, do: <<1_700_000_000 + i * 3::native-64>>
+      before = ExOpenzl.auto_stats()
+
+      {:ok, packed} = ExOpenzl.compress_auto(cctx, data, :ratio, element_width: 8)
+      assert {:ok, codec} = ExOpenzl.auto_codec(packed)
+      assert codec in [:openzl, :openzl_numeric, :zstd]
+      assert {:ok, ^data} = ExOpenzl.decompress_auto(dctx, packed)
+
+      stats = ExOpenzl.auto_stats()
+      assert stats.selected[codec] == before.selected[codec] + 1
+      assert stats.bytes_in >= before.bytes_in + byte_size(data)
+    end
+
+    test "balanced and ratio choices do not depend on timing", %{cctx: cctx} do
+      data = for i <- 1..20_000, into: <<>>, do: "#{rem(i * 7919, 1000)},"
+
+      for objective <- [:balanced, :ratio] do
+        codecs =
+          for _ <- 1..5 do
+            {:ok, packed} = ExOpenzl.compress_auto(cctx, data, objective)
+            {:ok, codec} = ExOpenzl.auto_codec(packed)
+            codec
+          end
+
+        assert length(Enum.uniq(codecs)) == 1
+      end
+    end
+
+    test "rejects unknown tags", %{dctx: dctx} do
+      assert {:error, _} = ExOpenzl.decompress_auto(dctx, <<99, 1, 2, 3>>)
+      assert {:error, _} = ExOpenzl.auto_codec(<<99>>)
+    end
+
+    test "refuses zstd payloads that expand past the limit", %{dctx: dctx} do
+      # 2.4 KiB of RLE blocks declaring 75 MiB of output
+      assert {:error, "zstd: decoded size exceeds " <> _} =
+               ExOpenzl.decompress_auto(dctx, <<2, zstd_rle_bomb(600)::binary>>)
+    end
+  end
+
+  describe "compress/3 with :deadline" do
+    test "uses the context's settings when the budget is generous" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      data = String.duplicate("deadline bounded payload ", 1_000)
+
+      assert {:ok, frame, :primary} = ExOpenzl.compress(cctx, data, deadline: 10_000_000)
+      assert {:ok, ^data} = ExOpenzl.decompress(dctx, frame)
+    end
+
+    test "falls back when history says the budget is too tight" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      :ok = ExOpenzl.set_compression_level(cctx, 19)
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      data = for i <- 1..200_000, into: <<>>, do: "#{rem(i * 7919, 100_003)};"
+
+      # Seed the cost history
+      {:ok, _} = ExOpenzl.compress(cctx, data)
+
+      assert {:ok, frame, path} = ExOpenzl.compress(cctx, data, deadline: 0)
+      assert path in [:fast, :stored]
+      assert {:ok, ^data} = ExOpenzl.decompress(dctx, frame)
+    end
+
+    test "requires a deadline" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      assert_raise KeyError, fn -> ExOpenzl.compress(cctx, "data", []) end
+      assert_raise ArgumentError, fn -> ExOpenzl.compress(cctx, "data", deadline: -1) end
+    end
+  end
+
+  describe "recompact/3" do
+    test "re-encodes serial and typed frames at the target level" do
+      {:ok, fast} = ExOpenzl.create_compression_context()
+      :ok = ExOpenzl.set_compression_level(fast, 1)
+      {:ok, archive} = ExOpenzl.create_compression_context()
+      :ok = ExOpenzl.set_compression_level(archive, 19)
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+
+      texts = for i <- 1..8, do: for(j <- 1..5_000, into: <<>>, do: "#{i}:#{rem(j * 31, 977)} ")
+      nums = for i <- 1..10_000, into: <<>>, do: <<i * i::native-64>>
+      frames = Enum.map(texts, &elem(ExOpenzl.compress(fast, &1), 1))
+      {:ok, typed} = ExOpenzl.compress_typed(fast, {:numeric, nums, 8})
+
+      assert {:ok, out, stats} = ExOpenzl.recompact(frames ++ [typed], archive, threads: 4)
+      assert length(out) == 9
+      assert stats.frames == 9
+      assert stats.bytes_out <= stats.bytes_in
+      assert stats.bytes_saved == stats.bytes_in - stats.bytes_out
+
+      {text_frames, [typed_out]} = Enum.split(out, 8)
+
+      for {frame, text} <- Enum.zip(text_frames, texts) do
+        assert {:ok, ^text} = ExOpenzl.decompress(dctx, frame)
+      end
+
+      assert {:ok, %{type: :numeric, data: ^nums}} = ExOpenzl.decompress_typed(dctx, typed_out)
+    end
+
+    test "reports the failing frame" do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, good} = ExOpenzl.compress(cctx, "some data to compress")
+
+      assert {:error, "frame 1: " <> _} = ExOpenzl.recompact([good, "garbage"], cctx)
+      assert {:error, _} = ExOpenzl.recompact([], cctx)
+    end
+  end
+
+  describe "merge_multi_typed/3" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      %{cctx: cctx, dctx: dctx}
+    end
+
+    test "concatenates each column across frames", %{cctx: cctx, dctx: dctx} do
+      minutes =
+        for m <- 0..59 do
+          ts = for s <- 0..59, into: <<>>, do: <<1_700_000_000 + m * 60 + s::native-64>>
+          msgs = for s <- 0..59, do: "event #{m}:#{s}"
+          lens = for msg <- msgs, into: <<>>, do: <<byte_size(msg)::native-32>>
+          {ts, Enum.join(msgs), lens}
+        end
+
+      frames =
+        for {ts, msgs, lens} <- minutes do
+          inputs = [{:numeric, ts, 8}, {:string, msgs, lens}]
+          {:ok, frame} = ExOpenzl.compress_multi_typed(cctx, inputs)
+          frame
+        end
+
+      assert {:ok, merged} = ExOpenzl.merge_multi_typed(dctx, cctx, frames)
+      assert byte_size(merged) < Enum.sum(Enum.map(frames, &byte_size/1))
+
+      assert {:ok, [ts_out, msg_out]} = ExOpenzl.decompress_multi_typed(dctx, merged)
+      assert ts_out.data == Enum.map_join(minutes, &elem(&1, 0))
+      assert ts_out.num_elements == 3_600
+      assert msg_out.data == Enum.map_join(minutes, &elem(&1, 1))
+      assert msg_out.string_lengths == Enum.map_join(minutes, &elem(&1, 2))
+    end
+
+    test "rejects frames with a different layout", %{cctx: cctx, dctx: dctx} do
+      {:ok, a} = ExOpenzl.compress_multi_typed(cctx, [{:numeric, <<1::native-64>>, 8}])
+      {:ok, b} = ExOpenzl.compress_multi_typed(cctx, [{:numeric, <<1::native-32>>, 4}])
+      two_cols = [{:numeric, <<1::native-64>>, 8}, {:numeric, <<2>>, 1}]
+      {:ok, c} = ExOpenzl.compress_multi_typed(cctx, two_cols)
+
+      assert {:error, _} = ExOpenzl.merge_multi_typed(dctx, cctx, [a, b])
+      assert {:error, _} = ExOpenzl.merge_multi_typed(dctx, cctx, [a, c])
+      assert {:error, _} = ExOpenzl.merge_multi_typed(dctx, cctx, [])
+    end
+  end
+
+  describe "decompress_prefix/4" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      log = Enum.map_join(1..20_000, &"#{&1} GET /api/items/#{rem(&1, 97)} 200\n")
+      %{cctx: cctx, dctx: dctx, log: log}
+    end
+
+    test "pages through a chunked container", %{cctx: cctx, dctx: dctx, log: log} do
+      {:ok, packed} = ExOpenzl.compress_chunked(cctx, log, chunk_size: 4_096)
+      assert {:ok, ^log} = ExOpenzl.decompress(dctx, packed)
+      assert {:ok, ^log} = ExOpenzl.decompress(packed)
+
+      assert {:ok, first, 10_000} = ExOpenzl.decompress_prefix(dctx, packed, 10_000)
+      assert first == binary_part(log, 0, 10_000)
+
+      pages =
+        Stream.unfold(0, fn
+          :eof ->
+            nil
+
+          from ->
+            {:ok, page, next} = ExOpenzl.decompress_prefix(dctx, packed, 7_000, from)
+            {page, next}
+        end)
+
+      assert Enum.join(pages) == log
+    end
+
+    test "slices ordinary frames", %{cctx: cctx, dctx: dctx, log: log} do
+      {:ok, frame} = ExOpenzl.compress(cctx, log)
+      assert {:ok, page, 200} = ExOpenzl.decompress_prefix(dctx, frame, 100, 100)
+      assert page == binary_part(log, 100, 100)
+
+      size = byte_size(log)
+      assert {:ok, tail, :eof} = ExOpenzl.decompress_prefix(dctx, frame, 1_000, size - 10)
+      assert tail == binary_part(log, size - 10, 10)
+      assert {:error, _} = ExOpenzl.decompress_prefix(dctx, frame, 10, size + 1)
+    end
+
+    test "rejects a truncated container", %{cctx: cctx, dctx: dctx, log: log} do
+      {:ok, packed} = ExOpenzl.compress_chunked(cctx, log)
+      truncated = binary_part(packed, 0, byte_size(packed) - 1)
+      assert {:error, _} = ExOpenzl.decompress(dctx, truncated)
+      assert {:error, _} = ExOpenzl.decompress_prefix(dctx, truncated, 100)
+    end
+  end
+
+  describe "verify/2 and scrub_dir/2" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      data = Enum.map_join(1..5_000, &"row #{&1} value=#{rem(&1 * 31, 1_000)}\n")
+      {:ok, frame} = ExOpenzl.compress(cctx, data)
+      %{cctx: cctx, data: data, frame: frame}
+    end
+
+    test "accepts intact payloads", %{cctx: cctx, data: data, frame: frame} do
+      {:ok, chunked} = ExOpenzl.compress_chunked(cctx, data, chunk_size: 8_192)
+      {:ok, fast} = ExOpenzl.compress_fast(data)
+      {:ok, typed} = ExOpenzl.compress_typed(cctx, {:numeric, <<1::64, 2::64, 3::64>>, 8})
+
+      for payload <- [frame, chunked, fast, typed], full <- [false, true] do
+        assert :ok = ExOpenzl.verify(payload, full: full)
+      end
+    end
+
+    test "reports damaged payloads", %{frame: frame} do
+      truncated = binary_part(frame, 0, byte_size(frame) - 1)
+
+      assert {:error, _} = ExOpenzl.verify(truncated, full: true)
+      assert {:error, _} = ExOpenzl.verify(binary_part(frame, 0, 8), full: true)
+      assert {:error, _} = ExOpenzl.verify("not a frame")
+    end
+
+    @tag :tmp_dir
+    test "scrubs a directory of archives", %{cctx: cctx, frame: frame, tmp_dir: tmp_dir} do
+      nested = Path.join(tmp_dir, "2024/06")
+      File.mkdir_p!(nested)
+      File.write!(Path.join(tmp_dir, "a.ozl"), frame)
+      File.write!(Path.join(nested, "b.ozl"), frame)
+      File.write!(Path.join(nested, "broken.ozl"), binary_part(frame, 0, 16))
+
+      {:ok, log} = ExOpenzl.log_open(Path.join(nested, "events.log"), cctx, block_size: 1_024)
+      {:ok, _} = ExOpenzl.log_append(log, for(i <- 1..500, do: "event #{i}"))
+      :ok = ExOpenzl.log_close(log)
+
+      assert {:ok, stats} = ExOpenzl.scrub_dir(tmp_dir, threads: 2, max_bytes_per_sec: 10_000_000)
+      assert stats.files == 4
+      assert stats.failed == 1
+      assert stats.frames > 3
+      assert [{path, _reason}] = stats.failures
+      assert Path.basename(path) == "broken.ozl"
+
+      assert {:error, _} = ExOpenzl.scrub_dir(Path.join(tmp_dir, "missing"))
+    end
+
+    @tag :tmp_dir
+    test "scrubs chunked containers chunk by chunk", %{cctx: cctx, data: data, tmp_dir: tmp_dir} do
+      {:ok, chunked} = ExOpenzl.compress_chunked(cctx, data, chunk_size: 8_192)
+      File.write!(Path.join(tmp_dir, "good.ozc"), chunked)
+      File.write!(Path.join(tmp_dir, "short.ozc"), binary_part(chunked, 0, byte_size(chunked) - 1))
+      File.write!(Path.join(tmp_dir, "long.ozc"), chunked <> "x")
+
+      assert {:ok, stats} = ExOpenzl.scrub_dir(tmp_dir, threads: 1)
+      assert stats.files == 3
+      assert stats.frames >= div(byte_size(data), 8_192)
+      assert stats.failures |> Enum.map(&Path.basename(elem(&1, 0))) |> Enum.sort() ==
+               ["long.ozc", "short.ozc"]
+    end
+  end
+
+  describe "compress_hashed/2 and decompress_hashed/2" do
+    setup do
+      {:ok, cctx} = ExOpenzl.create_compression_context()
+      {:ok, dctx} = ExOpenzl.create_decompression_context()
+      %{cctx: cctx, dctx: dctx}
+    end
+
+    test "hashes match across both directions and formats", %{cctx: cctx, dctx: dctx} do
+      data = Enum.map_join(1..10_000, &"key-#{rem(&1, 300)},")
+
+      assert {:ok, frame, hash} = ExOpenzl.compress_hashed(cctx, data)
+      assert hash in 0..0xFFFFFFFFFFFFFFFF
+      assert {:ok, ^data, ^hash} = ExOpenzl.decompress_hashed(dctx, frame)
+
+      {:ok, chunked} = ExOpenzl.compress_chunked(cctx, data, chunk_size: 4_096)
+      assert {:ok, ^data, ^hash} = ExOpenzl.decompress_hashed(dctx, chunked)
+
+      {:ok, fast} = ExOpenzl.compress_fast(data)
+      assert {:ok, ^data, ^hash} = ExOpenzl.decompress_hashed(dctx, fast)
+    end
+
+    test "matches the reference XXH64 value", %{cctx: cctx} do
+      assert {:ok, _, 0x26C7827D889F6DA3} = ExOpenzl.compress_hashed(cctx, "hello")
+    end
+
+    test "different payloads hash differently", %{cctx: cctx} do
+      {:ok, _, a} = ExOpenzl.compress_hashed(cctx, "payload-a")
+      {:ok, _, b} = ExOpenzl.compress_hashed(cctx, "payload-b")
+      assert a != b
+    end
+  end
+
+  describe "compressed key-value cache" do
+    test "stores, replaces and deletes values" do
+      {:ok, cache} = ExOpenzl.kv_new(max_bytes: 10_000_000, shards: 4)
+      value = Enum.map_join(1..2_000, &"{\"id\":#{&1},\"ok\":true}")
+      large = String.duplicate(value, 4)
+
+      assert :ok = ExOpenzl.kv_put(cache, "a", value)
+      assert :ok = ExOpenzl.kv_put(cache, "big", large)
+      assert :ok = ExOpenzl.kv_put(cache, "empty", "")
+      assert {:ok, ^value} = ExOpenzl.kv_get(cache, "a")
+      assert {:ok, ^large} = ExOpenzl.kv_get(cache, "big")
+      assert {:ok, ""} = ExOpenzl.kv_get(cache, "empty")
+
+      assert :ok = ExOpenzl.kv_put(cache, "a", "short")
+      assert {:ok, "short"} = ExOpenzl.kv_get(cache, "a")
+      assert :ok = ExOpenzl.kv_delete(cache, "a")
+      assert :error = ExOpenzl.kv_get(cache, "a")
+
+      stats = ExOpenzl.kv_stats(cache)
+      assert stats.entries == 2
+      assert stats.hits == 4
+      assert stats.misses == 1
+      assert stats.ratio > 3.0
+    end
+
+    test "evicts least recently used entries under the byte cap" do
+      {:ok, cache} = ExOpenzl.kv_new(max_bytes: 4_096, shards: 1)
+      values = for i <- 1..20, into: %{}, do: {"k#{i}", :rand.bytes(400)}
+
+      for i <- 1..5, do: :ok = ExOpenzl.kv_put(cache, "k#{i}", values["k#{i}"])
+      assert {:ok, _} = ExOpenzl.kv_get(cache, "k1")
+      for i <- 6..20, do: :ok = ExOpenzl.kv_put(cache, "k#{i}", values["k#{i}"])
+
+      stats = ExOpenzl.kv_stats(cache)
+      assert stats.bytes <= 4_096
+      assert stats.evictions > 0
+      assert :error = ExOpenzl.kv_get(cache, "k2")
+      assert {:ok, v20} = ExOpenzl.kv_get(cache, "k20")
+      assert v20 == values["k20"]
+
+      assert {:error, _} = ExOpenzl.kv_put(cache, "huge", :rand.bytes(8_192))
+    end
+
+    test "is safe under concurrent access" do
+      {:ok, cache} = ExOpenzl.kv_new(max_bytes: 50_000_000)
+
+      1..8
+      |> Task.async_stream(fn t ->
+        for i <- 1..200 do
+          key = "t#{t}-#{i}"
+          value = String.duplicate(key, 50)
+          :ok = ExOpenzl.kv_put(cache, key, value)
+          {:ok, ^value} = ExOpenzl.kv_get(cache, key)
+        end
+      end)
+      |> Stream.run()
+
+      assert ExOpenzl.kv_stats(cache).entries == 1_600
+    end
+  end
+
+  # A single-segment zstd frame of `count` 128 KiB RLE blocks of zeros.
+  defp zstd_rle_bomb(count) do
+    body =
+      for i <- 1..count, into: <<>> do
+        last_flag = if i == count, do: 1, else: 0
+        <<last_flag + 2 + 131_072 * 8::little-24, 0>>
+      end
+
+    <<0xFD2FB528::little-32, 0xA0, count * 131_072::little-32, body::binary>>
+  end
+
+  # A zstd frame made of raw (stored) blocks, so tests need no zstd encoder.
+  defp zstd_frame(data) do
+    blocks = for <<chunk::binary-size(65_536) <- data>>, do: chunk
+    tail = binary_part(data, length(blocks) * 65_536, rem(byte_size(data), 65_536))
+    blocks = if tail == "" and blocks != [], do: blocks, else: blocks ++ [tail]
+    last = length(blocks) - 1
+
+    body =
+      for {chunk, i} <- Enum.with_index(blocks), into: <<>> do
+        last_flag = if i == last, do: 1, else: 0
+        <<last_flag + byte_size(chunk) * 8::little-24, chunk::binary>>
+      end
+
+    <<0xFD2FB528::little-32, 0xA0, byte_size(data)::little-32, body::binary>>
+  end
 end
@@ -1 +1,2 @@
-ExUnit.start()
+# Nx is not a dependency; tensor tests run only when it is on the code path
+ExUnit.start(exclude: if(Code.ensure_loaded?(Nx), do: [], else: [:nx]))